@@ -9,12 +9,16 @@
  widgets. This server is a bottleneck and does many things.
  
  This program runs a simulation that utilizes two active servers at
- a time. The statistics printed at the end of the simulation can 
- then be used to compare our hypothetical simulated performance with 
- the performance that has been observer in our current configuration.
+ a time (M and W; -n changes the number of servers). The statistics
+ printed at the end of the simulation can then be used to compare our
+ hypothetical simulated performance with the performance that has been
+ observer in our current configuration.
  
- Widgets are read in from standard input. The expected formatting is
- as follows:
+ This file contains the simulation itself; main is in cs2123p4_main.c
+ so that the tools (p4bench) can link the simulation without it.
+ 
+ Widgets are read in from the input file (p4Input.txt unless -i is given,
+ "-i -" reads standard input). The expected formatting is as follows:
  
  lWidgetNr iStep1tu iStep2tu iArrivalDelta iWhichServer
  %ld       %d       %d         %d           %d
@@ -24,7 +28,8 @@
  iStep2tu - time units for step 2 for this widget
  iArrivalDelta - delta time units before next widget arrives
  iWhichServer - determines which server to use when given an option:
-                1 = server M, 2 = server W
+                1 = server M, 2 = server W, 3 = server X, 4 = server Y,
+                5 and above = server S5, S6, ...
  
  Returns:
  N/A
@@ -34,114 +39,433 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <math.h>
 #include "cs2123p4.h"
 
-int main(int argc, char *argv[])
+// The event loop and its handlers are compiled once per tracing mode and
+// for whether each widget that leaves is recorded (-W, -S): bTrace and
+// bRecord are passed as the constant TRUE or FALSE to these always inlined
+// functions, so the quiet loop has no tracing or recording tests and calls
+// no handler through a pointer. The statistics counters are compiled in or
+// out by STAT (NO_STATS).
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+ALWAYS_INLINE void eventLoop(Simulation simulation, int iTimeLimit, const int bTrace
+                             , const int bRecord);
+ALWAYS_INLINE void arriveImp(Simulation simulation, Event *pEvent, const int bTrace);
+ALWAYS_INLINE void completeImp(Simulation simulation, Event *pEvent, const int bTrace
+                               , const int bRecord);
+ALWAYS_INLINE void queueUpImp(Simulation simulation, Queue queue, unsigned uWidgetId
+                              , const int bTrace);
+ALWAYS_INLINE void seizeImp(Simulation simulation, Queue queue, Server server
+                            , const int bTrace);
+ALWAYS_INLINE void releaseImp(Simulation simulation, Queue queue, Server server
+                              , unsigned uWidgetId, const int bTrace);
+ALWAYS_INLINE void leaveSystemImp(Simulation simulation, unsigned uWidgetId
+                                  , const int bTrace, const int bRecord);
+
+/***************************** traceEvent *********************************
+ void traceEvent(Simulation simulation, int iKind, long lWidgetNr
+                 , int iServer, int iValue)
+ Purpose:
+ Reports a verbose event at the current clock time. The line is printed
+ right away, or with -T the record is handed to the trace writer thread.
+ Parameters:
+ I  Simulation simulation               The simulation structure
+ I  int iKind                           TREC_ARRIVED ... TREC_EXIT
+ I  long lWidgetNr                      The widget involved
+ I  int iServer                         Subscript of the server (and queue)
+ I  int iValue                          Wait or time in system, else 0
+ **************************************************************************/
+static void traceEvent(Simulation simulation, int iKind, long lWidgetNr
+                       , int iServer, int iValue)
 {
-    int iTimeLimit = MAX_CLOCK_TIME;
+    TraceRecord record;
     
-    Simulation simulation = newSimulation();
-    
-    //process command line switches
-    processCommandSwitches(argc, argv, simulation);
-    
-    //call populateSim to populate our sim from standard input
-    generateArrival(simulation);
-    
-    //call run simulation
-    runSimulation(simulation, iTimeLimit);
-
+    record.lWidgetNr = lWidgetNr;
+    record.iTime = simulation->iClock;
+    record.iKind = iKind;
+    record.iServer = iServer;
+    record.iValue = iValue;
+    if (simulation->traceSink != NULL)
+        putTraceRecord(simulation->traceSink, &record);
+    else
+        printTraceRecord(stdout, &record);
 }
+
 /************************* runSimulation **********************************
  void runSimulation(Simulation simulation, int iTimeLimit)
  Purpose: 
- The core function of the program. This function runs the
- simulation, and utilizes an array of helper functions to get the job done 
- in a modular fashion.
+ The core function of the program. This function runs the simulation
+ (see simulate), prints its statistics and frees the simulation. With -c
+ a snapshot of the final state is written, so that a run stopped by the
+ time limit can be resumed (-x). With -W each widget's times are written
+ to the results file. With -S the run stops once its steady-state means
+ are known to the half-width asked for, and they are printed after the
+ averages. With --stats=json the counters and timers follow the
+ statistics.
  Parameters:
  I  Simulation simulation           The simulation structure used to store
                                     simulation-related information.
  I  int iTimeLimit                  The maximum amount of time units that
                                     the simulation is allowed to run for.
-                                    (not enforced).
  **************************************************************************/
 void runSimulation(Simulation simulation, int iTimeLimit)
 {
-    Event event;
-    
-    //declare our queues
-    Queue queueW = newQueue("queueW");
-    Queue queueM = newQueue("queueM");
-    
-    //declare and allocate our two servers
-    Server serverW = newServer("serverW");
-    Server serverM = newServer("serverM");
+    SimulationResult result;
+    double dStart;
     
-    //read in all of our arrival events from the input file
-    //generateArrival(simulation);
+    //with -T the events go to the trace file (as text when verbose), so
+    //standard output looks like a quiet run
+    if (simulation->pszTraceFile != NULL)
+    {
+        simulation->traceSink = newTraceSink(simulation->pszTraceFile
+                                             , simulation->bVerbose);
+        simulation->bVerbose = TRUE;
+    }
+    if (simulation->pszResultFile != NULL)
+        simulation->resultSink = newResultSink(simulation->pszResultFile);
+    if (simulation->dSteadyHalfWidth > 0.0)
+        simulation->steadyState = newSteadyState(simulation->dSteadyHalfWidth
+                                                 , simulation->bSteadyRelative);
     
     //Format header differently depending if we're in verbose mode or not
-    if (simulation->bVerbose == TRUE)
+    if (simulation->bVerbose == TRUE && simulation->traceSink == NULL)
         printf("Time\t Widget\t Event\n");
     else
         printf("Time\t       \t Event");
     
-    //iterate while there are events to process in the linked-list
-    while (removeLL(simulation->eventList, &event))
+    dStart = wallSeconds();
+    simulate(simulation, iTimeLimit, &result);
+    simulation->stats.dSimulateSeconds = wallSeconds() - dStart;
+    
+    if (simulation->traceSink != NULL)
+    {
+        closeTraceSink(simulation->traceSink);
+        simulation->traceSink = NULL;
+    }
+    if (simulation->resultSink != NULL)
+    {
+        closeResultSink(simulation->resultSink);
+        simulation->resultSink = NULL;
+    }
+    if (simulation->pszCheckpointFile != NULL)
+        writeSnapshot(simulation, simulation->pszCheckpointFile);
+    
+    dStart = wallSeconds();
+    printSimulationResult(simulation, &result);
+    simulation->stats.dReportSeconds = wallSeconds() - dStart;
+    if (simulation->bStats == TRUE)
+        printStatsJson(simulation);
+    
+    //The simulation is complete. Free up our memory
+    if (simulation->steadyState != NULL)
+    {
+        freeSteadyState(simulation->steadyState);
+        simulation->steadyState = NULL;
+    }
+    freeSimulation(simulation);
+}
+/************************ printSimulationResult ***************************
+ void printSimulationResult(Simulation simulation, SimulationResult *pResult)
+ Purpose:
+ Prints the statistics of a finished run: the averages, and the
+ steady-state estimates (-S), percentiles (-H), histogram file (-J) and
+ allocation counts (-m) when they were asked for.
+ Parameters:
+ I  Simulation simulation           The simulation that was run
+ I  SimulationResult *pResult       Its result from simulate
+ **************************************************************************/
+void printSimulationResult(Simulation simulation, SimulationResult *pResult)
+{
+    int i;
+    
+    //print simulation statistics
+    if (pResult->bTimeLimitReached == TRUE)
+        printf("\n%d\t\t Simulation stopped at the time limit for alternative A.\n\n"
+               , pResult->iClock);
+    else if (pResult->bSteadyStop == TRUE)
+        printf("\n%d\t\t Simulation stopped at steady state for alternative A.\n\n"
+               , pResult->iClock);
+    else
+        printf("\n%d\t\t Simulation complete for alternative A.\n\n", pResult->iClock);
+    for (i = 0; i < simulation->iServerCount; i++)
+    {
+        if (simulation->queues[i]->lQueueWidgetTotalCount == 0)
+            printf("Average Queue Time for Server %s: no widgets\n"
+                   , simulation->servers[i]->szTag);
+        else
+            printf("Average Queue Time for Server %s: %.1f\n"
+                   , simulation->servers[i]->szTag
+                   , (double) simulation->queues[i]->lQueueWaitSum
+                     / simulation->queues[i]->lQueueWidgetTotalCount);
+    }
+    if (pResult->lWidgetCount == 0)
+        printf("Average time in System: no widgets\n\n");
+    else
+        printf("Average time in System: %.1f\n\n", pResult->dAvgSystemTime);
+    if (simulation->steadyState != NULL)
+        printSteadyState(simulation->steadyState);
+    
+    if (simulation->bPercentiles == TRUE)
+    {
+        char szLabel[48];
+        for (i = 0; i < simulation->iServerCount; i++)
+        {
+            sprintf(szLabel, "Queue Time Percentiles for Server %s"
+                    , simulation->servers[i]->szTag);
+            printPercentiles(szLabel, &simulation->queues[i]->waitHist);
+        }
+        printPercentiles("Time in System Percentiles", &simulation->systemHist);
+        printf("\n");
+    }
+    if (simulation->pszHistogramFile != NULL)
+    {
+        Histogram **waitHists = (Histogram **)malloc(simulation->iServerCount
+                                                     * sizeof(Histogram *));
+        if (waitHists == NULL)
+            ErrExit(ERR_ALGORITHM, "No available memory for the histograms");
+        for (i = 0; i < simulation->iServerCount; i++)
+            waitHists[i] = &simulation->queues[i]->waitHist;
+        writeHistogramJson(simulation->pszHistogramFile, simulation->iServerCount
+                           , waitHists, &simulation->systemHist);
+        free(waitHists);
+    }
+    
+    if (simulation->bMemoryReport == TRUE)
     {
+        printNodePoolReport("Event list", &simulation->eventList->nodePool);
+        for (i = 0; i < simulation->iServerCount; i++)
+        {
+#ifndef QUEUE_RING
+            printNodePoolReport(simulation->queues[i]->szQName
+                                , &simulation->queues[i]->nodePool);
+#else
+            printf("%s ring capacity: %ld\n", simulation->queues[i]->szQName
+                   , simulation->queues[i]->lMask + 1);
+#endif
+        }
+    }
+}
+/***************************** simulate ***********************************
+ void simulate(Simulation simulation, int iTimeLimit
+               , SimulationResult *pResult)
+ Purpose:
+ Runs the event loop until there are no events left, or until the next
+ event is after iTimeLimit. The loop is specialized for verbose and quiet
+ runs (see eventLoop), and each event names its server by index, so the
+ cost per event does not depend on the number of servers.
+ Parameters:
+ I  Simulation simulation           The simulation structure, with its
+                                    arrivals already generated.
+ I  int iTimeLimit                  The maximum amount of time units that
+                                    the simulation is allowed to run for
+                                    (NO_TIME_LIMIT - none).
+ O  SimulationResult *pResult       The statistics of the run
+ Notes:
+ Nothing is printed here except the verbose event trace, so this can also
+ be used by the replication workers.
+ When the time limit stops the run, the clock is set to the limit and the
+ pending events are left in place (see writeSnapshot). With -k a snapshot
+ is also written each time the clock passes a multiple of the interval.
+ In a what-if run (-w) checkWhatIf is called instead, and may end the
+ run early (see cs2123p4_whatif.c). With -S the run ends, with events
+ still pending, once observeSteadyState reports that the estimates have
+ converged.
+ A run that reports no events is computed without them by
+ simulateLindley when it can be (see cs2123p4_lindley.c).
+ **************************************************************************/
+void simulate(Simulation simulation, int iTimeLimit, SimulationResult *pResult)
+{
+#ifndef QUEUE_RING
+    int i;
+    
+    //the queues use the same allocator as the event list
+    for (i = 0; i < simulation->iServerCount; i++)
+        simulation->queues[i]->nodePool.bPooled = simulation->eventList->nodePool.bPooled;
+#endif
+    
+    //independent FIFO queues need no events unless they are reported
+    if (canSimulateLindley(simulation, iTimeLimit) == FALSE
+        || simulateLindley(simulation) == FALSE)
+    {
+        int bRecord = simulation->resultSink != NULL || simulation->steadyState != NULL;
+        
+        if (bRecord == FALSE && simulation->bVerbose == TRUE)
+            eventLoop(simulation, iTimeLimit, TRUE, FALSE);
+        else if (bRecord == FALSE)
+            eventLoop(simulation, iTimeLimit, FALSE, FALSE);
+        else if (simulation->bVerbose == TRUE)
+            eventLoop(simulation, iTimeLimit, TRUE, TRUE);
+        else
+            eventLoop(simulation, iTimeLimit, FALSE, TRUE);
+    }
+    
+    pResult->bTimeLimitReached = simulation->bSteadyStop == FALSE
+                                 && nextEventTime(simulation) != NO_EVENT_TIME;
+    if (pResult->bTimeLimitReached == TRUE)
+        simulation->iClock = iTimeLimit;
+    
+    summarizeSimulation(simulation, pResult);
+}
+/***************************** eventLoop **********************************
+ void eventLoop(Simulation simulation, int iTimeLimit, const int bTrace
+                const int bRecord)
+ Purpose:
+ The loop of simulate, processing the events up to iTimeLimit.
+ Parameters:
+ I  Simulation simulation           The simulation structure
+ I  int iTimeLimit                  Last time to process events at
+ I  const int bTrace                TRUE - report the verbose events
+ I  const int bRecord               TRUE - pass each widget that leaves
+                                    to simulation->resultSink and
+                                    simulation->steadyState
+ Both flags must be constants, so that each use is compiled for its
+ mode.
+ Notes:
+ The handlers are called directly by event type and inlined into the
+ loop. The checkpoint test is one compare per event that does not take
+ its branch unless -k or -w asked for checkpoints.
+ **************************************************************************/
+ALWAYS_INLINE void eventLoop(Simulation simulation, int iTimeLimit, const int bTrace
+                             , const int bRecord)
+{
+    Event event;
+    int iNextCheckpoint = NO_TIME_LIMIT, iNextTime;
+    
+    if (simulation->whatIf != NULL)
+        iNextCheckpoint = 0;
+    else if (simulation->pszCheckpointFile != NULL && simulation->iCheckpointInterval > 0)
+        iNextCheckpoint = (simulation->iClock / simulation->iCheckpointInterval + 1)
+                        * simulation->iCheckpointInterval;
+    
+    //iterate while there are events to process before the time limit
+    while ((iNextTime = nextEventTime(simulation)) <= iTimeLimit
+           && iNextTime != NO_EVENT_TIME)
+    {
+        //a checkpoint holds the state before the first event past it
+        if (iNextTime >= iNextCheckpoint)
+        {
+            if (simulation->whatIf != NULL)
+            {
+                iNextCheckpoint = checkWhatIf(simulation, iNextTime);
+                if (iNextCheckpoint == WHATIF_CONVERGED)
+                    break;
+            }
+            else
+            {
+                writeSnapshot(simulation, simulation->pszCheckpointFile);
+                while (iNextCheckpoint <= iNextTime)
+                    iNextCheckpoint += simulation->iCheckpointInterval;
+            }
+        }
+        if (nextEvent(simulation, &event) == FALSE)
+            break;
+        
         //advance clock to the next arrival time with each iteration
         simulation->iClock = event.iTime;
         
-        switch(event.iEventType)
+        switch (event.iEventType)
         {
             case EVT_ARRIVAL:
-                if (simulation->bVerbose == TRUE)
-                    printf("%d\t %ld\t Arrived\n", simulation->iClock\
-                           , event.widget.lWidgetNr);
-                
-                if (event.widget.iWhichServer == 1)
-                {
-                    queueUp(simulation, queueM, &event.widget);
-                    seize(simulation, queueM, serverM);
-                }
-                else
-                {
-                    queueUp(simulation, queueW, &event.widget);
-                    seize(simulation, queueW, serverW);
-                }
-                break;
-                
-            case EVT_SERVERM_COMPLETE:
-                release(simulation, queueM, serverM, &event.widget);
-                leaveSystem(simulation, &event.widget);
+                STAT(simulation->stats.lEventCounts[EVT_ARRIVAL]++);
+                arriveImp(simulation, &event, bTrace);
                 break;
-                
-            case EVT_SERVERW_COMPLETE:
-                release(simulation, queueW, serverW, &event.widget);
-                leaveSystem(simulation, &event.widget);
+            case EVT_SERVER_COMPLETE:
+                STAT(simulation->stats.lEventCounts[EVT_SERVER_COMPLETE]++);
+                completeImp(simulation, &event, bTrace, bRecord);
+                if (bRecord == TRUE && simulation->bSteadyStop == TRUE)
+                    return;
                 break;
-                
             default:
                 ErrExit(ERR_ALGORITHM, "Unknown event type: %d\n", event.iEventType);
         }
     }
+}
+//compute the statistics in pResult (all but bTimeLimitReached) from the
+//simulation's clock and accumulators; the per-server averages stay in the
+//simulation, so they must be copied before it is freed
+void summarizeSimulation(Simulation simulation, SimulationResult *pResult)
+{
+    long lWaitSum = 0, lWaitCount = 0;
+    int i;
     
-    //print simulation statistics
-    printf("\n%d\t\t Simulation complete for alternative A.\n\n", simulation->iClock);
-    printf("Average Queue Time for Server M: %.1f\n"\
-           , (double) queueM->lQueueWaitSum / queueM->lQueueWidgetTotalCount);
-    printf("Average Queue Time for Server W: %.1f\n"\
-           , (double) queueW->lQueueWaitSum / queueW->lQueueWidgetTotalCount);
-    printf("Average time in System: %.1f\n\n"\
-           , (double) simulation->lSystemTimeSum / simulation->lWidgetCount);
+    for (i = 0; i < simulation->iServerCount; i++)
+    {
+        lWaitSum += simulation->queues[i]->lQueueWaitSum;
+        lWaitCount += simulation->queues[i]->lQueueWidgetTotalCount;
+    }
+    pResult->iClock = simulation->iClock;
+    pResult->lWidgetCount = simulation->lWidgetCount;
+    for (i = 0; i < simulation->iServerCount; i++)
+        simulation->dAvgQueueTimes[i] = averageQueueTime(simulation, i);
+    pResult->iServerCount = simulation->iServerCount;
+    pResult->dAvgQueueTimes = simulation->dAvgQueueTimes;
+    pResult->dAvgQueueTime = (double) lWaitSum / lWaitCount;
+    pResult->dAvgSystemTime = (double) simulation->lSystemTimeSum / simulation->lWidgetCount;
+    pResult->bSteadyStop = simulation->bSteadyStop;
+}
+/************************** arrive / complete *****************************
+ void arrive(Simulation simulation, Event *pEvent)
+ void complete(Simulation simulation, Event *pEvent)
+ Purpose:
+ The event handlers. arrive queues a widget for the server selected by
+ its iWhichServer and tries to seize that server. complete releases the
+ widget's server and removes the widget from the system.
+ Parameters:
+ I  Simulation simulation               The simulation structure
+ I  Event *pEvent                       The event being processed
+ Notes:
+ iWhichServer is 1 for the first server. A value outside of 1 to
+ iServerCount selects the last server, as any value but 1 used to select
+ server W. arrive stores the server actually used back in the widget
+ table, so complete can find it without checking again.
+ The event loop uses arriveImp and completeImp, specialized for its
+ tracing mode; these entry points, like queueUp, seize, release and
+ leaveSystem, follow simulation->bVerbose.
+ **************************************************************************/
+void arrive(Simulation simulation, Event *pEvent)
+{
+    arriveImp(simulation, pEvent, simulation->bVerbose);
+}
+void complete(Simulation simulation, Event *pEvent)
+{
+    completeImp(simulation, pEvent, simulation->bVerbose
+                , simulation->resultSink != NULL || simulation->steadyState != NULL);
+}
+ALWAYS_INLINE void arriveImp(Simulation simulation, Event *pEvent, const int bTrace)
+{
+    unsigned uWidgetId = pEvent->uWidgetId;
+    int iServer = simulation->widgets.iWhichServer[uWidgetId] - 1;
     
-    //The simulation is complete. Free up our memory
-    free(queueW);
-    free(queueM);
-    free(serverW);
-    free(serverM);
-    free(simulation->eventList);
-    free(simulation);
+    if (iServer < 0 || iServer >= simulation->iServerCount)
+    {
+        iServer = simulation->iServerCount - 1;
+        simulation->widgets.iWhichServer[uWidgetId] = iServer + 1;
+    }
+    
+    if (bTrace == TRUE)
+        traceEvent(simulation, TREC_ARRIVED, simulation->widgets.lWidgetNr[uWidgetId]
+                   , iServer, 0);
+    
+    queueUpImp(simulation, simulation->queues[iServer], uWidgetId, bTrace);
+    seizeImp(simulation, simulation->queues[iServer], simulation->servers[iServer], bTrace);
+}
+ALWAYS_INLINE void completeImp(Simulation simulation, Event *pEvent, const int bTrace
+                               , const int bRecord)
+{
+    int iServer = simulation->widgets.iWhichServer[pEvent->uWidgetId] - 1;
+    
+    releaseImp(simulation, simulation->queues[iServer], simulation->servers[iServer]
+               , pEvent->uWidgetId, bTrace);
+    leaveSystemImp(simulation, pEvent->uWidgetId, bTrace, bRecord);
+}
+//average queue time of server iServer, NaN when there is no such server
+double averageQueueTime(Simulation simulation, int iServer)
+{
+    if (iServer >= simulation->iServerCount)
+        return NAN;
+    return (double) simulation->queues[iServer]->lQueueWaitSum
+           / simulation->queues[iServer]->lQueueWidgetTotalCount;
 }
 /****************************** seize *************************************
  void seize(Simulation simulation, Queue queue, Server server)
@@ -160,6 +484,11 @@ void runSimulation(Simulation simulation, int iTimeLimit)
  waiting to be processed. The first widget in will be the first widget out.
  **************************************************************************/
 void seize(Simulation simulation, Queue queue, Server server)
+{
+    seizeImp(simulation, queue, server, simulation->bVerbose);
+}
+ALWAYS_INLINE void seizeImp(Simulation simulation, Queue queue, Server server
+                            , const int bTrace)
 {
     //Only execute the body of the function (seize the server)
     //if the server is not marked busy
@@ -167,6 +496,7 @@ void seize(Simulation simulation, Queue queue, Server server)
     {
         QElement qElement;
         Event eventServerComplete;
+        WidgetTable *pWidgets = &simulation->widgets;
         int iWaited;
         
         //mark the server as busy, and remove a widget from the queue
@@ -174,39 +504,27 @@ void seize(Simulation simulation, Queue queue, Server server)
         removeQ(queue, &qElement);
         
         //assign the widget to the server
-        server->widget = qElement.widget;
+        server->uWidgetId = qElement.uWidgetId;
         
         //update statistics
         iWaited = simulation->iClock - qElement.iEnterQTime;
         queue->lQueueWaitSum += iWaited;
+        recordHistogram(&queue->waitHist, iWaited);
         
-        if (simulation->bVerbose == TRUE)
-            printf("%d\t %ld\t Seized server %s\n", simulation->iClock\
-                   , qElement.widget.lWidgetNr, server->szServerName);
+        if (bTrace == TRUE)
+            traceEvent(simulation, TREC_SEIZED, pWidgets->lWidgetNr[qElement.uWidgetId]
+                       , server->iIndex, 0);
         
         //set the values of our completion event
-        eventServerComplete.iTime = simulation->iClock + server->widget.iStep1tu\
-            + server->widget.iStep2tu;
-        eventServerComplete.widget.lWidgetNr = server->widget.lWidgetNr;
-        eventServerComplete.widget.iWhichServer = server->widget.iWhichServer;
-        eventServerComplete.widget.iArrivalTime = server->widget.iArrivalTime;
+        eventServerComplete.iTime = simulation->iClock\
+            + pWidgets->iStep1tu[qElement.uWidgetId]\
+            + pWidgets->iStep2tu[qElement.uWidgetId];
+        eventServerComplete.iEventType = EVT_SERVER_COMPLETE;
+        eventServerComplete.uWidgetId = qElement.uWidgetId;
         
-        if (eventServerComplete.widget.iWhichServer == 1)
-        {
-            eventServerComplete.iEventType = EVT_SERVERM_COMPLETE;
-            
-            if (simulation->bVerbose == TRUE)
-                printf("%d\t %ld\t Leave Queue M, waited %d\n"\
-                       , simulation->iClock, qElement.widget.lWidgetNr, iWaited);
-        }
-        else
-        {
-            eventServerComplete.iEventType = EVT_SERVERW_COMPLETE;
-            
-            if (simulation->bVerbose == TRUE)
-                printf("%d\t %ld\t Leave Queue W, waited %d\n"\
-                       , simulation->iClock, qElement.widget.lWidgetNr, iWaited);
-        }
+        if (bTrace == TRUE)
+            traceEvent(simulation, TREC_LEAVE_QUEUE, pWidgets->lWidgetNr[qElement.uWidgetId]
+                       , server->iIndex, iWaited);
         
         //finally, store the event in our linked-list
         insertOrderedLL(simulation->eventList, eventServerComplete);
@@ -215,129 +533,363 @@ void seize(Simulation simulation, Queue queue, Server server)
 /************************** generateArrival *******************************
  void generateArrival(Simulation simulation)
  Purpose:
- Our arrival events are provided from input. This function scans the input
- (generally a file), and stores it in a linked list.
+ Our arrival events are provided from input. This function opens the input
+ (generally a file), and stores its arrivals in the event list. In streaming
+ mode (-s) only the first arrivals are read; nextEvent reads the rest on
+ demand. With -t the file is first parsed in parallel by mapArrivals, and
+ a binary trace is loaded by mapBinaryTrace.
  Parameters:
  Simulation simulation                  The simulation structure
  Notes:
  The scanned in events are stored in the linked list, which is inside of 
  the simulation object. Timing related information is based on the 
- simulation clock and iArrivalDelta(provided by input).
+ arrival clock and iArrivalDelta(provided by input).
  **************************************************************************/
 void generateArrival(Simulation simulation)
 {
     Event eventArrival;
+    
+    openArrivals(simulation);
+    
+    if (simulation->bStreaming == TRUE)
+    {
+        readArrivalGroup(simulation);
+        return;
+    }
+    
+    //create an arrival event in our linked list for each input line
+    while (readArrival(simulation, &eventArrival))
+        insertOrderedLL(simulation->eventList, eventArrival);
+}
+//open the input for readArrival, mapping or parsing it first when it can be
+void openArrivals(Simulation simulation)
+{
+    if (strcmp(simulation->pszInputFile, "-") != 0
+        && isBinaryTrace(simulation->pszInputFile))
+        mapBinaryTrace(simulation);
+    else if (simulation->iParseThreads >= 0
+        && strcmp(simulation->pszInputFile, "-") != 0)
+        mapArrivals(simulation);
+    else if (strcmp(simulation->pszInputFile, "-") == 0)
+        simulation->pInputFile = stdin;
+    else
+        simulation->pInputFile = fopen(simulation->pszInputFile, "r");
+    
+    if (simulation->pInputFile == NULL && simulation->arrivalWidgets == NULL)
+        ErrExit(ERR_BAD_INPUT, "Unable to open input file '%s'"
+                , simulation->pszInputFile);
+}
+/**************************** readArrival *********************************
+ int readArrival(Simulation simulation, Event *pEventArrival)
+ Purpose:
+ Reads the next widget from the input, adds it to the widget table and
+ builds its arrival event. When the input was parsed by mapArrivals (or
+ given to loadWidgets), the widget is taken from simulation->arrivalWidgets
+ instead, and a library simulation fed by streamWidgets asks its source.
+ Parameters:
+ I  Simulation simulation               The simulation structure
+ O  Event *pEventArrival                The arrival event for the widget
+ Returns:
+ TRUE if an arrival was read, FALSE at the end of the input (EOF or an
+ empty line).
+ Notes:
+ The arrival clock is advanced by iArrivalDelta so that the next arrival
+ time is correct. A line without five integers is ERR_BAD_INPUT.
+ **************************************************************************/
+int readArrival(Simulation simulation, Event *pEventArrival)
+{
     char szInputBuffer[MAX_LINE_SIZE];
+    Widget widget;
     int iArrivalDelta;
-
-    FILE *inputFile;
-    inputFile = fopen(INPUT_FILE, "r");
-
-    //set event types
-    eventArrival.iEventType = EVT_ARRIVAL;
     
-    //iterate with each \n delimited line from standard input
-    //create an arrival event in our linked list with each iteration
-    while (fgets(szInputBuffer, 100, inputFile) != NULL)
+    if (simulation->pfnWidgetSource != NULL)
     {
-        if (szInputBuffer[0] == '\n')
-            break;
-
-        //scan data into eventArrival and iArrivalDelta
-        sscanf(szInputBuffer, "%ld %d %d %d %d", &eventArrival.widget.lWidgetNr\
-               , &eventArrival.widget.iStep1tu, &eventArrival.widget.iStep2tu\
-               , &iArrivalDelta, &eventArrival.widget.iWhichServer);
+        //nextWidget holds the widget to return, unless the source has ended
+        if (simulation->bInputDone == TRUE)
+            return FALSE;
+        widget = simulation->nextWidget;
+        if (simulation->pfnWidgetSource(simulation->pSourceContext
+                                        , &simulation->nextWidget) == FALSE)
+            simulation->bInputDone = TRUE;
+        else if (simulation->nextWidget.iArrivalTime < widget.iArrivalTime)
+            ErrExit(ERR_BAD_INPUT, "Widget %ld arrives before widget %ld"
+                    , simulation->nextWidget.lWidgetNr, widget.lWidgetNr);
+        simulation->lArrivalNext++;
+        simulation->iArrivalClock = simulation->bInputDone == TRUE ? widget.iArrivalTime
+                                  : simulation->nextWidget.iArrivalTime;
         
-        //populate the rest of eventArrival
-        eventArrival.iTime = simulation->iClock;
-        eventArrival.widget.iArrivalTime = simulation->iClock;
+        pEventArrival->iEventType = EVT_ARRIVAL;
+        pEventArrival->iTime = widget.iArrivalTime;
+        pEventArrival->uWidgetId = addWidget(&simulation->widgets, &widget);
+        return TRUE;
+    }
+    
+    if (simulation->arrivalWidgets != NULL)
+    {
+        if (simulation->lArrivalNext >= simulation->lArrivalTotal)
+            return FALSE;
+        widget = simulation->arrivalWidgets[simulation->lArrivalNext++];
         
-        //insert the arrival into our linked list
-        insertOrderedLL(simulation->eventList, eventArrival);
+        //parameter sweep configuration
+        if (simulation->dStepScale != 1.0)
+        {
+            widget.iStep1tu = (int)(widget.iStep1tu * simulation->dStepScale + 0.5);
+            widget.iStep2tu = (int)(widget.iStep2tu * simulation->dStepScale + 0.5);
+        }
+        if (simulation->iForceServer == ROUTE_SPREAD)
+            widget.iWhichServer = (int)(widget.lWidgetNr % simulation->iServerCount) + 1;
+        else if (simulation->iForceServer != 0)
+            widget.iWhichServer = simulation->iForceServer;
         
-        //advance the clock so that the next arrival time is correct
-        simulation->iClock = simulation->iClock + iArrivalDelta;
+        pEventArrival->iEventType = EVT_ARRIVAL;
+        pEventArrival->iTime = widget.iArrivalTime;
+        pEventArrival->uWidgetId = addWidget(&simulation->widgets, &widget);
+        
+        //the arrival clock is the next widget's arrival time
+        if (simulation->lArrivalNext < simulation->lArrivalTotal)
+            simulation->iArrivalClock
+                = simulation->arrivalWidgets[simulation->lArrivalNext].iArrivalTime;
+        else
+            simulation->iArrivalClock = simulation->iArrivalEndClock;
+        return TRUE;
+    }
+    
+    if (simulation->bInputDone == TRUE
+        || fgets(szInputBuffer, MAX_LINE_SIZE, simulation->pInputFile) == NULL
+        || szInputBuffer[0] == '\n')
+    {
+        simulation->bInputDone = TRUE;
+        return FALSE;
     }
+    
+    //scan data into the widget and iArrivalDelta
+    if (sscanf(szInputBuffer, "%ld %d %d %d %d", &widget.lWidgetNr\
+               , &widget.iStep1tu, &widget.iStep2tu\
+               , &iArrivalDelta, &widget.iWhichServer) != 5)
+        ErrExit(ERR_BAD_INPUT, "Line %ld of '%s' does not hold five integers"
+                , simulation->lArrivalNext + 1, simulation->pszInputFile);
+    
+    //populate the rest of the widget and the event
+    widget.iArrivalTime = simulation->iArrivalClock;
+    pEventArrival->iEventType = EVT_ARRIVAL;
+    pEventArrival->iTime = simulation->iArrivalClock;
+    pEventArrival->uWidgetId = addWidget(&simulation->widgets, &widget);
+    
+    //advance the clock so that the next arrival time is correct
+    simulation->iArrivalClock += iArrivalDelta;
+    simulation->lArrivalNext++;
+    return TRUE;
+}
+/************************** readArrivalGroup ******************************
+ void readArrivalGroup(Simulation simulation)
+ Purpose:
+ Streaming mode look-ahead. Reads the next arrival from the input along
+ with every following arrival at the same time (iArrivalDelta of 0).
+ Parameters:
+ I  Simulation simulation               The simulation structure
+ Notes:
+ The event list places a new event ahead of earlier events with the same
+ time, so when all arrivals are loaded up front, simultaneous arrivals are
+ processed last line first. Reading the whole group lets nextEvent hand
+ them out in that same order. Memory is bounded by the longest run of
+ simultaneous arrivals rather than by the length of the input.
+ **************************************************************************/
+void readArrivalGroup(Simulation simulation)
+{
+    Event eventArrival;
+    
+    simulation->iArrivalGroupCount = 0;
+    do
+    {
+        if (readArrival(simulation, &eventArrival) == FALSE)
+            break;
+        
+        if (simulation->iArrivalGroupCount == simulation->iArrivalGroupCapacity)
+        {
+            int iNewCapacity = simulation->iArrivalGroupCapacity == 0 ? 8
+                             : simulation->iArrivalGroupCapacity * 2;
+            Event *pNewGroup = (Event *)realloc(simulation->arrivalGroup
+                                               , iNewCapacity * sizeof(Event));
+            if (pNewGroup == NULL)
+                ErrExit(ERR_ALGORITHM, "No available memory for arrivals");
+            simulation->arrivalGroup = pNewGroup;
+            simulation->iArrivalGroupCapacity = iNewCapacity;
+        }
+        simulation->arrivalGroup[simulation->iArrivalGroupCount++] = eventArrival;
+    } while (simulation->iArrivalClock == eventArrival.iTime);
+}
+/***************************** nextEvent **********************************
+ int nextEvent(Simulation simulation, Event *pEvent)
+ Purpose:
+ Removes the next event to process. Outside of streaming mode this is just
+ the head of the event list. In streaming mode the event list only holds
+ completion events, which are merged with the look-ahead arrivals.
+ Parameters:
+ I  Simulation simulation               The simulation structure
+ O  Event *pEvent                       The next event
+ Returns:
+ TRUE if an event was returned, FALSE when there are no more events.
+ Notes:
+ A completion event is processed before an arrival with the same time,
+ matching the order the event list gives when arrivals are loaded first.
+ **************************************************************************/
+int nextEvent(Simulation simulation, Event *pEvent)
+{
+    Event *pArrival;
+    
+    if (simulation->bStreaming == FALSE)
+        return removeLL(simulation->eventList, pEvent);
+    
+    if (simulation->iArrivalGroupCount == 0)
+        return removeLL(simulation->eventList, pEvent);
+    
+    pArrival = &simulation->arrivalGroup[simulation->iArrivalGroupCount - 1];
+    if (peekTimeLL(simulation->eventList) <= pArrival->iTime
+        && removeLL(simulation->eventList, pEvent))
+        return TRUE;
+    
+    *pEvent = *pArrival;
+    if (--simulation->iArrivalGroupCount == 0)
+        readArrivalGroup(simulation);
+    return TRUE;
+}
+//time of the event nextEvent would return, NO_EVENT_TIME when there is none
+int nextEventTime(Simulation simulation)
+{
+    int iTime = peekTimeLL(simulation->eventList);
+    
+    if (simulation->bStreaming == TRUE && simulation->iArrivalGroupCount > 0
+        && simulation->arrivalGroup[simulation->iArrivalGroupCount - 1].iTime < iTime)
+        iTime = simulation->arrivalGroup[simulation->iArrivalGroupCount - 1].iTime;
+    return iTime;
 }
 /***************************** queueUp ************************************
- void queueUp(Simulation simulation, Queue queue, Widget *pWidget)
+ void queueUp(Simulation simulation, Queue queue, unsigned uWidgetId)
  Purpose:
  Place incoming widgets into a queue, which provides serialization in case
  a server is not available for immediate processing.
  Parameters:
  I Simulation simulation            The simulation structure
  I Queue queue                      The queue we will be inserting into
- I Widget *pWidget                  A pointer to the widget that will be
-                                    pushed into the server
+ I unsigned uWidgetId               The widget (its id in the widget
+                                    table) that will be pushed into the
+                                    server
  Notes:
  This function also sets the time the widget entered the queue, which is 
  based on the current clock time, and increments the count of widgets 
  inserted into the queue. This is used for calculating simulation statistics.
  **************************************************************************/
-void queueUp(Simulation simulation, Queue queue, Widget *pWidget)
+void queueUp(Simulation simulation, Queue queue, unsigned uWidgetId)
+{
+    queueUpImp(simulation, queue, uWidgetId, simulation->bVerbose);
+}
+ALWAYS_INLINE void queueUpImp(Simulation simulation, Queue queue, unsigned uWidgetId
+                              , const int bTrace)
 {
     QElement qElement;
-    qElement.widget = *pWidget;
+    qElement.uWidgetId = uWidgetId;
     qElement.iEnterQTime = simulation->iClock;
     
     insertQ(queue, qElement);
     
     queue->lQueueWidgetTotalCount++;
     
-    if (simulation->bVerbose == TRUE)
-        printf("%d\t %ld\t Enter %s\n", simulation->iClock, qElement.widget.lWidgetNr\
-        , queue->szQName);
+    if (bTrace == TRUE)
+        traceEvent(simulation, TREC_ENTER, simulation->widgets.lWidgetNr[uWidgetId]
+                   , queue->iIndex, 0);
 }
 /**************************** release *************************************
- void release(Simulation simulation, Queue queue, Server server, Widget *pWidget)
+ void release(Simulation simulation, Queue queue, Server server
+              , unsigned uWidgetId)
  Purpose:
  Relase a server so that it can process a widget
  Parameters:
  I Simulation simulation            The simulation structure
  I Queue queue                      The queue we will pull from
  I Server server                    The server that will be released
- I Widget *pWidget                  A pointer to the widget that the server
-                                    processed
+ I unsigned uWidgetId               The widget (its id in the widget
+                                    table) that the server processed
  Notes:
  In addition to releasing a server, this function also seizes the server so 
  that it can process another widget. If release did not do this, we would have
  to wait until the next clock cycle (which would skew our processing times)
  **************************************************************************/
-void release(Simulation simulation, Queue queue, Server server, Widget *pWidget)
+void release(Simulation simulation, Queue queue, Server server, unsigned uWidgetId)
+{
+    releaseImp(simulation, queue, server, uWidgetId, simulation->bVerbose);
+}
+ALWAYS_INLINE void releaseImp(Simulation simulation, Queue queue, Server server
+                              , unsigned uWidgetId, const int bTrace)
 {
     server->bBusy = FALSE;
     
-    if (simulation->bVerbose == TRUE)
-        printf("%d\t %ld\t Released server W\n", simulation->iClock, pWidget->lWidgetNr);
+    if (bTrace == TRUE)
+        traceEvent(simulation, TREC_RELEASED, simulation->widgets.lWidgetNr[uWidgetId]
+                   , server->iIndex, 0);
     
     //don't seize if the queue is empty
-    if (queue->pHead != NULL)
-        seize(simulation, queue, server);
+    if (!isEmptyQ(queue))
+        seizeImp(simulation, queue, server, bTrace);
 }
 /************************ leaveSystem *************************************
- void leaveSystem(Simulation simulation, Widget *pWidget)
+ void leaveSystem(Simulation simulation, unsigned uWidgetId)
  Purpose:
  When a server has completed processing step1 and step2 for a widget, the 
  widget will be removed from the system.
  Parameters:
  I Simulation simulation            The simulation struct
- I Widget *pWidget                  A pointer to the widget being removed
+ I unsigned uWidgetId               The widget being removed (its id in
+                                    the widget table)
  Notes:
  When a widget is removed from the system, we increment lWidgetCount (the
  amount of widgets processed by the system). We also calculate the amount 
  of time the widget was in the simulation, and then add that to
  lSystemTimeSum, which is the total time that widgets were in the system.
+ With -W the widget's times are also written to the results file, and
+ with -S its wait and time in system are added to the steady-state
+ batches.
+ The widget's row in the widget table is then free for a new widget.
  **************************************************************************/
-void leaveSystem(Simulation simulation, Widget *pWidget)
+void leaveSystem(Simulation simulation, unsigned uWidgetId)
+{
+    leaveSystemImp(simulation, uWidgetId, simulation->bVerbose
+                   , simulation->resultSink != NULL || simulation->steadyState != NULL);
+}
+ALWAYS_INLINE void leaveSystemImp(Simulation simulation, unsigned uWidgetId
+                                  , const int bTrace, const int bRecord)
 {
     simulation->lWidgetCount++;
     
     //total widget time is when is when it arrived subtracted from the
     //the current clock time
-    int iSpentInSystem = simulation->iClock - pWidget->iArrivalTime;
+    int iSpentInSystem = simulation->iClock - simulation->widgets.iArrivalTime[uWidgetId];
     simulation->lSystemTimeSum += iSpentInSystem;
+    recordHistogram(&simulation->systemHist, iSpentInSystem);
     
-    if (simulation->bVerbose == TRUE)
-        printf("%d\t %ld\t Exit System, in system %d\n", simulation->iClock\
-               , pWidget->lWidgetNr, iSpentInSystem);
+    if (bTrace == TRUE)
+        traceEvent(simulation, TREC_EXIT, simulation->widgets.lWidgetNr[uWidgetId]
+                   , 0, iSpentInSystem);
+    if (bRecord == TRUE)
+    {
+        WidgetTable *pWidgets = &simulation->widgets;
+        WidgetResult result;
+        
+        //it entered its queue on arrival, and was served up to now
+        result.lWidgetNr = pWidgets->lWidgetNr[uWidgetId];
+        result.iArrivalTime = pWidgets->iArrivalTime[uWidgetId];
+        result.iEnterQTime = pWidgets->iArrivalTime[uWidgetId];
+        result.iCompleteTime = simulation->iClock;
+        result.iStartTime = simulation->iClock - pWidgets->iStep1tu[uWidgetId]
+                          - pWidgets->iStep2tu[uWidgetId];
+        result.iServer = pWidgets->iWhichServer[uWidgetId];
+        result.iWait = result.iStartTime - result.iArrivalTime;
+        result.iSystemTime = iSpentInSystem;
+        if (simulation->resultSink != NULL)
+            putWidgetResult(simulation->resultSink, &result);
+        if (simulation->steadyState != NULL
+            && observeSteadyState(simulation->steadyState, result.iWait
+                                  , iSpentInSystem, simulation->iClock) == TRUE)
+            simulation->bSteadyStop = TRUE;
+    }
+    removeWidget(&simulation->widgets, uWidgetId);
 }
\ No newline at end of file
@@ -8,9 +8,20 @@ Purpose:
         boolean constants
     Defines typedef for
         Widget
+        TraceHeader (binary widget trace)
+        SnapshotHeader (checkpoint of a simulation)
+        WhatIf (in-memory checkpoints of a what-if run)
+        SteadyState, SteadyStateResult (warm-up and batch means, -S)
+        EventTraceHeader, TraceRecord, TraceSink (verbose event trace)
+        ResultHeader, WidgetResult, ResultSink (per-widget results)
+        WidgetTable (widget fields by column, indexed by widget id)
         Event (instead of Element)
+        NodePool (fixed-size node allocator)
+        Histogram (log-bucketed wait and system times)
+        SimulationStats (--stats counters and timers)
         For Linked List
             NodeLL
+            HeapEntryLL
             LinkedListImp
             LinkedList
         For Queues
@@ -38,9 +49,16 @@ Notes:
 #define MAX_TOKEN 50            // Maximum number of actual characters for a token
 #define MAX_LINE_SIZE 100       // Maximum number of character per input line
 #define MAX_ARRIVAL_TIME 600
-#define MAX_CLOCK_TIME 1000     // Maximum allowed simulation run time
+#define NO_TIME_LIMIT  0x7fffffff   // iTimeLimit when -l is not given
+#define MAX_PARSE_THREADS 64    // Maximum number of input parser threads
+#define MAX_WORKER_THREADS 256  // Maximum number of replication worker threads
+#define MAX_SWEEP_VALUES 64     // Maximum number of values per sweep dimension
+#define MAX_SWEEP_SPEC 1024     // Maximum length of a sweep grid specification
+#define NO_EVENT_TIME  0x7fffffff   // peekTimeLL result for an empty event list
+#define MAX_ERROR_MESSAGE 256   // Maximum length of a library error message
 
-// Error constants (program exit values)
+// Error constants (program exit values, and library return codes)
+#define SIM_OK                0    // library call succeeded
 #define ERR_COMMAND_LINE    900    // invalid command line argument
 #define ERR_ALGORITHM       903    // Error in algorithm - almost anything else
 #define ERR_BAD_INPUT       503    // Bad input 
@@ -49,13 +67,58 @@ Notes:
 #define ERR_MISSING_SWITCH          "missing switch"
 #define ERR_EXPECTED_SWITCH         "expected switch, found"
 #define ERR_MISSING_ARGUMENT        "missing argument for"
+#define ERR_EVENT_LIST_KIND         "expected heap or list, found"
+#define ERR_ENGINE_KIND             "expected auto or event, found"
+#define ERR_ALLOCATOR_KIND          "expected pool or malloc, found"
+#define ERR_THREAD_COUNT            "expected a thread count, found"
+#define ERR_NUMBER                  "expected a non-negative number, found"
+#define ERR_SERVER_COUNT            "expected a server count from 1 to 1024, found"
+#define ERR_TIME                    "expected a time in time units, found"
+#define ERR_HALF_WIDTH              "expected a half-width in time units or percent, found"
 
 // Event Constants
 #define EVT_ARRIVAL          1     // when a widget arrives
-#define EVT_SERVERM_COMPLETE 2     // when a widget completes with server M
-#define EVT_SERVERW_COMPLETE 3     // when a widget completes with server W
-#define EVT_SERVERX_COMPLETE 4     // when a widget completes with server X
-#define EVT_SERVERY_COMPLETE 5     // when a widget completes with server Y
+#define EVT_SERVER_COMPLETE  2     // when a widget completes with its server
+#define EVT_TYPE_COUNT       3     // size of the event handler table
+
+// Server constants
+#define DEFAULT_SERVERS      2     // servers M and W
+#define MAX_SERVERS       1024     // maximum number of servers (-n)
+#define ROUTE_SPREAD        -1     // iForceServer: spread widgets over all servers
+
+// Event list implementation (selected with -e)
+#define EVL_LIST             0     // sorted singly linked list, O(n) insert
+#define EVL_HEAP             1     // binary heap, O(log n) insert and remove
+#define EVL_INITIAL_CAPACITY 64    // initial number of heap slots
+
+// Simulation engine (selected with -E, see cs2123p4_lindley.c)
+#define ENG_AUTO             0     // Lindley recursion when the run allows it
+#define ENG_EVENT            1     // always the event loop
+
+// Node pools
+#define POOL_SLAB_NODES      256   // nodes carved out of each slab
+
+// Instrumentation counters and timers (--stats=json, see cs2123p4_stats.c).
+// STAT(statement) runs statement unless the build defines NO_STATS, which
+// compiles every counter out of the hot path
+#ifdef NO_STATS
+#define STAT(statement)
+#else
+#define STAT(statement)     statement
+#endif
+
+// Widget table
+#define WIDGET_TABLE_INITIAL 64    // initial number of rows
+#define NO_WIDGET_ID  0xffffffffu  // end of the table's free id list
+
+// Histograms: values below 2 * HIST_SUB_HALF are exact, larger ones fall in
+// one of HIST_SUB_HALF buckets per power of two (under 1% relative error)
+#define HIST_SUB_BITS        7
+#define HIST_SUB_HALF        (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS         ((32 - HIST_SUB_BITS) * HIST_SUB_HALF)
+
+// Ring buffer queues (QUEUE_RING build)
+#define QUEUE_INITIAL_CAPACITY 16  // must be a power of two
 
 // exitUsage control 
 #define USAGE_ONLY          0      // user only requested usage information
@@ -81,19 +144,181 @@ typedef struct
     int iWhichServer;       // For the alternatives, this specifies which server
 } Widget;
 
+// Binary widget trace header (see cs2123p4_binary.c)
+#define TRACE_MAGIC "P4TRACE"      // 8 bytes including the terminating zero
+#define TRACE_VERSION 1
+#define TRACE_FLAG_VARINT 1         // records are zigzag varints, not Widgets
+typedef struct
+{
+    char szMagic[8];                // TRACE_MAGIC
+    int iVersion;                   // TRACE_VERSION
+    int iFlags;                     // 0 or TRACE_FLAG_VARINT
+    long long lWidgetCount;         // number of records
+    int iEndClock;                  // arrival clock after the last widget
+    int iRecordSize;                // sizeof(Widget) for raw records, else 0
+} TraceHeader;
+
+// Verbose event trace (-T, see cs2123p4_trace.c)
+#define EVENT_TRACE_MAGIC "P4EVENT"    // 8 bytes including the terminating zero
+#define EVENT_TRACE_VERSION 1
+#define TRACE_RING_RECORDS 65536    // records buffered for the writer, a power of two
+#define TREC_ARRIVED        1       // Arrived
+#define TREC_ENTER          2       // Enter queue iServer
+#define TREC_SEIZED         3       // Seized server iServer
+#define TREC_LEAVE_QUEUE    4       // Leave Queue iServer, waited iValue
+#define TREC_RELEASED       5       // Released server iServer
+#define TREC_EXIT           6       // Exit System, in system iValue
+typedef struct
+{
+    char szMagic[8];                // EVENT_TRACE_MAGIC
+    int iVersion;                   // EVENT_TRACE_VERSION
+    int iRecordSize;                // sizeof(TraceRecord)
+} EventTraceHeader;
+
+// one line of the verbose output
+typedef struct
+{
+    long lWidgetNr;
+    int iTime;                      // clock time of the event
+    int iKind;                      // TREC_ARRIVED ... TREC_EXIT
+    int iServer;                    // subscript of the server (and queue)
+    int iValue;                     // wait or time in system, else 0
+} TraceRecord;
+
+typedef struct TraceSinkImp *TraceSink;    // asynchronous trace writer
+
+// Per-widget results (-W, see cs2123p4_results.c): a ResultHeader, then
+// blocks of at most iBlockRows rows, each a long long row count followed
+// by the columns: lWidgetNr as 8-byte integers, then each int field of
+// WidgetResult from iArrivalTime to iSystemTime as 4-byte integers
+#define RESULT_MAGIC "P4WIDGT"     // 8 bytes including the terminating zero
+#define RESULT_VERSION 1
+#define RESULT_BLOCK_ROWS   65536   // rows per column block
+#define RESULT_INT_COLUMNS  7       // int fields of WidgetResult
+typedef struct
+{
+    char szMagic[8];                // RESULT_MAGIC
+    int iVersion;                   // RESULT_VERSION
+    int iBlockRows;                 // most rows in a block
+    long long lWidgetCount;         // rows in the file, -1 - not known
+} ResultHeader;
+
+// one widget that left the system
+typedef struct
+{
+    long lWidgetNr;
+    int iArrivalTime;               // arrival time in tu
+    int iEnterQTime;                // time it entered its queue
+    int iStartTime;                 // time its server seized it
+    int iCompleteTime;              // time it left the system
+    int iServer;                    // server used, 1 for the first (as iWhichServer)
+    int iWait;                      // queue time
+    int iSystemTime;                // time in system
+} WidgetResult;
+
+typedef struct ResultSinkImp *ResultSink;  // writer of the -W file
+
+// What-if re-simulation (-w, see cs2123p4_whatif.c)
+#define WHATIF_CHECKPOINTS  256     // checkpoints the base run aims to take
+#define WHATIF_CONVERGED    -1      // checkWhatIf: the rest is the base run's
+typedef struct WhatIfImp *WhatIf;   // checkpoints of the base run
+
+// Steady-state estimation (-S, see cs2123p4_steady.c)
+#define STEADY_BATCH_WIDGETS 5      // widgets per batch at the start (MSER-5)
+#define STEADY_MAX_BATCHES  4096    // batches kept; when full, pairs are merged
+#define STEADY_CHECK_BATCHES 64     // batches between checks of the warm-up
+#define STEADY_CI_BATCHES   30      // batch means of the confidence interval
+#define STEADY_T_QUANTILE   2.045   // Student t 97.5% point, STEADY_CI_BATCHES - 1 df
+typedef struct SteadyStateImp *SteadyState;    // batches of a -S run
+
+// the estimates of a -S run, as of its last check
+typedef struct
+{
+    int bWarmedUp;                  // TRUE - the end of the warm-up was found
+    int bConverged;                 // TRUE - both half-widths reached the target
+    long lWarmupWidgets;            // widgets left out as the warm-up
+    int iWarmupTime;                // clock when the last of them left
+    long lBatchWidgets;             // widgets in each of the STEADY_CI_BATCHES
+    double dWaitMean;               // queue wait over all servers
+    double dWaitHalfWidth;          //   and its 95% confidence half-width
+    double dSystemMean;             // time in system
+    double dSystemHalfWidth;
+} SteadyStateResult;
+
+// Simulation snapshot (-c and -x, see cs2123p4_snapshot.c)
+#define SNAPSHOT_MAGIC "P4STATE"    // 8 bytes including the terminating zero
+#define SNAPSHOT_VERSION 2
+typedef struct
+{
+    char szMagic[8];                // SNAPSHOT_MAGIC
+    int iVersion;                   // SNAPSHOT_VERSION
+    int iEventSize;                 // sizeof(Event), guards against a mismatched layout
+    int iElementSize;               // sizeof(QElement)
+    int iServerCount;
+    int bStreaming;
+    int iClock;
+    int iArrivalClock;
+    int bInputDone;
+    int iArrivalGroupCount;         // streaming look-ahead arrivals that follow
+    unsigned uWidgetRows;           // widget table rows that follow
+    unsigned uWidgetFree;           // head of the table's free id list
+    long long lSystemTimeSum;
+    long long lWidgetCount;
+    long long lArrivalsRead;        // widgets read from the input so far
+    long long lEventCount;          // pending events that follow
+} SnapshotHeader;
+
+// typedef for the widget table: each Widget field is a column, and a widget
+// is a row named by its 32-bit id, so events and queue elements carry only
+// the id. The ids of widgets that left the system are reused, linked through
+// their iStep1tu, so the table only grows to the most widgets present at once
+typedef struct
+{
+    long *lWidgetNr;                // Widget fields, one array per field
+    int *iStep1tu;
+    int *iStep2tu;
+    int *iArrivalTime;
+    int *iWhichServer;
+    unsigned uRows;                 // ids handed out so far
+    unsigned uCapacity;             // rows allocated in each column
+    unsigned uFree;                 // first reusable id, NO_WIDGET_ID - none
+} WidgetTable;
+
 // Event typedef
 typedef struct
 {
     int iEventType;         // The type of event as an integer:
                             //    EVT_ARRIVAL - arrival event
-                            //    EVT_SERVERM_COMPLETE - servicing by server M is complete
-                            //    EVT_SERVERW_COMPLETE - servicing by server W is complete
-                            //    EVT_SERVERX_COMPLETE - servicing by server X is complete
-                            //    EVT_SERVERY_COMPLETE - servicing by server Y is complete
+                            //    EVT_SERVER_COMPLETE - servicing of the widget is complete
     int iTime;              // The time the event will occur 
-    Widget widget;          // The widget involved in the event.
+    unsigned uWidgetId;     // The widget involved in the event (its table row).
 } Event;
 
+// typedef for the node pools: fixed-size nodes are recycled through a free
+// list and carved out of slabs that are released in bulk
+typedef struct
+{
+    void *pFree;                    // recycled nodes, linked through their first bytes
+    void *pSlabs;                   // allocated slabs, linked through their first slot
+    size_t iNodeSize;               // size of one node
+    int bPooled;                    // FALSE - plain malloc/free per node (-p malloc)
+    long lAllocCount;               // nodes handed out
+    long lFreeCount;                // nodes given back
+    long lMallocCount;              // calls made to malloc
+    long lPeakInUse;                // most nodes handed out at once (--stats)
+} NodePool;
+
+// typedef for the histograms: constant size whatever the number of values,
+// and two histograms of the same quantity can be added together
+typedef struct
+{
+    long lCounts[HIST_BUCKETS];     // values recorded in each bucket
+    long lTotal;                    // number of values recorded
+    long lSum;                      // sum of the values (for the mean)
+    int iMin;                       // smallest value, valid when lTotal > 0
+    int iMax;                       // largest value, valid when lTotal > 0
+} Histogram;
+
 // typedefs for the Linked Lists used for the event list
 typedef struct NodeLL
 {
@@ -101,9 +326,28 @@ typedef struct NodeLL
     struct NodeLL *pNext;
 } NodeLL;
 
+// heap slot: the ordering key is kept next to the node pointer so that
+// sifting never has to dereference the node
+typedef struct
+{
+    int iTime;                      // copy of pNode->event.iTime
+    long lSeq;                      // insertion sequence number, breaks ties
+    NodeLL *pNode;
+} HeapEntryLL;
+
 typedef struct
 {
     NodeLL *pHead;
+    int iKind;                      // EVL_LIST or EVL_HEAP
+    HeapEntryLL *heap;              // EVL_HEAP - array of heap slots
+    long lHeapCount;                // EVL_HEAP - number of slots in use
+    long lHeapCapacity;             // EVL_HEAP - number of slots allocated
+    long lSeq;                      // EVL_HEAP - next insertion sequence number
+    NodePool nodePool;              // allocator for the NodeLL nodes
+    long lSearchCalls;              // inserts (--stats)
+    long lSearchSteps;              // nodes passed by searchLL, or heap levels
+                                    //   sifted, over all inserts (--stats)
+    long lSearchMax;                // most steps taken by one insert (--stats)
 } LinkedListImp;
 
 typedef LinkedListImp *LinkedList;
@@ -112,7 +356,7 @@ typedef LinkedListImp *LinkedList;
 
 typedef struct
 {
-    Widget widget;
+    unsigned uWidgetId;             // row of the widget in the widget table
     int iEnterQTime;                // time widget was inserted in queue
 } QElement;
 
@@ -122,6 +366,22 @@ typedef struct NodeQ
     struct NodeQ *pNext;
 } NodeQ;
 
+#ifdef QUEUE_RING
+// QUEUE_RING build: the queue is a growable power-of-two ring buffer
+typedef struct 
+{
+    QElement *ring;                 // lMask + 1 elements
+    long lHead;                     // subscript of the first element
+    long lCount;                    // number of elements in the queue
+    long lMask;                     // capacity - 1
+    long lPeakCount;                // most elements queued at once (--stats)
+    long lQueueWaitSum;             // Sum of wait times for the queue
+    long lQueueWidgetTotalCount;    // Total count of widgets that entered queue
+    char szQName[12];
+    int iIndex;                     // subscript in the simulation's queues
+    Histogram waitHist;             // wait times of the widgets that left the queue
+} QueueImp;
+#else
 typedef struct 
 {
     NodeQ *pHead;
@@ -129,7 +389,11 @@ typedef struct
     long lQueueWaitSum;             // Sum of wait times for the queue
     long lQueueWidgetTotalCount;    // Total count of widgets that entered queue
     char szQName[12];
+    int iIndex;                     // subscript in the simulation's queues
+    Histogram waitHist;             // wait times of the widgets that left the queue
+    NodePool nodePool;              // allocator for the NodeQ nodes
 } QueueImp;
+#endif
 
 typedef QueueImp *Queue;
 
@@ -137,23 +401,116 @@ typedef QueueImp *Queue;
 typedef struct
 {
     char szServerName[12];
+    char szTag[6];                  // short name: M, W, X, Y, S5, S6, ...
+    int iIndex;                     // subscript in the simulation's servers
     int bBusy;                      // TRUE - server is busy, FALSE - server is free
-    Widget widget;                  // Widget the server is currently working
+    unsigned uWidgetId;             // Widget the server is currently working
 } ServerImp;
 typedef ServerImp *Server;
 
+// source of widgets for a library simulation (streamWidgets): stores the
+// next widget in *pWidget and returns TRUE, or returns FALSE at the end
+typedef int (*WidgetSource)(void *pContext, Widget *pWidget);
+
+// receives an ErrExit error in place of exiting (setErrorHandler); it must
+// not return
+typedef void (*ErrorHandler)(int iExitRC, char szMessage[]);
+
+// --stats counters and timers kept by the simulation itself; the data
+// structures keep their own (NodePool, LinkedListImp)
+typedef struct
+{
+    long lEventCounts[EVT_TYPE_COUNT];  // events processed, by iEventType
+    double dParseSeconds;           // reading the input before simulating
+    double dSimulateSeconds;        // the event loop (streaming input included)
+    double dReportSeconds;          // printing the statistics
+    int bLindley;                   // TRUE - simulated without events (Lindley)
+    unsigned uWidgetRows;           // widget table rows of the partitions (-P)
+    unsigned uWidgetCapacity;       // widget table capacity of the partitions (-P)
+} SimulationStats;
+
 // typedefs for the Simulation
 typedef struct
 {
     int iClock;                     // clock time
     int bVerbose;                   // When TRUE, this causes printing of event information
+    int bMemoryReport;              // When TRUE, node allocation counts are printed (-m)
     long lSystemTimeSum;            // Sum of times widgets are in the system
     long lWidgetCount;              // The number of widgets processed 
     char cRunType;                  // A - Alternative A, B - Alternative B, C - Current
     LinkedList eventList;
+    int iEngine;                    // ENG_AUTO or ENG_EVENT (-E)
+    WidgetTable widgets;            // the widgets in the system
+    int iServerCount;               // number of servers (and queues), -n
+    Queue *queues;                  // queues[i] feeds servers[i]
+    Server *servers;                // servers[iWhichServer - 1] serves a widget
+    double *dAvgQueueTimes;         // per server, filled by summarizeSimulation
+    char *pszInputFile;             // input path, "-" for standard input
+    FILE *pInputFile;               // input being read
+    int bInputDone;                 // TRUE - the end of the input was reached
+    int iArrivalClock;              // arrival time of the next widget read
+    int bStreaming;                 // TRUE - read arrivals on demand (-s)
+    Event *arrivalGroup;            // streaming look-ahead: simultaneous arrivals
+    int iArrivalGroupCount;         // number of look-ahead arrivals left
+    int iArrivalGroupCapacity;      // number of look-ahead arrivals allocated
+    int iParseThreads;              // -t: parser threads, 0 - one per CPU, -1 - fgets
+    Widget *arrivalWidgets;         // widgets parsed by mapArrivals, NULL when unused
+    long lArrivalTotal;             // number of widgets in arrivalWidgets
+    long lArrivalNext;              // subscript of the next widget to arrive (the
+                                    //   number of widgets read, for any input)
+    int iArrivalEndClock;           // arrival clock after the last widget
+    void *pTraceMap;                // mapped raw binary trace, NULL when unused
+    long lTraceMapSize;             // size of the mapping
+    int iReplications;              // -r: number of replications, 0 - single run
+    int iWorkerThreads;             // -j: replication threads, 0 - one per CPU
+    unsigned long long ullSeed;     // -R: seed for the replication resamples
+    char *pszSweepGrid;             // -g: parameter sweep grid, NULL - single run
+    int bArrivalsBorrowed;          // TRUE - arrivalWidgets belongs to another simulation
+    double dStepScale;              // step time multiplier applied by readArrival
+    int iForceServer;               // iWhichServer forced by readArrival, 0 - as read,
+                                    //   ROUTE_SPREAD - by widget number
+    char *pszTraceFile;             // -T: event trace file, NULL - none
+    TraceSink traceSink;            // writer for pszTraceFile while simulating
+    char *pszResultFile;            // -W: per-widget results file, NULL - none
+    ResultSink resultSink;          // writer for pszResultFile while simulating
+    double dSteadyHalfWidth;        // -S: stop at this half-width, 0 - run to the end
+    int bSteadyRelative;            // TRUE - dSteadyHalfWidth is a fraction of the mean
+    SteadyState steadyState;        // batches of the widgets while simulating
+    int bSteadyStop;                // TRUE - steadyState asked the run to stop
+    int bPercentiles;               // -H: print wait and system time percentiles
+    char *pszHistogramFile;         // -J: JSON histogram file, NULL - none
+    Histogram systemHist;           // times in system of the widgets that left
+    int iTimeLimit;                 // -l: events after this time are not processed
+    char *pszCheckpointFile;        // -c: snapshot written when the run stops
+    int iCheckpointInterval;        // -k: also snapshot every so many time units
+    char *pszResumeFile;            // -x: snapshot to resume from, NULL - none
+    int iPartitions;                // -P: server partitions run in parallel, 0 - none
+    char *pszWhatIfFiles;           // -w: edited copies of the input, NULL - none
+    WhatIf whatIf;                  // checkpoints taken or compared by simulate,
+                                    //   NULL - none
+    int bStats;                     // --stats=json: print the counters as JSON
+    SimulationStats stats;
+    WidgetSource pfnWidgetSource;   // library: widgets from a callback, NULL - none
+    void *pSourceContext;           // passed to pfnWidgetSource
+    Widget nextWidget;              // pfnWidgetSource look-ahead
+    char szError[MAX_ERROR_MESSAGE];    // library: message of the last error
 } SimulationImp;
 typedef SimulationImp *Simulation;
 
+// statistics of one simulation run
+typedef struct
+{
+    int iClock;                     // clock time when the simulation completed
+    long lWidgetCount;              // The number of widgets processed
+    int iServerCount;               // entries of dAvgQueueTimes
+    double *dAvgQueueTimes;         // Average queue time of each server (NaN when
+                                    //   it had no widgets), owned by the simulation
+    double dAvgQueueTime;           // Average queue time over all servers
+    double dAvgSystemTime;          // Average time in system
+    int bTimeLimitReached;          // TRUE - stopped with events still pending
+    int bSteadyStop;                // TRUE - stopped early at steady state (-S)
+} SimulationResult;
+
 /**********   prototypes ***********/
 
 // linked list functions - you must provide the code for these (see course notes)
@@ -162,24 +519,133 @@ NodeLL *insertOrderedLL(LinkedList list, Event value);
 NodeLL *searchLL(LinkedList list, int match, NodeLL **ppPrecedes);
 LinkedList newLinkedList();
 NodeLL *allocateNodeLL(LinkedList list, Event value);
+int peekTimeLL(LinkedList list);
+void setEventListKind(LinkedList list, int iKind);
+void freeLinkedList(LinkedList list);
 
 // queue functions
 int removeQ(Queue queue, QElement *pFromQElement);
 void  insertQ(Queue queue, QElement element);
 NodeQ *allocNodeQ(Queue queue, QElement value);
 Queue newQueue(char szQueueNm[]);
+void freeQueue(Queue queue);
+int isEmptyQ(Queue queue);
+
+// widget table functions
+void initWidgetTable(WidgetTable *pTable);
+void reserveWidgetTable(WidgetTable *pTable, unsigned uCapacity);
+unsigned addWidget(WidgetTable *pTable, Widget *pWidget);
+void removeWidget(WidgetTable *pTable, unsigned uWidgetId);
+void freeWidgetTable(WidgetTable *pTable);
+
+// node pool functions
+void initNodePool(NodePool *pool, size_t iNodeSize);
+void *allocNodePool(NodePool *pool);
+void freeNodePool(NodePool *pool, void *pNode);
+void releaseNodePool(NodePool *pool);
 
 // simulation functions
 void runSimulation(Simulation simulation, int iTimeLimit);
+void simulate(Simulation simulation, int iTimeLimit, SimulationResult *pResult);
+void summarizeSimulation(Simulation simulation, SimulationResult *pResult);
+void printSimulationResult(Simulation simulation, SimulationResult *pResult);
+void arrive(Simulation simulation, Event *pEvent);
+void complete(Simulation simulation, Event *pEvent);
+double averageQueueTime(Simulation simulation, int iServer);
 void generateArrival(Simulation simulation);
+void openArrivals(Simulation simulation);
+int readArrival(Simulation simulation, Event *pEventArrival);
+void readArrivalGroup(Simulation simulation);
+int nextEvent(Simulation simulation, Event *pEvent);
+int nextEventTime(Simulation simulation);
+
+// parallel input parser
+void mapArrivals(Simulation simulation);
+long parseArrivals(Simulation simulation, const char *pszText, long lSize);
+
+// replication runner and parameter sweep
+int runWorkPool(long lJobs, int iThreads
+                , void (*runJob)(void *pContext, long lJob), void *pContext);
+void runReplications(Simulation simulation, int iTimeLimit);
+void runSweep(Simulation simulation, int iTimeLimit);
+
+// partitioned parallel simulation
+void runParallel(Simulation simulation, int iTimeLimit);
+
+// event-free simulation of independent FIFO queues
+int canSimulateLindley(Simulation simulation, int iTimeLimit);
+int simulateLindley(Simulation simulation);
+
+// binary widget trace
+int isBinaryTrace(char szPath[]);
+void mapBinaryTrace(Simulation simulation);
+void writeBinaryTrace(FILE *pFile, Widget widgets[], long lCount
+                      , int iEndClock, int iFlags);
+void writeTraceHeader(FILE *pFile, long lCount, int iEndClock, int iFlags);
+void writeTraceRecords(FILE *pFile, Widget widgets[], long lCount, int iFlags
+                       , Widget *pPrevious);
+
+// what-if re-simulation
+void runWhatIf(Simulation simulation, int iTimeLimit);
+int checkWhatIf(Simulation simulation, int iNextTime);
+
+// simulation snapshots
+void writeSnapshot(Simulation simulation, char szPath[]);
+void readSnapshot(Simulation simulation, char szPath[]);
+
+// verbose event trace
+TraceSink newTraceSink(char szPath[], int bText);
+void putTraceRecord(TraceSink sink, TraceRecord *pRecord);
+void closeTraceSink(TraceSink sink);
+void printTraceRecord(FILE *pFile, TraceRecord *pRecord);
+
+// per-widget results
+ResultSink newResultSink(char szPath[]);
+void putWidgetResult(ResultSink sink, WidgetResult *pResult);
+void closeResultSink(ResultSink sink);
+void printWidgetResult(FILE *pFile, WidgetResult *pResult);
+
+// steady-state estimation
+SteadyState newSteadyState(double dHalfWidth, int bRelative);
+int observeSteadyState(SteadyState steady, int iWait, int iSystemTime, int iClock);
+void printSteadyState(SteadyState steady);
+void freeSteadyState(SteadyState steady);
+
+// instrumentation report
+void printStatsJson(Simulation simulation);
+
+// simulation library (cs2123p4_lib.c): reentrant, nothing is printed and
+// errors are returned as the ERR_... codes instead of exiting
+int createSimulation(Simulation *pSimulation, int iServerCount);
+int loadWidgets(Simulation simulation, Widget widgets[], long lCount);
+int streamWidgets(Simulation simulation, WidgetSource pfnSource, void *pContext);
+int loadTraceFile(Simulation simulation, char szPath[]);
+int loadTraceText(Simulation simulation, const char *pszText, long lSize);
+int executeSimulation(Simulation simulation, int iTimeLimit, SimulationResult *pResult);
+ErrorHandler setErrorHandler(ErrorHandler pfnHandler);
+
+// histograms
+void initHistogram(Histogram *pHist);
+void recordHistogram(Histogram *pHist, int iValue);
+void mergeHistogram(Histogram *pTo, Histogram *pFrom);
+int percentileHistogram(Histogram *pHist, double dPercentile);
+void printPercentiles(char szLabel[], Histogram *pHist);
+void writeHistogramJson(char szPath[], int iServerCount, Histogram *waitHists[]
+                        , Histogram *pSystemHist);
 
 // simulation helper functions
-void queueUp(Simulation simulation, Queue queue, Widget *pWidget);
+void queueUp(Simulation simulation, Queue queue, unsigned uWidgetId);
 void seize(Simulation simulation, Queue queue, Server server);
-void release(Simulation simulation, Queue queue, Server server, Widget *pWidget);
-void leaveSystem(Simulation simulation, Widget *pWidget);
+void release(Simulation simulation, Queue queue, Server server, unsigned uWidgetId);
+void leaveSystem(Simulation simulation, unsigned uWidgetId);
 Server newServer(char szServerNm[]);
 Simulation newSimulation();
+void freeSimulation(Simulation simulation);
+void setServerCount(Simulation simulation, int iServerCount);
+void serverTag(int iServer, char szTag[]);
+void printNodePoolReport(char szName[], NodePool *pool);
+unsigned long long nextRandom(unsigned long long *pullState);
+double wallSeconds(void);
 
 // functions in most programs, but require modifications
 void exitUsage(int iArg, char *pszMessage, char *pszDiagnosticInfo);
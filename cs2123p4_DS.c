@@ -8,6 +8,7 @@
  This file contians the standard queue and linked-list routines 
  provided by Larry. As per our previous programs, they do not need 
  to be documented in the same way as the student-written functions.
+ It also holds the node pools and the widget table.
  
  Returns:
  N/A
@@ -19,7 +20,21 @@
 #include <stdlib.h>
 #include "cs2123p4.h"
 
+static int removeHeapLL(LinkedList list, Event *pValue);
+static NodeLL *insertHeapLL(LinkedList list, Event value);
+
+#ifndef NO_STATS
+// --stats: steps taken by one event list insert
+static void recordSearchLL(LinkedList list, long lSteps)
+{
+    list->lSearchSteps += lSteps;
+    if (lSteps > list->lSearchMax)
+        list->lSearchMax = lSteps;
+}
+#endif
+
 //begin queue functions
+#ifndef QUEUE_RING
 int removeQ(Queue queue, QElement *pFromQElement)
 {
     NodeQ *p;
@@ -33,7 +48,7 @@ int removeQ(Queue queue, QElement *pFromQElement)
     // See if we need to update pFoot, due to empty list
     if (queue->pHead == NULL)
         queue->pFoot = NULL;
-    free(p);
+    freeNodePool(&queue->nodePool, p);
     return TRUE;
 }
 
@@ -57,7 +72,7 @@ void insertQ(Queue queue, QElement element)
 NodeQ *allocNodeQ(Queue q, QElement value)
 {
     NodeQ *pNew;
-    pNew = (NodeQ *)malloc(sizeof(NodeQ));
+    pNew = (NodeQ *)allocNodePool(&q->nodePool);
     if (pNew == NULL)
         ErrExit(ERR_ALGORITHM, "No available memory for queue");
     pNew->element = value;
@@ -72,10 +87,98 @@ Queue newQueue(char szQueueNm[])
     q->pHead = NULL;   // empty list
     q->pFoot = NULL;   // empty list
     strcpy(q->szQName, szQueueNm);
+    q->iIndex = 0;
+    initHistogram(&q->waitHist);
+    q->lQueueWaitSum = 0;
+    q->lQueueWidgetTotalCount = 0;
+    initNodePool(&q->nodePool, sizeof(NodeQ));
+    return q;
+}
+
+void freeQueue(Queue queue)
+{
+    QElement element;
+    // pooled nodes go back with their slabs
+    if (queue->nodePool.bPooled == FALSE)
+        while (removeQ(queue, &element))
+            ;
+    releaseNodePool(&queue->nodePool);
+    free(queue);
+}
+
+int isEmptyQ(Queue queue)
+{
+    return queue->pHead == NULL;
+}
+#else
+// QUEUE_RING build: same contract, elements stored contiguously
+int removeQ(Queue queue, QElement *pFromQElement)
+{
+    // check for empty
+    if (queue->lCount == 0)
+        return FALSE;
+    *pFromQElement = queue->ring[queue->lHead];
+    queue->lHead = (queue->lHead + 1) & queue->lMask;
+    queue->lCount--;
+    return TRUE;
+}
+
+void insertQ(Queue queue, QElement element)
+{
+    // grow by doubling, unwrapping the elements into the new ring
+    if (queue->lCount > queue->lMask)
+    {
+        long lCapacity = queue->lMask + 1;
+        long lFirst = lCapacity - queue->lHead;
+        QElement *pNewRing = (QElement *)malloc(2 * lCapacity * sizeof(QElement));
+        if (pNewRing == NULL)
+            ErrExit(ERR_ALGORITHM, "No available memory for queue");
+        if (lFirst > queue->lCount)
+            lFirst = queue->lCount;
+        memcpy(pNewRing, queue->ring + queue->lHead, lFirst * sizeof(QElement));
+        memcpy(pNewRing + lFirst, queue->ring
+               , (queue->lCount - lFirst) * sizeof(QElement));
+        free(queue->ring);
+        queue->ring = pNewRing;
+        queue->lHead = 0;
+        queue->lMask = 2 * lCapacity - 1;
+    }
+    queue->ring[(queue->lHead + queue->lCount) & queue->lMask] = element;
+    queue->lCount++;
+    STAT(if (queue->lCount > queue->lPeakCount)
+             queue->lPeakCount = queue->lCount);
+}
+
+Queue newQueue(char szQueueNm[])
+{
+    Queue q = (Queue)malloc(sizeof(QueueImp));
+    q->ring = (QElement *)malloc(QUEUE_INITIAL_CAPACITY * sizeof(QElement));
+    if (q->ring == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for queue");
+    q->lHead = 0;
+    q->lCount = 0;   // empty queue
+    q->lMask = QUEUE_INITIAL_CAPACITY - 1;
+    q->lPeakCount = 0;
+    strcpy(q->szQName, szQueueNm);
+    q->iIndex = 0;
+    initHistogram(&q->waitHist);
     q->lQueueWaitSum = 0;
     q->lQueueWidgetTotalCount = 0;
     return q;
 }
+
+void freeQueue(Queue queue)
+{
+    free(queue->ring);
+    free(queue);
+}
+
+int isEmptyQ(Queue queue)
+{
+    return queue->lCount == 0;
+}
+#endif
+
 //end queue functions
 
 //begin linked list functions
@@ -83,22 +186,37 @@ int removeLL(LinkedList list, Event *pValue)
 {
     NodeLL *p;
     
+    if (list->iKind == EVL_HEAP)
+        return removeHeapLL(list, pValue);
+    
     if (list->pHead == NULL)
         return FALSE;
     
     *pValue = list->pHead->event;
     p = list->pHead;
     list->pHead = list->pHead->pNext;
-    free(p);
+    freeNodePool(&list->nodePool, p);
     return TRUE;
 }
 
+// time of the next event without removing it
+int peekTimeLL(LinkedList list)
+{
+    if (list->iKind == EVL_HEAP)
+        return list->lHeapCount == 0 ? NO_EVENT_TIME : list->heap[0].iTime;
+    return list->pHead == NULL ? NO_EVENT_TIME : list->pHead->event.iTime;
+}
+
 NodeLL *insertOrderedLL(LinkedList list, Event value)
 {
     NodeLL *pNew, *pPrecedes;
     
+    if (list->iKind == EVL_HEAP)
+        return insertHeapLL(list, value);
+    
     // call searchLL to properly set our pPrecedes
     searchLL(list, value.iTime, &pPrecedes);
+    STAT(list->lSearchCalls++);
     
     // Allocate a node and insert.
     pNew = allocateNodeLL(list, value);
@@ -121,6 +239,7 @@ NodeLL *insertOrderedLL(LinkedList list, Event value)
 NodeLL *searchLL(LinkedList list, int match, NodeLL **ppPrecedes)
 {
     NodeLL *p;
+    STAT(long lSteps = 0);
     
     // used when the list is empty or we need to insert at the beginning
     *ppPrecedes = NULL;
@@ -129,14 +248,16 @@ NodeLL *searchLL(LinkedList list, int match, NodeLL **ppPrecedes)
     // the end of the list.
     for (p = list->pHead; p != NULL; p = p->pNext)
     {
-        if (match == p->event.iTime)
-            return p;
-        else if (match < p->event.iTime)
-            return NULL;
+        if (match <= p->event.iTime)
+            break;
         *ppPrecedes = p;
+        STAT(lSteps++);
     }
+    STAT(recordSearchLL(list, lSteps));
     
-    // Not found, return NULL
+    // Found when the first later-or-equal node has the key, else NULL
+    if (p != NULL && match == p->event.iTime)
+        return p;
     return NULL;
 }
 
@@ -145,14 +266,43 @@ LinkedList newLinkedList()
     LinkedList list = (LinkedList) malloc(sizeof(LinkedListImp));
     //Mark the list as empty
     list->pHead = NULL;   // empty list
+    list->iKind = EVL_HEAP;
+    list->heap = NULL;
+    list->lHeapCount = 0;
+    list->lHeapCapacity = 0;
+    list->lSeq = 0;
+    list->lSearchCalls = 0;
+    list->lSearchSteps = 0;
+    list->lSearchMax = 0;
+    initNodePool(&list->nodePool, sizeof(NodeLL));
     return list;
 }
 
+// choose the event list implementation; only valid while the list is empty
+void setEventListKind(LinkedList list, int iKind)
+{
+    if (list->pHead != NULL || list->lHeapCount != 0)
+        ErrExit(ERR_ALGORITHM, "Event list kind changed while not empty");
+    list->iKind = iKind;
+}
+
+void freeLinkedList(LinkedList list)
+{
+    Event event;
+    // pooled nodes go back with their slabs
+    if (list->nodePool.bPooled == FALSE)
+        while (removeLL(list, &event))
+            ;
+    releaseNodePool(&list->nodePool);
+    free(list->heap);
+    free(list);
+}
+
 NodeLL *allocateNodeLL(LinkedList list, Event value)
 {
     NodeLL *pNew;
     
-    pNew = (NodeLL *)malloc(sizeof(NodeLL));
+    pNew = (NodeLL *)allocNodePool(&list->nodePool);
     
     if (pNew == NULL)
         ErrExit(ERR_ALGORITHM, "No available memory for linked list");
@@ -161,4 +311,227 @@ NodeLL *allocateNodeLL(LinkedList list, Event value)
     pNew->pNext = NULL;
     return pNew;
 }
-//end queue functions
\ No newline at end of file
+//end linked list functions
+
+//begin event heap functions
+// The heap reproduces the ordering of insertOrderedLL exactly: earliest
+// iTime first and, because searchLL places a new event ahead of events
+// with an equal iTime, the most recently inserted of equal events first.
+static int precedesHeapLL(HeapEntryLL *pA, HeapEntryLL *pB)
+{
+    if (pA->iTime != pB->iTime)
+        return pA->iTime < pB->iTime;
+    return pA->lSeq > pB->lSeq;
+}
+
+static NodeLL *insertHeapLL(LinkedList list, Event value)
+{
+    HeapEntryLL entry;
+    long i, iParent;
+    STAT(long lSteps = 0);
+    
+    if (list->lHeapCount == list->lHeapCapacity)
+    {
+        long lNewCapacity = list->lHeapCapacity == 0 ? EVL_INITIAL_CAPACITY
+                                                     : list->lHeapCapacity * 2;
+        HeapEntryLL *pNewHeap = (HeapEntryLL *)realloc(list->heap
+                                    , lNewCapacity * sizeof(HeapEntryLL));
+        if (pNewHeap == NULL)
+            ErrExit(ERR_ALGORITHM, "No available memory for event heap");
+        list->heap = pNewHeap;
+        list->lHeapCapacity = lNewCapacity;
+    }
+    
+    entry.iTime = value.iTime;
+    entry.lSeq = list->lSeq++;
+    entry.pNode = allocateNodeLL(list, value);
+    
+    // sift up from the new leaf
+    for (i = list->lHeapCount; i > 0; i = iParent)
+    {
+        iParent = (i - 1) / 2;
+        if (!precedesHeapLL(&entry, &list->heap[iParent]))
+            break;
+        list->heap[i] = list->heap[iParent];
+        STAT(lSteps++);
+    }
+    list->heap[i] = entry;
+    list->lHeapCount++;
+    STAT(list->lSearchCalls++);
+    STAT(recordSearchLL(list, lSteps));
+    return entry.pNode;
+}
+
+static int removeHeapLL(LinkedList list, Event *pValue)
+{
+    HeapEntryLL last;
+    long i, iChild, lCount;
+    
+    if (list->lHeapCount == 0)
+        return FALSE;
+    
+    *pValue = list->heap[0].pNode->event;
+    freeNodePool(&list->nodePool, list->heap[0].pNode);
+    
+    // sift the last slot down from the root
+    lCount = --list->lHeapCount;
+    last = list->heap[lCount];
+    for (i = 0; (iChild = 2 * i + 1) < lCount; i = iChild)
+    {
+        if (iChild + 1 < lCount
+            && precedesHeapLL(&list->heap[iChild + 1], &list->heap[iChild]))
+            iChild++;
+        if (!precedesHeapLL(&list->heap[iChild], &last))
+            break;
+        list->heap[i] = list->heap[iChild];
+    }
+    list->heap[i] = last;
+    return TRUE;
+}
+//end event heap functions
+
+//begin node pool functions
+void initNodePool(NodePool *pool, size_t iNodeSize)
+{
+    pool->pFree = NULL;
+    pool->pSlabs = NULL;
+    // a free node must be able to hold the free list link
+    pool->iNodeSize = iNodeSize < sizeof(void *) ? sizeof(void *) : iNodeSize;
+    pool->bPooled = TRUE;
+    pool->lAllocCount = 0;
+    pool->lFreeCount = 0;
+    pool->lMallocCount = 0;
+    pool->lPeakInUse = 0;
+}
+
+void *allocNodePool(NodePool *pool)
+{
+    void *pNode;
+    
+    pool->lAllocCount++;
+    STAT(if (pool->lAllocCount - pool->lFreeCount > pool->lPeakInUse)
+             pool->lPeakInUse = pool->lAllocCount - pool->lFreeCount);
+    if (pool->bPooled == FALSE)
+    {
+        pool->lMallocCount++;
+        pNode = malloc(pool->iNodeSize);
+        if (pNode == NULL)
+            ErrExit(ERR_ALGORITHM, "No available memory for node");
+        return pNode;
+    }
+    
+    if (pool->pFree == NULL)
+    {
+        // the first slot of a slab links the slabs, the rest become free nodes
+        char *pSlab = (char *)malloc(pool->iNodeSize * (POOL_SLAB_NODES + 1));
+        int i;
+        if (pSlab == NULL)
+            ErrExit(ERR_ALGORITHM, "No available memory for node pool");
+        pool->lMallocCount++;
+        *(void **)pSlab = pool->pSlabs;
+        pool->pSlabs = pSlab;
+        for (i = POOL_SLAB_NODES; i >= 1; i--)
+        {
+            void *pFreeNode = pSlab + i * pool->iNodeSize;
+            *(void **)pFreeNode = pool->pFree;
+            pool->pFree = pFreeNode;
+        }
+    }
+    
+    pNode = pool->pFree;
+    pool->pFree = *(void **)pNode;
+    return pNode;
+}
+
+void freeNodePool(NodePool *pool, void *pNode)
+{
+    pool->lFreeCount++;
+    if (pool->bPooled == FALSE)
+    {
+        free(pNode);
+        return;
+    }
+    *(void **)pNode = pool->pFree;
+    pool->pFree = pNode;
+}
+
+// release every slab at once; nodes still in use become invalid
+void releaseNodePool(NodePool *pool)
+{
+    while (pool->pSlabs != NULL)
+    {
+        void *pSlab = pool->pSlabs;
+        pool->pSlabs = *(void **)pSlab;
+        free(pSlab);
+    }
+    pool->pFree = NULL;
+}
+//end node pool functions
+
+//begin widget table functions
+void initWidgetTable(WidgetTable *pTable)
+{
+    memset(pTable, 0, sizeof(WidgetTable));
+    pTable->uFree = NO_WIDGET_ID;
+}
+
+// grow every column to at least uCapacity rows
+void reserveWidgetTable(WidgetTable *pTable, unsigned uCapacity)
+{
+    unsigned uNewCapacity = pTable->uCapacity == 0 ? WIDGET_TABLE_INITIAL
+                          : pTable->uCapacity;
+    
+    if (uCapacity <= pTable->uCapacity)
+        return;
+    while (uNewCapacity < uCapacity)
+        uNewCapacity *= 2;
+    pTable->lWidgetNr = (long *)realloc(pTable->lWidgetNr, uNewCapacity * sizeof(long));
+    pTable->iStep1tu = (int *)realloc(pTable->iStep1tu, uNewCapacity * sizeof(int));
+    pTable->iStep2tu = (int *)realloc(pTable->iStep2tu, uNewCapacity * sizeof(int));
+    pTable->iArrivalTime = (int *)realloc(pTable->iArrivalTime, uNewCapacity * sizeof(int));
+    pTable->iWhichServer = (int *)realloc(pTable->iWhichServer, uNewCapacity * sizeof(int));
+    if (pTable->lWidgetNr == NULL || pTable->iStep1tu == NULL || pTable->iStep2tu == NULL
+        || pTable->iArrivalTime == NULL || pTable->iWhichServer == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the widget table");
+    pTable->uCapacity = uNewCapacity;
+}
+
+// store a widget and return its id, reusing the id of a widget that left
+unsigned addWidget(WidgetTable *pTable, Widget *pWidget)
+{
+    unsigned uWidgetId = pTable->uFree;
+    
+    if (uWidgetId != NO_WIDGET_ID)
+        pTable->uFree = (unsigned)pTable->iStep1tu[uWidgetId];
+    else
+    {
+        if (pTable->uRows == NO_WIDGET_ID)
+            ErrExit(ERR_ALGORITHM, "Too many widgets in the system");
+        reserveWidgetTable(pTable, pTable->uRows + 1);
+        uWidgetId = pTable->uRows++;
+    }
+    pTable->lWidgetNr[uWidgetId] = pWidget->lWidgetNr;
+    pTable->iStep1tu[uWidgetId] = pWidget->iStep1tu;
+    pTable->iStep2tu[uWidgetId] = pWidget->iStep2tu;
+    pTable->iArrivalTime[uWidgetId] = pWidget->iArrivalTime;
+    pTable->iWhichServer[uWidgetId] = pWidget->iWhichServer;
+    return uWidgetId;
+}
+
+// the widget left the system; its id will be handed out again
+void removeWidget(WidgetTable *pTable, unsigned uWidgetId)
+{
+    pTable->iStep1tu[uWidgetId] = (int)pTable->uFree;
+    pTable->uFree = uWidgetId;
+}
+
+void freeWidgetTable(WidgetTable *pTable)
+{
+    free(pTable->lWidgetNr);
+    free(pTable->iStep1tu);
+    free(pTable->iStep2tu);
+    free(pTable->iArrivalTime);
+    free(pTable->iWhichServer);
+    initWidgetTable(pTable);
+}
+//end widget table functions
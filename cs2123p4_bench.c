@@ -0,0 +1,388 @@
+/******************************************************************
+ cs2123p4_bench.c by Justin Mungal
+
+ Machine Improvement Proposal - Benchmark Suite (p4bench)
+
+ Purpose:
+
+ Measures the data structure operations and whole simulations so that
+ the event list (-e list|heap), node allocator (-p pool|malloc) and
+ queue (linked or QUEUE_RING) implementations can be compared. One CSV
+ row is written per measurement:
+
+ benchmark,impl,size,ops,ns_per_op,ops_per_sec,allocs_per_op
+
+ eventList       hold model at a steady event list size: each op is a
+                 removeLL followed by an insertOrderedLL
+ queue           hold model at a steady queue length: each op is an
+                 insertQ followed by a removeQ
+ generateArrival reading a text trace of size widgets, with fgets or
+                 with the parallel parser (mmap); each op is a widget
+                 (text traces stop at 1M widgets)
+ simulate        streaming simulation of a generated trace of size
+                 widgets held in memory; each op is an event (impl
+                 lindley: the same runs computed by simulateLindley,
+                 counted as the events the event loop would process)
+
+ allocs_per_op counts the calls to malloc made by the node pools during
+ the timed part (0 for the ring buffer queues once they have grown).
+ Compare queue implementations by running both p4bench and p4bench_ring
+ (the bench target does this and writes bench.csv).
+
+ Usage:
+ p4bench [-q] [-a] [-o file]
+
+ -q          quick run: smaller sizes and fewer operations
+ -o file     write the rows to file instead of standard output
+ -a          append to the -o file without a header line
+
+ Returns:
+ 0 on success, ERR_COMMAND_LINE or ERR_BAD_INPUT otherwise.
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "cs2123p4.h"
+
+#define BENCH_HOLD_OPS      (1L << 22)  // hold model operations (full run)
+#define BENCH_LIST_WORK     (1L << 28)  // bound on ops * size for the sorted list
+#define BENCH_QUICK_SHIFT   4           // -q divides operation counts by 16
+
+#ifdef QUEUE_RING
+#define BENCH_QUEUE_NAME    "ring"
+#else
+#define BENCH_QUEUE_NAME    "linked"
+#endif
+
+static FILE *pBenchOutput;
+static int bQuick = FALSE;
+
+static void benchUsage(void)
+{
+    fprintf(stderr, "usage: p4bench [-q] [-a] [-o file]\n");
+    exit(ERR_COMMAND_LINE);
+}
+
+static double nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+static void printRow(const char *pszBenchmark, const char *pszImpl, long lSize
+                     , long lOps, double dNs, long lMallocs)
+{
+    fprintf(pBenchOutput, "%s,%s,%ld,%ld,%.2f,%.0f,%.6f\n", pszBenchmark, pszImpl
+            , lSize, lOps, dNs / lOps, lOps / (dNs / 1e9), (double)lMallocs / lOps);
+    fflush(pBenchOutput);
+}
+
+// widgets like the sample input: the two servers are busy about 90% of
+// the time, so the queues stay short but are not always empty
+static Widget *generateWidgets(long lCount, unsigned long long ullSeed
+                               , int *piEndClock)
+{
+    Widget *widgets = (Widget *)malloc(lCount * sizeof(Widget));
+    int iArrivalClock = 0;
+    long i;
+
+    if (widgets == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for %ld widgets", lCount);
+    for (i = 0; i < lCount; i++)
+    {
+        unsigned long long ullRandom = nextRandom(&ullSeed);
+        widgets[i].lWidgetNr = i + 1;
+        widgets[i].iStep1tu = (int)(ullRandom % 17);
+        widgets[i].iStep2tu = (int)((ullRandom >> 8) % 21);
+        widgets[i].iWhichServer = (int)((ullRandom >> 16) & 1) + 1;
+        widgets[i].iArrivalTime = iArrivalClock;
+        iArrivalClock += (int)((ullRandom >> 24) % 21);
+    }
+    *piEndClock = iArrivalClock;
+    return widgets;
+}
+
+/**************************** benchEventList ******************************
+ void benchEventList(int iKind, int bPooled, long lSize)
+ Purpose:
+ Hold model for the event list: lSize events are inserted, then each
+ operation removes the earliest event and inserts one a random time
+ after it, so the list size stays at lSize.
+ **************************************************************************/
+static void benchEventList(int iKind, int bPooled, long lSize)
+{
+    LinkedList list = newLinkedList();
+    unsigned long long ullSeed = 1;
+    long lOps = BENCH_HOLD_OPS;
+    long lMallocs, i;
+    double dStart;
+    char szImpl[32];
+    Event event;
+
+    if (iKind == EVL_LIST && lOps * lSize > BENCH_LIST_WORK)
+        lOps = BENCH_LIST_WORK / lSize;
+    if (bQuick)
+        lOps >>= BENCH_QUICK_SHIFT;
+    if (lOps < 1)
+        lOps = 1;
+
+    setEventListKind(list, iKind);
+    list->nodePool.bPooled = bPooled;
+    memset(&event, 0, sizeof(event));
+    event.iEventType = EVT_SERVER_COMPLETE;
+    for (i = 0; i < lSize; i++)
+    {
+        event.iTime = (int)(nextRandom(&ullSeed) % 1024);
+        insertOrderedLL(list, event);
+    }
+
+    lMallocs = list->nodePool.lMallocCount;
+    dStart = nowNs();
+    for (i = 0; i < lOps; i++)
+    {
+        removeLL(list, &event);
+        event.iTime += (int)(nextRandom(&ullSeed) % 1024);
+        insertOrderedLL(list, event);
+    }
+    sprintf(szImpl, "%s/%s", iKind == EVL_HEAP ? "heap" : "list"
+            , bPooled ? "pool" : "malloc");
+    printRow("eventList", szImpl, lSize, lOps, nowNs() - dStart
+             , list->nodePool.lMallocCount - lMallocs);
+    freeLinkedList(list);
+}
+
+/****************************** benchQueue ********************************
+ void benchQueue(int bPooled, long lSize)
+ Purpose:
+ Hold model for a widget queue: lSize elements are queued, then each
+ operation queues one element and removes the oldest.
+ Notes:
+ bPooled is ignored by the QUEUE_RING build.
+ **************************************************************************/
+static void benchQueue(int bPooled, long lSize)
+{
+    Queue queue = newQueue("queueBench");
+    long lOps = bQuick ? BENCH_HOLD_OPS >> BENCH_QUICK_SHIFT : BENCH_HOLD_OPS;
+    long lMallocs = 0, i;
+    double dStart;
+    char szImpl[32];
+    QElement element;
+
+#ifndef QUEUE_RING
+    queue->nodePool.bPooled = bPooled;
+    sprintf(szImpl, "%s/%s", BENCH_QUEUE_NAME, bPooled ? "pool" : "malloc");
+#else
+    (void) bPooled;
+    sprintf(szImpl, "%s", BENCH_QUEUE_NAME);
+#endif
+    memset(&element, 0, sizeof(element));
+    for (i = 0; i < lSize; i++)
+    {
+        element.uWidgetId = (unsigned)i;
+        insertQ(queue, element);
+    }
+
+#ifndef QUEUE_RING
+    lMallocs = queue->nodePool.lMallocCount;
+#endif
+    dStart = nowNs();
+    for (i = 0; i < lOps; i++)
+    {
+        element.iEnterQTime = (int)i;
+        insertQ(queue, element);
+        removeQ(queue, &element);
+    }
+#ifndef QUEUE_RING
+    lMallocs = queue->nodePool.lMallocCount - lMallocs;
+#endif
+    printRow("queue", szImpl, lSize, lOps, nowNs() - dStart, lMallocs);
+    freeQueue(queue);
+}
+
+/************************** benchGenerateArrival **************************
+ void benchGenerateArrival(char szPath[], long lSize, int iParseThreads)
+ Purpose:
+ Times generateArrival plus readArrival for every widget of the text
+ trace szPath, read with fgets (iParseThreads -1) or mapArrivals.
+ **************************************************************************/
+static void benchGenerateArrival(char szPath[], long lSize, int iParseThreads)
+{
+    Simulation simulation = newSimulation();
+    long lWidgets;
+    double dStart;
+    Event event;
+
+    simulation->pszInputFile = szPath;
+    simulation->iParseThreads = iParseThreads;
+    simulation->bStreaming = TRUE;
+
+    dStart = nowNs();
+    generateArrival(simulation);
+    lWidgets = simulation->iArrivalGroupCount;
+    while (readArrival(simulation, &event))
+    {
+        removeWidget(&simulation->widgets, event.uWidgetId);
+        lWidgets++;
+    }
+    if (lWidgets != lSize)
+        ErrExit(ERR_ALGORITHM, "Read %ld of %ld widgets from '%s'"
+                , lWidgets, lSize, szPath);
+    printRow("generateArrival", iParseThreads < 0 ? "fgets" : "mmap", lSize
+             , lSize, nowNs() - dStart, 0);
+    freeSimulation(simulation);
+}
+
+/***************************** benchSimulate ******************************
+ void benchSimulate(Widget widgets[], long lSize, int iEndClock
+                    , int iKind, int bPooled, int iEngine)
+ Purpose:
+ Times a streaming simulation of the first lSize widgets, by the event
+ loop (ENG_EVENT) or by simulateLindley (ENG_AUTO).
+ Notes:
+ Every widget is one arrival and one completion event.
+ **************************************************************************/
+static void benchSimulate(Widget widgets[], long lSize, int iEndClock
+                          , int iKind, int bPooled, int iEngine)
+{
+    Simulation simulation = newSimulation();
+    SimulationResult result;
+    long lMallocs;
+    double dStart, dNs;
+    char szImpl[48];
+    int i;
+
+    setEventListKind(simulation->eventList, iKind);
+    simulation->eventList->nodePool.bPooled = bPooled;
+    simulation->iEngine = iEngine;
+    simulation->bStreaming = TRUE;
+    simulation->arrivalWidgets = widgets;
+    simulation->bArrivalsBorrowed = TRUE;
+    simulation->lArrivalTotal = lSize;
+    simulation->iArrivalEndClock = iEndClock;
+
+    dStart = nowNs();
+    readArrivalGroup(simulation);
+    simulate(simulation, NO_TIME_LIMIT, &result);
+    dNs = nowNs() - dStart;
+
+    lMallocs = simulation->eventList->nodePool.lMallocCount;
+#ifndef QUEUE_RING
+    for (i = 0; i < simulation->iServerCount; i++)
+        lMallocs += simulation->queues[i]->nodePool.lMallocCount;
+#else
+    (void)i;
+#endif
+    if (iEngine == ENG_AUTO)
+        strcpy(szImpl, "lindley");
+    else
+        sprintf(szImpl, "%s/%s/%s", iKind == EVL_HEAP ? "heap" : "list"
+                , bPooled ? "pool" : "malloc", BENCH_QUEUE_NAME);
+    printRow("simulate", szImpl, lSize, 2 * result.lWidgetCount, dNs, lMallocs);
+    freeSimulation(simulation);
+}
+
+// write widgets[0..lSize-1] as a text trace to a new temporary file;
+// szPath is the mkstemp template and receives the file's name
+static void writeTextTrace(char szPath[], Widget widgets[], long lSize, int iEndClock)
+{
+    int iFd = mkstemp(szPath);
+    FILE *pFile = iFd < 0 ? NULL : fdopen(iFd, "w");
+    long i;
+
+    if (pFile == NULL)
+        ErrExit(ERR_BAD_INPUT, "Unable to create a temporary trace '%s'", szPath);
+    for (i = 0; i < lSize; i++)
+    {
+        int iNextArrival = i + 1 < lSize ? widgets[i + 1].iArrivalTime : iEndClock;
+        fprintf(pFile, "%ld %d %d %d %d\n", widgets[i].lWidgetNr
+                , widgets[i].iStep1tu, widgets[i].iStep2tu
+                , iNextArrival - widgets[i].iArrivalTime, widgets[i].iWhichServer);
+    }
+    if (fclose(pFile) != 0)
+        ErrExit(ERR_BAD_INPUT, "Unable to write '%s'", szPath);
+}
+
+int main(int argc, char *argv[])
+{
+    static const long lHoldSizes[] = { 16, 256, 4096, 65536 };
+    static const long lTraceSizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+    char *pszOutput = NULL;
+    int bAppend = FALSE;
+    long lMaxTrace;
+    Widget *widgets;
+    int iEndClock, iArg, iSize, iKind, bPooled;
+
+    for (iArg = 1; iArg < argc; iArg++)
+    {
+        if (strcmp(argv[iArg], "-q") == 0)
+            bQuick = TRUE;
+        else if (strcmp(argv[iArg], "-a") == 0)
+            bAppend = TRUE;
+        else if (strcmp(argv[iArg], "-o") == 0 && iArg + 1 < argc)
+            pszOutput = argv[++iArg];
+        else
+            benchUsage();
+    }
+    if (bAppend && pszOutput == NULL)
+        benchUsage();
+
+    pBenchOutput = pszOutput == NULL ? stdout : fopen(pszOutput, bAppend ? "a" : "w");
+    if (pBenchOutput == NULL)
+        ErrExit(ERR_BAD_INPUT, "Unable to create '%s'", pszOutput);
+    if (!bAppend)
+        fprintf(pBenchOutput
+                , "benchmark,impl,size,ops,ns_per_op,ops_per_sec,allocs_per_op\n");
+
+    // data structure operations
+    for (iSize = 0; iSize < (int)(sizeof(lHoldSizes) / sizeof(lHoldSizes[0])); iSize++)
+        for (iKind = EVL_LIST; iKind <= EVL_HEAP; iKind++)
+            for (bPooled = TRUE; bPooled >= FALSE; bPooled--)
+                benchEventList(iKind, bPooled, lHoldSizes[iSize]);
+    for (iSize = 0; iSize < (int)(sizeof(lHoldSizes) / sizeof(lHoldSizes[0])); iSize++)
+    {
+        benchQueue(TRUE, lHoldSizes[iSize]);
+#ifndef QUEUE_RING
+        benchQueue(FALSE, lHoldSizes[iSize]);
+#endif
+    }
+
+    // one generated trace; the smaller runs use its first widgets
+    lMaxTrace = bQuick ? 100000 : lTraceSizes[sizeof(lTraceSizes) / sizeof(lTraceSizes[0]) - 1];
+    widgets = generateWidgets(lMaxTrace, 1, &iEndClock);
+
+    for (iSize = 0; iSize < (int)(sizeof(lTraceSizes) / sizeof(lTraceSizes[0]))
+                    && lTraceSizes[iSize] <= lMaxTrace && lTraceSizes[iSize] <= 1000000
+                    ; iSize++)
+    {
+        long lSize = lTraceSizes[iSize];
+        char szPath[] = "/tmp/p4benchXXXXXX";
+        writeTextTrace(szPath, widgets, lSize
+                       , lSize < lMaxTrace ? widgets[lSize].iArrivalTime : iEndClock);
+        benchGenerateArrival(szPath, lSize, -1);
+        benchGenerateArrival(szPath, lSize, 0);
+        unlink(szPath);
+    }
+
+    for (iSize = 0; iSize < (int)(sizeof(lTraceSizes) / sizeof(lTraceSizes[0]))
+                    && lTraceSizes[iSize] <= lMaxTrace; iSize++)
+    {
+        long lSize = lTraceSizes[iSize];
+        int iSizeEndClock = lSize < lMaxTrace ? widgets[lSize].iArrivalTime : iEndClock;
+        for (iKind = EVL_LIST; iKind <= EVL_HEAP; iKind++)
+            for (bPooled = TRUE; bPooled >= FALSE; bPooled--)
+                benchSimulate(widgets, lSize, iSizeEndClock, iKind, bPooled, ENG_EVENT);
+#ifndef QUEUE_RING
+        benchSimulate(widgets, lSize, iSizeEndClock, EVL_HEAP, TRUE, ENG_AUTO);
+#endif
+    }
+
+    free(widgets);
+    if (pBenchOutput != stdout && fclose(pBenchOutput) != 0)
+        ErrExit(ERR_BAD_INPUT, "Unable to write '%s'", pszOutput);
+    return 0;
+}
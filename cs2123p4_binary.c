@@ -0,0 +1,264 @@
+/******************************************************************
+ cs2123p4_binary.c by Justin Mungal
+
+ Machine Improvement Proposal - Binary Widget Trace
+
+ Purpose:
+
+ This file contains the reader and writer for the binary widget
+ trace format. A trace is a TraceHeader followed by one record per
+ widget. Raw traces (iFlags 0) store the records as Widget structures
+ with iArrivalTime already computed, so a mapped trace is used as
+ the arrival array directly without copying or parsing. Compact
+ traces (TRACE_FLAG_VARINT) store each field as a zigzag varint,
+ with lWidgetNr and iArrivalTime delta encoded, and are decoded
+ into memory when loaded.
+
+ Raw traces use the byte order and Widget layout of the machine
+ that wrote them; iRecordSize in the header guards against a
+ mismatched layout.
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cs2123p4.h"
+
+// append a zigzag varint to pBuffer, returning the new end
+static unsigned char *putVarint(unsigned char *p, long lValue)
+{
+    uint64_t uValue = ((uint64_t)lValue << 1) ^ (uint64_t)(lValue >> 63);
+    while (uValue >= 0x80)
+    {
+        *p++ = (unsigned char)(uValue | 0x80);
+        uValue >>= 7;
+    }
+    *p++ = (unsigned char)uValue;
+    return p;
+}
+
+// decode a zigzag varint, returning FALSE if it runs past pEnd
+static int getVarint(const unsigned char **pp, const unsigned char *pEnd
+                     , long *plValue)
+{
+    const unsigned char *p = *pp;
+    uint64_t uValue = 0;
+    int iShift = 0;
+
+    do
+    {
+        if (p >= pEnd || iShift > 63)
+            return FALSE;
+        uValue |= (uint64_t)(*p & 0x7f) << iShift;
+        iShift += 7;
+    } while (*p++ & 0x80);
+    *plValue = (long)(uValue >> 1) ^ -(long)(uValue & 1);
+    *pp = p;
+    return TRUE;
+}
+
+/************************** isBinaryTrace *********************************
+ int isBinaryTrace(char szPath[])
+ Purpose:
+ Returns TRUE if the file starts with the binary trace magic.
+ **************************************************************************/
+int isBinaryTrace(char szPath[])
+{
+    char szMagic[sizeof(((TraceHeader *)0)->szMagic)];
+    FILE *pFile = fopen(szPath, "rb");
+    int bTrace;
+
+    if (pFile == NULL)
+        return FALSE;
+    bTrace = fread(szMagic, sizeof(szMagic), 1, pFile) == 1
+             && memcmp(szMagic, TRACE_MAGIC, sizeof(szMagic)) == 0;
+    fclose(pFile);
+    return bTrace;
+}
+
+/*************************** mapBinaryTrace *******************************
+ void mapBinaryTrace(Simulation simulation)
+ Purpose:
+ Loads the binary trace simulation->pszInputFile as the arrival array.
+ Parameters:
+ I  Simulation simulation               The simulation structure
+ Notes:
+ A raw trace stays mapped and simulation->arrivalWidgets points into the
+ mapping (simulation->pTraceMap is set so that it is unmapped rather than
+ freed). A compact trace is decoded into an allocated array.
+ **************************************************************************/
+void mapBinaryTrace(Simulation simulation)
+{
+    struct stat fileStat;
+    const TraceHeader *pHeader;
+    const unsigned char *pMap;
+    long lSize, i;
+    int iFd;
+
+    iFd = open(simulation->pszInputFile, O_RDONLY);
+    if (iFd < 0 || fstat(iFd, &fileStat) != 0)
+        ErrExit(ERR_BAD_INPUT, "Unable to open input file '%s'"
+                , simulation->pszInputFile);
+    lSize = (long)fileStat.st_size;
+    if (lSize < (long)sizeof(TraceHeader))
+        ErrExit(ERR_BAD_INPUT, "Truncated trace header in '%s'"
+                , simulation->pszInputFile);
+
+    pMap = mmap(NULL, lSize, PROT_READ, MAP_PRIVATE, iFd, 0);
+    close(iFd);
+    if (pMap == MAP_FAILED)
+        ErrExit(ERR_BAD_INPUT, "Unable to map input file '%s'"
+                , simulation->pszInputFile);
+    pHeader = (const TraceHeader *)pMap;
+    // freeSimulation unmaps it, even when the trace turns out to be bad
+    simulation->pTraceMap = (void *)pMap;
+    simulation->lTraceMapSize = lSize;
+
+    if (pHeader->iVersion != TRACE_VERSION)
+        ErrExit(ERR_BAD_INPUT, "Unsupported trace version %d in '%s'"
+                , pHeader->iVersion, simulation->pszInputFile);
+    if (pHeader->lWidgetCount < 0)
+        ErrExit(ERR_BAD_INPUT, "Bad widget count in '%s'"
+                , simulation->pszInputFile);
+
+    simulation->lArrivalTotal = (long)pHeader->lWidgetCount;
+    simulation->lArrivalNext = 0;
+    simulation->iArrivalEndClock = pHeader->iEndClock;
+
+    if ((pHeader->iFlags & TRACE_FLAG_VARINT) == 0)
+    {
+        if (pHeader->iRecordSize != (int)sizeof(Widget))
+            ErrExit(ERR_BAD_INPUT, "Trace '%s' has %d byte records, expected %d"
+                    , simulation->pszInputFile, pHeader->iRecordSize
+                    , (int)sizeof(Widget));
+        if ((lSize - (long)sizeof(TraceHeader)) / (long)sizeof(Widget)
+            < simulation->lArrivalTotal)
+            ErrExit(ERR_BAD_INPUT, "Truncated trace '%s'", simulation->pszInputFile);
+        madvise((void *)pMap, lSize, MADV_SEQUENTIAL);
+        simulation->arrivalWidgets = (Widget *)(pMap + sizeof(TraceHeader));
+        return;
+    }
+
+    // compact trace: decode the varint records
+    {
+        const unsigned char *p = pMap + sizeof(TraceHeader);
+        const unsigned char *pEnd = pMap + lSize;
+        long lWidgetNr = 0, lArrivalTime = 0, lValue;
+        Widget *widgets = (Widget *)malloc((simulation->lArrivalTotal + 1)
+                                           * sizeof(Widget));
+        if (widgets == NULL)
+            ErrExit(ERR_ALGORITHM, "No available memory for %ld widgets"
+                    , simulation->lArrivalTotal);
+        for (i = 0; i < simulation->lArrivalTotal; i++)
+        {
+            if (!getVarint(&p, pEnd, &lValue))
+                break;
+            lWidgetNr += lValue;
+            widgets[i].lWidgetNr = lWidgetNr;
+            if (!getVarint(&p, pEnd, &lValue))
+                break;
+            widgets[i].iStep1tu = (int)lValue;
+            if (!getVarint(&p, pEnd, &lValue))
+                break;
+            widgets[i].iStep2tu = (int)lValue;
+            if (!getVarint(&p, pEnd, &lValue))
+                break;
+            lArrivalTime += lValue;
+            widgets[i].iArrivalTime = (int)lArrivalTime;
+            if (!getVarint(&p, pEnd, &lValue))
+                break;
+            widgets[i].iWhichServer = (int)lValue;
+        }
+        if (i < simulation->lArrivalTotal)
+        {
+            free(widgets);
+            ErrExit(ERR_BAD_INPUT, "Truncated trace '%s'", simulation->pszInputFile);
+        }
+        simulation->arrivalWidgets = widgets;
+        simulation->pTraceMap = NULL;
+        munmap((void *)pMap, lSize);
+    }
+}
+
+/************************** writeBinaryTrace ******************************
+ void writeBinaryTrace(FILE *pFile, Widget widgets[], long lCount
+                       , int iEndClock, int iFlags)
+ Purpose:
+ Writes the widgets (with their computed arrival times) as a binary trace.
+ Parameters:
+ I  FILE *pFile                         Output opened in binary mode
+ I  Widget widgets[]                    The widgets in arrival order
+ I  long lCount                         Number of widgets
+ I  int iEndClock                       Arrival clock after the last widget
+ I  int iFlags                          0 (raw) or TRACE_FLAG_VARINT
+ Notes:
+ Traces produced a block at a time use writeTraceHeader and
+ writeTraceRecords directly.
+ **************************************************************************/
+void writeBinaryTrace(FILE *pFile, Widget widgets[], long lCount
+                      , int iEndClock, int iFlags)
+{
+    Widget previous;
+
+    memset(&previous, 0, sizeof(previous));
+    writeTraceHeader(pFile, lCount, iEndClock, iFlags);
+    writeTraceRecords(pFile, widgets, lCount, iFlags, &previous);
+}
+
+// write a trace header (rewritten once the count and end clock are known
+// when a trace is produced a block at a time)
+void writeTraceHeader(FILE *pFile, long lCount, int iEndClock, int iFlags)
+{
+    TraceHeader header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.szMagic, TRACE_MAGIC, sizeof(header.szMagic));
+    header.iVersion = TRACE_VERSION;
+    header.iFlags = iFlags;
+    header.lWidgetCount = lCount;
+    header.iEndClock = iEndClock;
+    header.iRecordSize = (iFlags & TRACE_FLAG_VARINT) ? 0 : (int)sizeof(Widget);
+    if (fwrite(&header, sizeof(header), 1, pFile) != 1)
+        ErrExit(ERR_BAD_INPUT, "Unable to write trace header");
+}
+
+// append records; *pPrevious is the widget before widgets[0] (all zero
+// for the first block) and is updated for the next block
+void writeTraceRecords(FILE *pFile, Widget widgets[], long lCount, int iFlags
+                       , Widget *pPrevious)
+{
+    long i;
+
+    if (lCount <= 0)
+        return;
+    if ((iFlags & TRACE_FLAG_VARINT) == 0)
+    {
+        if (fwrite(widgets, sizeof(Widget), lCount, pFile) != (size_t)lCount)
+            ErrExit(ERR_BAD_INPUT, "Unable to write trace records");
+        *pPrevious = widgets[lCount - 1];
+        return;
+    }
+
+    for (i = 0; i < lCount; i++)
+    {
+        unsigned char record[5 * 10];
+        unsigned char *p = record;
+        p = putVarint(p, widgets[i].lWidgetNr - pPrevious->lWidgetNr);
+        p = putVarint(p, widgets[i].iStep1tu);
+        p = putVarint(p, widgets[i].iStep2tu);
+        p = putVarint(p, (long)widgets[i].iArrivalTime - pPrevious->iArrivalTime);
+        p = putVarint(p, widgets[i].iWhichServer);
+        if (fwrite(record, p - record, 1, pFile) != 1)
+            ErrExit(ERR_BAD_INPUT, "Unable to write trace records");
+        *pPrevious = widgets[i];
+    }
+}
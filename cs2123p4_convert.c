@@ -0,0 +1,114 @@
+/******************************************************************
+ cs2123p4_convert.c by Justin Mungal
+
+ Machine Improvement Proposal - Widget Trace Converter (p4convert)
+
+ Purpose:
+
+ Converts a widget input file in the text format
+
+ lWidgetNr iStep1tu iStep2tu iArrivalDelta iWhichServer
+
+ into the binary trace format read by mapBinaryTrace, so that the
+ same trace can be simulated many times without being re-parsed.
+
+ Usage:
+ p4convert [-z] [-t threads] textInput binaryOutput
+ p4convert -x binaryInput textOutput
+
+ -z writes the compact varint encoding instead of raw records.
+ -t sets the number of parser threads (default one per CPU).
+ -x converts a binary trace back to the text format.
+
+ Returns:
+ 0 on success, ERR_COMMAND_LINE or ERR_BAD_INPUT otherwise.
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include "cs2123p4.h"
+
+static void convertUsage(void)
+{
+    fprintf(stderr, "usage: p4convert [-z] [-t threads] textInput binaryOutput\n");
+    fprintf(stderr, "       p4convert -x binaryInput textOutput\n");
+    exit(ERR_COMMAND_LINE);
+}
+
+int main(int argc, char *argv[])
+{
+    Simulation simulation = newSimulation();
+    int iFlags = 0;
+    int bToText = FALSE;
+    FILE *pOutput;
+    long i;
+    int iArg;
+
+    simulation->iParseThreads = 0;
+    for (iArg = 1; iArg < argc && argv[iArg][0] == '-'; iArg++)
+    {
+        switch (argv[iArg][1])
+        {
+            case 'z':
+                iFlags |= TRACE_FLAG_VARINT;
+                break;
+            case 'x':
+                bToText = TRUE;
+                break;
+            case 't':
+                if (++iArg >= argc
+                    || sscanf(argv[iArg], "%d", &simulation->iParseThreads) != 1)
+                    convertUsage();
+                break;
+            default:
+                convertUsage();
+        }
+    }
+    if (argc - iArg != 2)
+        convertUsage();
+
+    simulation->pszInputFile = argv[iArg];
+    if (bToText)
+    {
+        if (!isBinaryTrace(simulation->pszInputFile))
+            ErrExit(ERR_BAD_INPUT, "'%s' is not a binary trace", simulation->pszInputFile);
+        mapBinaryTrace(simulation);
+    }
+    else
+    {
+        if (isBinaryTrace(simulation->pszInputFile))
+            ErrExit(ERR_BAD_INPUT, "'%s' is already a binary trace", simulation->pszInputFile);
+        mapArrivals(simulation);
+    }
+
+    pOutput = fopen(argv[iArg + 1], bToText ? "w" : "wb");
+    if (pOutput == NULL)
+        ErrExit(ERR_BAD_INPUT, "Unable to create '%s'", argv[iArg + 1]);
+
+    if (bToText)
+    {
+        // the arrival delta is the gap to the next widget's arrival
+        for (i = 0; i < simulation->lArrivalTotal; i++)
+        {
+            Widget *pWidget = &simulation->arrivalWidgets[i];
+            int iNextArrival = i + 1 < simulation->lArrivalTotal
+                             ? simulation->arrivalWidgets[i + 1].iArrivalTime
+                             : simulation->iArrivalEndClock;
+            fprintf(pOutput, "%ld %d %d %d %d\n", pWidget->lWidgetNr
+                    , pWidget->iStep1tu, pWidget->iStep2tu
+                    , iNextArrival - pWidget->iArrivalTime, pWidget->iWhichServer);
+        }
+    }
+    else
+        writeBinaryTrace(pOutput, simulation->arrivalWidgets
+                         , simulation->lArrivalTotal, simulation->iArrivalEndClock
+                         , iFlags);
+
+    if (fclose(pOutput) != 0)
+        ErrExit(ERR_BAD_INPUT, "Unable to write '%s'", argv[iArg + 1]);
+
+    freeSimulation(simulation);
+    return 0;
+}
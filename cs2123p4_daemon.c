@@ -0,0 +1,781 @@
+/******************************************************************
+ cs2123p4_daemon.c by Justin Mungal
+
+ Machine Improvement Proposal - Simulation Daemon (p4daemon)
+
+ Purpose:
+
+ Serves simulation jobs from a long running process, so a caller that
+ runs many simulations does not pay for starting the program and
+ parsing the same trace each time. Requests are read from a UNIX
+ domain socket (-S) or from standard input, one per line:
+
+     RUN id key=value ...       run a simulation, the reply is OK or ERR
+     PING                       replies PONG
+     STATS                      replies STATS with the daemon's counters
+     QUIT                       ends the connection (standard input: the
+                                daemon exits once its jobs are done)
+
+ The keys of RUN are
+
+     path=file          trace file, text or binary (see p4convert)
+     inline=bytes       the trace is the next bytes bytes of the request
+                        stream, in the text format of the -i input
+     servers=n          number of servers (default 2)
+     limit=time         stop at this time (-l)
+     events=heap|list   event list kind (-e)
+     scale=factor       multiply the step times (-g)
+     route=n|spread     send every widget to server n, or spread them
+     percentiles=1      add the percentiles of -H to the reply
+
+ and exactly one of path and inline is required. The reply is one line
+
+     OK id clock=n widgets=n stopped=0|1 system=avg queueM=avg ...
+     ERR id code message
+
+ where the averages are those runSimulation prints, code is the
+ ERR_... exit code the program would have returned, and with
+ percentiles=1 each average is followed by its _p50, _p90, _p99,
+ _p99.9 and _max. Replies carry the request id because jobs run
+ concurrently and may finish in any order.
+
+ Jobs are run by a pool of worker threads (-j) with the p4sim library.
+ Parsed trace files are cached (-C entries, least recently used are
+ dropped), keyed by path, size and modification time, so a changed
+ file is parsed again. A cached trace is shared read-only by every
+ job that uses it; each job has its own simulation.
+
+ Usage:
+ p4daemon [-S socketPath] [-j threads] [-C cacheEntries]
+
+ -S path        listen on this UNIX domain socket (default standard
+                input and output)
+ -j threads     worker threads (default 0 - one per CPU)
+ -C entries     parsed trace files kept (default 8)
+
+ Returns:
+ 0 on success, ERR_COMMAND_LINE for a bad switch.
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "cs2123p4.h"
+
+#define DAEMON_ID_SIZE      64          // longest request id kept
+#define DAEMON_LINE_SIZE    4096        // longest request line
+#define DAEMON_MAX_INLINE   (1L << 30)  // largest inline trace accepted
+
+// one client: the socket, or standard input and output
+typedef struct
+{
+    FILE *pRequests;                // requests are read from here
+    int iReplyFd;                   // replies are written here
+    pthread_mutex_t writeLock;      // one reply is written at a time
+    int iRefs;                      // reader plus the jobs not yet replied
+} Connection;
+
+// a parsed trace file, shared by the jobs that use it
+typedef struct TraceEntry
+{
+    char *pszPath;
+    long lSize;                     // file size and modification time when
+    struct timespec modified;       // it was parsed
+    Simulation holder;              // holds the parsed widgets
+    int bReady;                     // FALSE - still being parsed
+    int iErrorCode;                 // SIM_OK or why the parse failed
+    int iRefs;                      // jobs using it
+    int bCached;                    // still in the cache list
+    unsigned long ulLastUse;        // cache tick of the last use
+    struct TraceEntry *pNext;
+} TraceEntry;
+
+typedef struct Job
+{
+    char szId[DAEMON_ID_SIZE];
+    char *pszPath;                  // path=, or NULL
+    char *pszInline;                // inline= text, or NULL
+    long lInlineSize;
+    int iServers;
+    int iTimeLimit;
+    int iEventKind;                 // -1 - the default
+    double dStepScale;
+    int iForceServer;
+    int bPercentiles;
+    Connection *pConnection;
+    struct Job *pNext;
+} Job;
+
+// growing reply line
+typedef struct
+{
+    char *psz;
+    size_t uLength;
+    size_t uCapacity;
+} Reply;
+
+static pthread_mutex_t daemonLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t traceReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t connectionDone = PTHREAD_COND_INITIALIZER;
+
+// guarded by daemonLock
+static Job *pJobHead = NULL, *pJobTail = NULL;
+static TraceEntry *pTraceCache = NULL;
+static int iCacheCount = 0;
+static int iCacheEntries = 8;
+static unsigned long ulCacheTick = 0;
+static long lJobsRun = 0, lJobsFailed = 0, lCacheHits = 0, lCacheMisses = 0;
+static int iQueuedJobs = 0;
+
+static char *pszSocketPath = NULL;
+
+static void daemonUsage(void)
+{
+    fprintf(stderr, "usage: p4daemon [-S socketPath] [-j threads] [-C cacheEntries]\n");
+    exit(ERR_COMMAND_LINE);
+}
+
+static void appendReply(Reply *pReply, const char *pszFormat, ...)
+{
+    va_list args;
+    int iLength;
+
+    for (;;)
+    {
+        va_start(args, pszFormat);
+        iLength = vsnprintf(pReply->psz + pReply->uLength
+                            , pReply->uCapacity - pReply->uLength, pszFormat, args);
+        va_end(args);
+        if (iLength < 0)
+            return;
+        if (pReply->uLength + iLength < pReply->uCapacity)
+            break;
+        pReply->uCapacity = 2 * (pReply->uCapacity + iLength);
+        pReply->psz = (char *)realloc(pReply->psz, pReply->uCapacity);
+        if (pReply->psz == NULL)
+            ErrExit(ERR_ALGORITHM, "No available memory for a reply");
+    }
+    pReply->uLength += iLength;
+}
+
+static void writeAll(int iFd, const char *psz, size_t uLength)
+{
+    ssize_t lWritten;
+
+    while (uLength > 0)
+    {
+        lWritten = write(iFd, psz, uLength);
+        if (lWritten <= 0)
+            return;                 // the client went away; drop the reply
+        psz += lWritten;
+        uLength -= lWritten;
+    }
+}
+
+static void sendReply(Connection *pConnection, Reply *pReply)
+{
+    pthread_mutex_lock(&pConnection->writeLock);
+    writeAll(pConnection->iReplyFd, pReply->psz, pReply->uLength);
+    pthread_mutex_unlock(&pConnection->writeLock);
+}
+
+static void sendLine(Connection *pConnection, const char *pszFormat, ...)
+{
+    char szLine[DAEMON_LINE_SIZE];
+    va_list args;
+    int iLength;
+
+    va_start(args, pszFormat);
+    iLength = vsnprintf(szLine, sizeof(szLine) - 1, pszFormat, args);
+    va_end(args);
+    if (iLength < 0)
+        return;
+    if (iLength > (int)sizeof(szLine) - 2)
+        iLength = sizeof(szLine) - 2;
+    szLine[iLength++] = '\n';
+    pthread_mutex_lock(&pConnection->writeLock);
+    writeAll(pConnection->iReplyFd, szLine, iLength);
+    pthread_mutex_unlock(&pConnection->writeLock);
+}
+
+// drops one reference; the last one closes the connection
+static void releaseConnection(Connection *pConnection)
+{
+    int iRefs;
+
+    pthread_mutex_lock(&daemonLock);
+    iRefs = --pConnection->iRefs;
+    pthread_cond_broadcast(&connectionDone);
+    pthread_mutex_unlock(&daemonLock);
+    if (iRefs != 0)
+        return;
+    if (pConnection->pRequests != stdin)    // standard input stays open
+    {
+        fclose(pConnection->pRequests);
+        close(pConnection->iReplyFd);
+    }
+    pthread_mutex_destroy(&pConnection->writeLock);
+    free(pConnection);
+}
+
+static void freeTraceEntry(TraceEntry *pEntry)
+{
+    freeSimulation(pEntry->holder);
+    free(pEntry->pszPath);
+    free(pEntry);
+}
+
+// with daemonLock held: unlinks pEntry from the cache list
+static void uncacheTrace(TraceEntry *pEntry)
+{
+    TraceEntry **ppEntry;
+
+    for (ppEntry = &pTraceCache; *ppEntry != NULL; ppEntry = &(*ppEntry)->pNext)
+        if (*ppEntry == pEntry)
+        {
+            *ppEntry = pEntry->pNext;
+            pEntry->bCached = FALSE;
+            iCacheCount--;
+            return;
+        }
+}
+
+// with daemonLock held: drops unused traces until the cache fits
+static void trimTraceCache(void)
+{
+    TraceEntry *pEntry, *pOldest;
+
+    while (iCacheCount > iCacheEntries)
+    {
+        pOldest = NULL;
+        for (pEntry = pTraceCache; pEntry != NULL; pEntry = pEntry->pNext)
+            if (pEntry->iRefs == 0 && (pOldest == NULL || pEntry->ulLastUse < pOldest->ulLastUse))
+                pOldest = pEntry;
+        if (pOldest == NULL)
+            return;                 // all in use; trimmed as they are released
+        uncacheTrace(pOldest);
+        freeTraceEntry(pOldest);
+    }
+}
+
+static void releaseTrace(TraceEntry *pEntry)
+{
+    pthread_mutex_lock(&daemonLock);
+    pEntry->iRefs--;
+    if (pEntry->bCached == FALSE && pEntry->iRefs == 0)
+        freeTraceEntry(pEntry);
+    else
+        trimTraceCache();
+    pthread_mutex_unlock(&daemonLock);
+}
+
+/***************************** acquireTrace *******************************
+ TraceEntry *acquireTrace(char szPath[], Simulation simulation)
+ Purpose:
+ Returns the parsed trace szPath from the cache, parsing it first when
+ it is not there or the file has changed.
+ Parameters:
+ I  char szPath[]                       Path of the trace file
+ O  Simulation simulation               Receives the error message
+ Returns:
+ The entry, which the caller releases with releaseTrace, or NULL with
+ simulation->szError set.
+ Notes:
+ The file is parsed outside the lock; jobs that want it meanwhile wait
+ for the first one to finish. A failed parse is not cached.
+ **************************************************************************/
+static TraceEntry *acquireTrace(char szPath[], Simulation simulation)
+{
+    TraceEntry *pEntry;
+    struct stat fileStat;
+    int iRC;
+
+    if (stat(szPath, &fileStat) != 0)
+    {
+        snprintf(simulation->szError, MAX_ERROR_MESSAGE
+                 , "Unable to open input file '%s'", szPath);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&daemonLock);
+    for (pEntry = pTraceCache; pEntry != NULL; pEntry = pEntry->pNext)
+        if (strcmp(pEntry->pszPath, szPath) == 0)
+            break;
+    if (pEntry != NULL && (pEntry->lSize != (long)fileStat.st_size
+                           || pEntry->modified.tv_sec != fileStat.st_mtim.tv_sec
+                           || pEntry->modified.tv_nsec != fileStat.st_mtim.tv_nsec))
+    {
+        // changed since it was parsed: later jobs parse it again
+        uncacheTrace(pEntry);
+        if (pEntry->iRefs == 0)
+            freeTraceEntry(pEntry);
+        pEntry = NULL;
+    }
+    if (pEntry != NULL)
+    {
+        lCacheHits++;
+        pEntry->iRefs++;
+        pEntry->ulLastUse = ++ulCacheTick;
+        while (pEntry->bReady == FALSE)
+            pthread_cond_wait(&traceReady, &daemonLock);
+        iRC = pEntry->iErrorCode;
+        pthread_mutex_unlock(&daemonLock);
+        if (iRC == SIM_OK)
+            return pEntry;
+        snprintf(simulation->szError, MAX_ERROR_MESSAGE, "%s", pEntry->holder->szError);
+        releaseTrace(pEntry);
+        return NULL;
+    }
+
+    lCacheMisses++;
+    pEntry = (TraceEntry *)calloc(1, sizeof(TraceEntry));
+    if (pEntry == NULL || (pEntry->pszPath = strdup(szPath)) == NULL
+        || createSimulation(&pEntry->holder, DEFAULT_SERVERS) != SIM_OK)
+        ErrExit(ERR_ALGORITHM, "No available memory for a trace");
+    pEntry->lSize = (long)fileStat.st_size;
+    pEntry->modified = fileStat.st_mtim;
+    pEntry->iRefs = 1;
+    pEntry->bCached = TRUE;
+    pEntry->ulLastUse = ++ulCacheTick;
+    pEntry->pNext = pTraceCache;
+    pTraceCache = pEntry;
+    iCacheCount++;
+    pthread_mutex_unlock(&daemonLock);
+
+    // each job has one worker, so the parse does not start more threads
+    pEntry->holder->iParseThreads = 1;
+    iRC = loadTraceFile(pEntry->holder, szPath);
+
+    pthread_mutex_lock(&daemonLock);
+    pEntry->iErrorCode = iRC;
+    pEntry->bReady = TRUE;
+    if (iRC != SIM_OK && pEntry->bCached == TRUE)
+        uncacheTrace(pEntry);
+    pthread_cond_broadcast(&traceReady);
+    pthread_mutex_unlock(&daemonLock);
+    if (iRC == SIM_OK)
+        return pEntry;
+    snprintf(simulation->szError, MAX_ERROR_MESSAGE, "%s", pEntry->holder->szError);
+    releaseTrace(pEntry);
+    return NULL;
+}
+
+// average, and with percentiles=1 the percentiles of pHist, as name=...
+static void appendTimes(Reply *pReply, Job *pJob, char szName[], double dAverage
+                        , Histogram *pHist)
+{
+    static const double dPercentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+    static const char *pszNames[] = { "p50", "p90", "p99", "p99.9" };
+    int i;
+
+    appendReply(pReply, " %s=%.6f", szName, dAverage);
+    if (pJob->bPercentiles == FALSE)
+        return;
+    for (i = 0; i < 4; i++)
+        appendReply(pReply, " %s_%s=%d", szName, pszNames[i]
+                    , percentileHistogram(pHist, dPercentiles[i]));
+    appendReply(pReply, " %s_max=%d", szName, pHist->lTotal == 0 ? 0 : pHist->iMax);
+}
+
+/******************************* runJob ***********************************
+ void runJob(Job *pJob)
+ Purpose:
+ Runs one RUN request and sends its reply.
+ Parameters:
+ I  Job *pJob                           The request, freed by the caller
+ **************************************************************************/
+static void runJob(Job *pJob)
+{
+    Simulation simulation;
+    SimulationResult result;
+    TraceEntry *pTrace = NULL;
+    Reply reply = { NULL, 0, 0 };
+    int iRC, i;
+
+    iRC = createSimulation(&simulation, pJob->iServers);
+    if (iRC != SIM_OK)
+    {
+        sendLine(pJob->pConnection, "ERR %s %d bad server count %d", pJob->szId, iRC
+                 , pJob->iServers);
+        pthread_mutex_lock(&daemonLock);
+        lJobsRun++;
+        lJobsFailed++;
+        pthread_mutex_unlock(&daemonLock);
+        return;
+    }
+    if (pJob->iEventKind >= 0)
+        setEventListKind(simulation->eventList, pJob->iEventKind);
+    simulation->dStepScale = pJob->dStepScale;
+    simulation->iForceServer = pJob->iForceServer;
+
+    if (pJob->pszInline != NULL)
+    {
+        simulation->iParseThreads = 1;
+        iRC = loadTraceText(simulation, pJob->pszInline, pJob->lInlineSize);
+    }
+    else if ((pTrace = acquireTrace(pJob->pszPath, simulation)) == NULL)
+        iRC = ERR_BAD_INPUT;
+    else
+        iRC = loadWidgets(simulation, pTrace->holder->arrivalWidgets
+                          , pTrace->holder->lArrivalTotal);
+    if (iRC == SIM_OK)
+        iRC = executeSimulation(simulation, pJob->iTimeLimit, &result);
+
+    if (iRC != SIM_OK)
+        appendReply(&reply, "ERR %s %d %s\n", pJob->szId, iRC, simulation->szError);
+    else
+    {
+        appendReply(&reply, "OK %s clock=%d widgets=%ld stopped=%d", pJob->szId
+                    , result.iClock, result.lWidgetCount, result.bTimeLimitReached ? 1 : 0);
+        appendTimes(&reply, pJob, "system", result.dAvgSystemTime, &simulation->systemHist);
+        for (i = 0; i < simulation->iServerCount; i++)
+            appendTimes(&reply, pJob, simulation->queues[i]->szQName
+                        , averageQueueTime(simulation, i), &simulation->queues[i]->waitHist);
+        appendReply(&reply, "\n");
+    }
+    sendReply(pJob->pConnection, &reply);
+    free(reply.psz);
+
+    pthread_mutex_lock(&daemonLock);
+    lJobsRun++;
+    if (iRC != SIM_OK)
+        lJobsFailed++;
+    pthread_mutex_unlock(&daemonLock);
+
+    // the simulation borrows the cached widgets, so it goes first
+    freeSimulation(simulation);
+    if (pTrace != NULL)
+        releaseTrace(pTrace);
+}
+
+static void *workerMain(void *pArg)
+{
+    Job *pJob;
+
+    (void)pArg;
+    for (;;)
+    {
+        pthread_mutex_lock(&daemonLock);
+        while (pJobHead == NULL)
+            pthread_cond_wait(&jobReady, &daemonLock);
+        pJob = pJobHead;
+        pJobHead = pJob->pNext;
+        if (pJobHead == NULL)
+            pJobTail = NULL;
+        iQueuedJobs--;
+        pthread_mutex_unlock(&daemonLock);
+
+        runJob(pJob);
+        releaseConnection(pJob->pConnection);
+        free(pJob->pszPath);
+        free(pJob->pszInline);
+        free(pJob);
+    }
+    return NULL;
+}
+
+/****************************** parseRun **********************************
+ int parseRun(Connection *pConnection, char szArgs[], Job *pJob)
+ Purpose:
+ Fills pJob from the key=value pairs of a RUN request, reading its
+ inline trace from the connection.
+ Returns:
+ TRUE, or FALSE with an ERR reply sent.
+ **************************************************************************/
+static int parseRun(Connection *pConnection, char szArgs[], Job *pJob)
+{
+    char *pszSave, *pszToken, *pszValue;
+    char szExtra;
+
+    for (pszToken = strtok_r(szArgs, " \t\r\n", &pszSave); pszToken != NULL
+         ; pszToken = strtok_r(NULL, " \t\r\n", &pszSave))
+    {
+        pszValue = strchr(pszToken, '=');
+        if (pszValue == NULL)
+            goto badKey;
+        *pszValue++ = '\0';
+        if (strcmp(pszToken, "path") == 0 && pJob->pszPath == NULL)
+        {
+            if ((pJob->pszPath = strdup(pszValue)) == NULL)
+                ErrExit(ERR_ALGORITHM, "No available memory for a request");
+        }
+        else if (strcmp(pszToken, "inline") == 0 && pJob->pszInline == NULL)
+        {
+            if (sscanf(pszValue, "%ld%c", &pJob->lInlineSize, &szExtra) != 1
+                || pJob->lInlineSize < 0 || pJob->lInlineSize > DAEMON_MAX_INLINE)
+                goto badValue;
+            pJob->pszInline = (char *)malloc(pJob->lInlineSize + 1);
+            if (pJob->pszInline == NULL)
+                ErrExit(ERR_ALGORITHM, "No available memory for a request");
+            if (fread(pJob->pszInline, 1, pJob->lInlineSize, pConnection->pRequests)
+                != (size_t)pJob->lInlineSize)
+            {
+                sendLine(pConnection, "ERR %s %d truncated inline trace", pJob->szId
+                         , ERR_BAD_INPUT);
+                return FALSE;
+            }
+        }
+        else if (strcmp(pszToken, "servers") == 0)
+        {
+            if (sscanf(pszValue, "%d%c", &pJob->iServers, &szExtra) != 1)
+                goto badValue;
+        }
+        else if (strcmp(pszToken, "limit") == 0)
+        {
+            if (sscanf(pszValue, "%d%c", &pJob->iTimeLimit, &szExtra) != 1
+                || pJob->iTimeLimit < 0)
+                goto badValue;
+        }
+        else if (strcmp(pszToken, "events") == 0)
+        {
+            if (strcmp(pszValue, "heap") == 0)
+                pJob->iEventKind = EVL_HEAP;
+            else if (strcmp(pszValue, "list") == 0)
+                pJob->iEventKind = EVL_LIST;
+            else
+                goto badValue;
+        }
+        else if (strcmp(pszToken, "scale") == 0)
+        {
+            if (sscanf(pszValue, "%lf%c", &pJob->dStepScale, &szExtra) != 1
+                || pJob->dStepScale < 0)
+                goto badValue;
+        }
+        else if (strcmp(pszToken, "route") == 0)
+        {
+            if (strcmp(pszValue, "spread") == 0)
+                pJob->iForceServer = ROUTE_SPREAD;
+            else if (sscanf(pszValue, "%d%c", &pJob->iForceServer, &szExtra) != 1
+                     || pJob->iForceServer < 1)
+                goto badValue;
+        }
+        else if (strcmp(pszToken, "percentiles") == 0)
+            pJob->bPercentiles = strcmp(pszValue, "0") != 0;
+        else
+            goto badKey;
+    }
+    if ((pJob->pszPath == NULL) == (pJob->pszInline == NULL))
+    {
+        sendLine(pConnection, "ERR %s %d expected one of path= and inline=", pJob->szId
+                 , ERR_COMMAND_LINE);
+        return FALSE;
+    }
+    if (pJob->iForceServer > pJob->iServers)
+    {
+        sendLine(pConnection, "ERR %s %d route %d is not a server", pJob->szId
+                 , ERR_COMMAND_LINE, pJob->iForceServer);
+        return FALSE;
+    }
+    return TRUE;
+
+badKey:
+    sendLine(pConnection, "ERR %s %d unknown key '%s'", pJob->szId, ERR_COMMAND_LINE
+             , pszToken);
+    return FALSE;
+badValue:
+    sendLine(pConnection, "ERR %s %d bad value for %s: '%s'", pJob->szId, ERR_COMMAND_LINE
+             , pszToken, pszValue);
+    return FALSE;
+}
+
+/*************************** serveConnection ******************************
+ void *serveConnection(void *pArg)
+ Purpose:
+ Reads the requests of one connection until QUIT or the end of input,
+ answering PING and STATS and queuing RUN jobs for the workers.
+ Parameters:
+ I  void *pArg                          The Connection
+ Notes:
+ Drops the reader's reference; the connection closes once its last
+ job has replied.
+ **************************************************************************/
+static void *serveConnection(void *pArg)
+{
+    Connection *pConnection = (Connection *)pArg;
+    char szLine[DAEMON_LINE_SIZE];
+    char szCommand[16];
+    char *pszArgs;
+    Job *pJob;
+    int iOffset;
+
+    while (fgets(szLine, sizeof(szLine), pConnection->pRequests) != NULL)
+    {
+        if (sscanf(szLine, "%15s%n", szCommand, &iOffset) != 1)
+            continue;
+        if (strcmp(szCommand, "QUIT") == 0)
+            break;
+        if (strcmp(szCommand, "PING") == 0)
+            sendLine(pConnection, "PONG");
+        else if (strcmp(szCommand, "STATS") == 0)
+        {
+            pthread_mutex_lock(&daemonLock);
+            sendLine(pConnection, "STATS jobs=%ld failed=%ld queued=%d cache_hits=%ld"
+                     " cache_misses=%ld cached=%d", lJobsRun, lJobsFailed, iQueuedJobs
+                     , lCacheHits, lCacheMisses, iCacheCount);
+            pthread_mutex_unlock(&daemonLock);
+        }
+        else if (strcmp(szCommand, "RUN") == 0)
+        {
+            pJob = (Job *)calloc(1, sizeof(Job));
+            if (pJob == NULL)
+                ErrExit(ERR_ALGORITHM, "No available memory for a request");
+            pJob->iServers = DEFAULT_SERVERS;
+            pJob->iTimeLimit = NO_TIME_LIMIT;
+            pJob->iEventKind = -1;
+            pJob->dStepScale = 1.0;
+            pszArgs = szLine + iOffset;
+            if (sscanf(pszArgs, "%63s%n", pJob->szId, &iOffset) == 1
+                && strchr(pJob->szId, '=') == NULL)
+                pszArgs += iOffset;
+            else
+                strcpy(pJob->szId, "-");    // no id, the first key follows RUN
+            if (parseRun(pConnection, pszArgs, pJob) == FALSE)
+            {
+                free(pJob->pszPath);
+                free(pJob->pszInline);
+                free(pJob);
+                continue;
+            }
+            pJob->pConnection = pConnection;
+            pthread_mutex_lock(&daemonLock);
+            pConnection->iRefs++;
+            if (pJobTail == NULL)
+                pJobHead = pJob;
+            else
+                pJobTail->pNext = pJob;
+            pJobTail = pJob;
+            iQueuedJobs++;
+            pthread_cond_signal(&jobReady);
+            pthread_mutex_unlock(&daemonLock);
+        }
+        else
+            sendLine(pConnection, "ERR - %d unknown command '%s'", ERR_COMMAND_LINE
+                     , szCommand);
+    }
+    releaseConnection(pConnection);
+    return NULL;
+}
+
+static Connection *newConnection(FILE *pRequests, int iReplyFd)
+{
+    Connection *pConnection = (Connection *)malloc(sizeof(Connection));
+
+    if (pConnection == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for a connection");
+    pConnection->pRequests = pRequests;
+    pConnection->iReplyFd = iReplyFd;
+    pConnection->iRefs = 1;
+    pthread_mutex_init(&pConnection->writeLock, NULL);
+    return pConnection;
+}
+
+static void stopDaemon(int iSignal)
+{
+    (void)iSignal;
+    unlink(pszSocketPath);
+    _exit(0);
+}
+
+// accepts clients on the socket, one reader thread each; never returns
+static void serveSocket(void)
+{
+    struct sockaddr_un address;
+    pthread_t reader;
+    FILE *pRequests;
+    int iListenFd, iFd;
+
+    if (strlen(pszSocketPath) >= sizeof(address.sun_path))
+        ErrExit(ERR_COMMAND_LINE, "Socket path '%s' is too long", pszSocketPath);
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, pszSocketPath);
+    unlink(pszSocketPath);
+    iListenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (iListenFd < 0 || bind(iListenFd, (struct sockaddr *)&address, sizeof(address)) != 0
+        || listen(iListenFd, 64) != 0)
+        ErrExit(ERR_COMMAND_LINE, "Unable to listen on '%s'", pszSocketPath);
+    signal(SIGINT, stopDaemon);
+    signal(SIGTERM, stopDaemon);
+
+    for (;;)
+    {
+        iFd = accept(iListenFd, NULL, NULL);
+        if (iFd < 0)
+            continue;
+        pRequests = fdopen(dup(iFd), "r");
+        if (pRequests == NULL)
+        {
+            close(iFd);
+            continue;
+        }
+        if (pthread_create(&reader, NULL, serveConnection, newConnection(pRequests, iFd)) != 0)
+            ErrExit(ERR_ALGORITHM, "Unable to start a connection thread");
+        pthread_detach(reader);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Connection *pConnection;
+    pthread_t worker;
+    int iThreads = 0;
+    int iArg, i;
+
+    for (iArg = 1; iArg < argc; iArg++)
+    {
+        if (argv[iArg][0] != '-' || argv[iArg][1] == '\0' || argv[iArg][2] != '\0'
+            || iArg + 1 >= argc)
+            daemonUsage();
+        switch (argv[iArg++][1])
+        {
+            case 'S':
+                pszSocketPath = argv[iArg];
+                break;
+            case 'j':
+                if (sscanf(argv[iArg], "%d", &iThreads) != 1 || iThreads < 0)
+                    daemonUsage();
+                break;
+            case 'C':
+                if (sscanf(argv[iArg], "%d", &iCacheEntries) != 1 || iCacheEntries < 0)
+                    daemonUsage();
+                break;
+            default:
+                daemonUsage();
+        }
+    }
+    if (iThreads == 0)
+        iThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (iThreads < 1)
+        iThreads = 1;
+
+    // a client that disconnects early must not stop the daemon
+    signal(SIGPIPE, SIG_IGN);
+    for (i = 0; i < iThreads; i++)
+    {
+        if (pthread_create(&worker, NULL, workerMain, NULL) != 0)
+            ErrExit(ERR_ALGORITHM, "Unable to start worker threads");
+        pthread_detach(worker);
+    }
+
+    if (pszSocketPath != NULL)
+        serveSocket();
+
+    // standard input: serve it, then wait for its last job to reply
+    pConnection = newConnection(stdin, STDOUT_FILENO);
+    pConnection->iRefs++;
+    serveConnection(pConnection);
+    pthread_mutex_lock(&daemonLock);
+    while (pConnection->iRefs > 1)
+        pthread_cond_wait(&connectionDone, &daemonLock);
+    pthread_mutex_unlock(&daemonLock);
+    releaseConnection(pConnection);
+    return 0;
+}
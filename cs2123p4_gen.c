@@ -0,0 +1,310 @@
+/******************************************************************
+ cs2123p4_gen.c by Justin Mungal
+
+ Machine Improvement Proposal - Synthetic Workload Generator (p4gen)
+
+ Purpose:
+
+ Writes a synthetic widget trace of any size, either in the text
+ format read by the simulator
+
+ lWidgetNr iStep1tu iStep2tu iArrivalDelta iWhichServer
+
+ or as a binary trace (raw or varint, see cs2123p4_binary.c). The
+ trace is fully determined by the seed and the options, and is
+ produced a block at a time, so memory use does not depend on the
+ widget count. Text output can be piped straight into the
+ simulator:
+
+     p4gen -c 100000000 | completed -s -i -
+
+ Usage:
+ p4gen [-c count] [-R seed] [-f text|raw|varint] [-o file]
+       [-1 dist] [-2 dist] [-a dist] [-m weights] [-b length,probability]
+
+ -c count       number of widgets (default 1000)
+ -R seed        generator seed (default 1)
+ -f format      output format (default text); binary formats need -o
+ -o file        output file (default standard output)
+ -1 dist        step 1 time units (default uniform:8)
+ -2 dist        step 2 time units (default uniform:10)
+ -a dist        arrival delta (default exp:10)
+ -m weights     relative share of each server, e.g. 3,1 (default 1,1)
+ -b len,prob    each widget starts a burst of len simultaneous
+                arrivals with probability prob (default none)
+
+ A dist is const:mean, uniform:mean (0 to 2*mean) or exp:mean
+ (exponential), rounded to the nearest integer. Overload regimes
+ are made by giving -a a mean below the per-server service time,
+ e.g. -a exp:5 with the default step times.
+
+ Returns:
+ 0 on success, ERR_COMMAND_LINE or ERR_BAD_INPUT otherwise.
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <math.h>
+#include "cs2123p4.h"
+
+#define GEN_BLOCK_WIDGETS   4096        // widgets generated per block
+#define GEN_TEXT_BUFFER     (1 << 20)   // text output buffer size
+
+// distribution kinds
+#define DIST_CONST          0
+#define DIST_UNIFORM        1
+#define DIST_EXP            2
+
+typedef struct
+{
+    int iKind;                      // DIST_CONST, DIST_UNIFORM or DIST_EXP
+    double dMean;
+} Distribution;
+
+static void genUsage(void)
+{
+    fprintf(stderr, "usage: p4gen [-c count] [-R seed] [-f text|raw|varint] [-o file]\n"
+                    "             [-1 dist] [-2 dist] [-a dist] [-m weights]"
+                    " [-b length,probability]\n"
+                    "       dist is const:mean, uniform:mean or exp:mean\n");
+    exit(ERR_COMMAND_LINE);
+}
+
+static void parseDistribution(char szArg[], Distribution *pDist)
+{
+    char szKind[16];
+
+    if (sscanf(szArg, "%15[a-z]:%lf", szKind, &pDist->dMean) != 2 || pDist->dMean < 0)
+        genUsage();
+    if (strcmp(szKind, "const") == 0)
+        pDist->iKind = DIST_CONST;
+    else if (strcmp(szKind, "uniform") == 0)
+        pDist->iKind = DIST_UNIFORM;
+    else if (strcmp(szKind, "exp") == 0)
+        pDist->iKind = DIST_EXP;
+    else
+        genUsage();
+}
+
+// uniform double in [0, 1)
+static double nextUniform(unsigned long long *pullState)
+{
+    return (nextRandom(pullState) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int sample(Distribution *pDist, unsigned long long *pullState)
+{
+    switch (pDist->iKind)
+    {
+        case DIST_UNIFORM:
+            return (int)(nextUniform(pullState) * 2.0 * pDist->dMean + 0.5);
+        case DIST_EXP:
+            return (int)(-pDist->dMean * log(1.0 - nextUniform(pullState)) + 0.5);
+        default:
+            return (int)(pDist->dMean + 0.5);
+    }
+}
+
+// append the decimal digits of lValue to p, returning the new end
+static char *putDecimal(char *p, long lValue)
+{
+    char szDigits[24];
+    int i = 0;
+
+    if (lValue < 0)
+    {
+        *p++ = '-';
+        lValue = -lValue;
+    }
+    do
+    {
+        szDigits[i++] = (char)('0' + lValue % 10);
+        lValue /= 10;
+    } while (lValue != 0);
+    while (i > 0)
+        *p++ = szDigits[--i];
+    return p;
+}
+
+int main(int argc, char *argv[])
+{
+    Distribution step1 = { DIST_UNIFORM, 8.0 };
+    Distribution step2 = { DIST_UNIFORM, 10.0 };
+    Distribution arrival = { DIST_EXP, 10.0 };
+    double dWeights[MAX_SERVERS];
+    double dCumulative[MAX_SERVERS];
+    int iServers = 2;
+    long lCount = 1000;
+    unsigned long long ullState = 1;
+    char *pszFormat = "text";
+    char *pszOutput = NULL;
+    int iBurstLength = 1;
+    double dBurstProbability = 0.0;
+    int iFlags = 0, bText, iBurstLeft = 0;
+    Widget block[GEN_BLOCK_WIDGETS], previous;
+    int iDeltas[GEN_BLOCK_WIDGETS];
+    char *pszText;
+    FILE *pOutput;
+    long lWidget, i;
+    int iArrivalClock = 0;
+    int iArg;
+
+    dWeights[0] = dWeights[1] = 1.0;
+    for (iArg = 1; iArg < argc; iArg++)
+    {
+        if (argv[iArg][0] != '-' || argv[iArg][1] == '\0' || argv[iArg][2] != '\0'
+            || iArg + 1 >= argc)
+            genUsage();
+        switch (argv[iArg++][1])
+        {
+            case 'c':
+            {
+                // also accepts counts such as 1e8
+                double dCount;
+                if (sscanf(argv[iArg], "%lf", &dCount) != 1 || dCount < 0)
+                    genUsage();
+                lCount = (long)dCount;
+                break;
+            }
+            case 'R':
+                if (sscanf(argv[iArg], "%llu", &ullState) != 1)
+                    genUsage();
+                break;
+            case 'f':
+                pszFormat = argv[iArg];
+                break;
+            case 'o':
+                pszOutput = argv[iArg];
+                break;
+            case '1':
+                parseDistribution(argv[iArg], &step1);
+                break;
+            case '2':
+                parseDistribution(argv[iArg], &step2);
+                break;
+            case 'a':
+                parseDistribution(argv[iArg], &arrival);
+                break;
+            case 'm':
+            {
+                char *pszWeight = strtok(argv[iArg], ",");
+                for (iServers = 0; pszWeight != NULL; pszWeight = strtok(NULL, ","))
+                    if (iServers >= MAX_SERVERS
+                        || sscanf(pszWeight, "%lf", &dWeights[iServers++]) != 1)
+                        genUsage();
+                if (iServers == 0)
+                    genUsage();
+                break;
+            }
+            case 'b':
+                if (sscanf(argv[iArg], "%d,%lf", &iBurstLength, &dBurstProbability) != 2
+                    || iBurstLength < 1)
+                    genUsage();
+                break;
+            default:
+                genUsage();
+        }
+    }
+    if (strcmp(pszFormat, "text") == 0)
+        bText = TRUE;
+    else if (strcmp(pszFormat, "raw") == 0)
+        bText = FALSE;
+    else if (strcmp(pszFormat, "varint") == 0)
+    {
+        bText = FALSE;
+        iFlags = TRACE_FLAG_VARINT;
+    }
+    else
+        genUsage();
+    if (!bText && pszOutput == NULL)
+        ErrExit(ERR_COMMAND_LINE, "Binary traces need an output file (-o)");
+
+    // server choice by cumulative weight
+    dCumulative[0] = dWeights[0];
+    for (i = 1; i < iServers; i++)
+        dCumulative[i] = dCumulative[i - 1] + dWeights[i];
+    if (dCumulative[iServers - 1] <= 0.0)
+        genUsage();
+
+    pOutput = pszOutput == NULL ? stdout : fopen(pszOutput, bText ? "w" : "wb");
+    if (pOutput == NULL)
+        ErrExit(ERR_BAD_INPUT, "Unable to create '%s'", pszOutput);
+    pszText = (char *)malloc(GEN_TEXT_BUFFER);
+    if (pszText == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the output buffer");
+
+    // the header is rewritten with the end clock once it is known
+    memset(&previous, 0, sizeof(previous));
+    if (!bText)
+        writeTraceHeader(pOutput, lCount, 0, iFlags);
+
+    for (lWidget = 0; lWidget < lCount; )
+    {
+        long lBlock = lCount - lWidget < GEN_BLOCK_WIDGETS ? lCount - lWidget
+                                                           : GEN_BLOCK_WIDGETS;
+        char *p = pszText;
+
+        for (i = 0; i < lBlock; i++)
+        {
+            Widget *pWidget = &block[i];
+            double dPick = nextUniform(&ullState) * dCumulative[iServers - 1];
+            int iServer = 0;
+
+            while (iServer < iServers - 1 && dPick >= dCumulative[iServer])
+                iServer++;
+            pWidget->lWidgetNr = lWidget + i + 1;
+            pWidget->iStep1tu = sample(&step1, &ullState);
+            pWidget->iStep2tu = sample(&step2, &ullState);
+            pWidget->iWhichServer = iServer + 1;
+            pWidget->iArrivalTime = iArrivalClock;
+
+            // within a burst the next widget arrives at the same time
+            if (iBurstLeft == 0 && iBurstLength > 1
+                && nextUniform(&ullState) < dBurstProbability)
+                iBurstLeft = iBurstLength - 1;
+            if (iBurstLeft > 0)
+            {
+                iBurstLeft--;
+                iDeltas[i] = 0;
+            }
+            else
+                iDeltas[i] = sample(&arrival, &ullState);
+            iArrivalClock += iDeltas[i];
+        }
+
+        if (bText)
+        {
+            for (i = 0; i < lBlock; i++)
+            {
+                p = putDecimal(p, block[i].lWidgetNr);
+                *p++ = ' ';
+                p = putDecimal(p, block[i].iStep1tu);
+                *p++ = ' ';
+                p = putDecimal(p, block[i].iStep2tu);
+                *p++ = ' ';
+                p = putDecimal(p, iDeltas[i]);
+                *p++ = ' ';
+                p = putDecimal(p, block[i].iWhichServer);
+                *p++ = '\n';
+            }
+            if (fwrite(pszText, 1, p - pszText, pOutput) != (size_t)(p - pszText))
+                ErrExit(ERR_BAD_INPUT, "Unable to write the trace");
+        }
+        else
+            writeTraceRecords(pOutput, block, lBlock, iFlags, &previous);
+        lWidget += lBlock;
+    }
+
+    if (!bText)
+    {
+        if (fseek(pOutput, 0, SEEK_SET) != 0)
+            ErrExit(ERR_BAD_INPUT, "Unable to rewrite the trace header");
+        writeTraceHeader(pOutput, lCount, iArrivalClock, iFlags);
+    }
+    if (fclose(pOutput) != 0)
+        ErrExit(ERR_BAD_INPUT, "Unable to write the trace");
+    free(pszText);
+    return 0;
+}
@@ -16,10 +16,13 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
 #include "cs2123p4.h"
 
 /******************** newSimulation / NewServer ***************************
  Simulation newSimulation()
+ void freeSimulation(Simulation simulation)
  Server newServer(char szServerNm[])
  Purpose:
  These functions are used for allocating new simulation and server structures,
@@ -29,6 +32,8 @@
  Notes - newSimulation:
  Various numeric values are set to zero. These will be summed and incremented
  throughout the simulation, and must be set to zero when the simulation begins.
+ The simulation owns its event list, queues and servers, so that several
+ simulations can run side by side.
  Notes - newServer:
  A newly allocated server will have bBusy set to FALSE. This is so that the
  new server can service widgets right away.
@@ -36,20 +41,190 @@
 Simulation newSimulation()
 {
     Simulation s = (Simulation) malloc(sizeof(SimulationImp));
+    if (s == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the simulation");
     s->iClock = 0;
     s->lWidgetCount = 0;
     s->lSystemTimeSum = 0;
+    s->bVerbose = FALSE;
+    s->bMemoryReport = FALSE;
+    s->pszInputFile = INPUT_FILE;
+    s->pInputFile = NULL;
+    s->bInputDone = FALSE;
+    s->iArrivalClock = 0;
+    s->bStreaming = FALSE;
+    s->arrivalGroup = NULL;
+    s->iArrivalGroupCount = 0;
+    s->iArrivalGroupCapacity = 0;
+    s->iParseThreads = -1;
+    s->arrivalWidgets = NULL;
+    s->lArrivalTotal = 0;
+    s->lArrivalNext = 0;
+    s->iArrivalEndClock = 0;
+    s->pTraceMap = NULL;
+    s->lTraceMapSize = 0;
+    s->iReplications = 0;
+    s->iWorkerThreads = 0;
+    s->ullSeed = 1;
+    s->pszSweepGrid = NULL;
+    s->bArrivalsBorrowed = FALSE;
+    s->dStepScale = 1.0;
+    s->iForceServer = 0;
+    s->pszTraceFile = NULL;
+    s->traceSink = NULL;
+    s->pszResultFile = NULL;
+    s->resultSink = NULL;
+    s->dSteadyHalfWidth = 0.0;
+    s->bSteadyRelative = FALSE;
+    s->steadyState = NULL;
+    s->bSteadyStop = FALSE;
+    s->bPercentiles = FALSE;
+    s->pszHistogramFile = NULL;
+    initHistogram(&s->systemHist);
+    s->iTimeLimit = NO_TIME_LIMIT;
+    s->pszCheckpointFile = NULL;
+    s->iCheckpointInterval = 0;
+    s->pszResumeFile = NULL;
+    s->iPartitions = 0;
+    s->pszWhatIfFiles = NULL;
+    s->whatIf = NULL;
+    s->bStats = FALSE;
+    memset(&s->stats, 0, sizeof(SimulationStats));
+    s->pfnWidgetSource = NULL;
+    s->pSourceContext = NULL;
+    s->szError[0] = '\0';
     s->eventList = newLinkedList();
+    s->iEngine = ENG_AUTO;
+    initWidgetTable(&s->widgets);
+    s->iServerCount = 0;
+    s->queues = NULL;
+    s->servers = NULL;
+    s->dAvgQueueTimes = NULL;
+    setServerCount(s, DEFAULT_SERVERS);
     return s;
 }
+//release everything owned by a simulation, including its input
+void freeSimulation(Simulation simulation)
+{
+    setServerCount(simulation, 0);
+    if (simulation->pInputFile != NULL && simulation->pInputFile != stdin)
+        fclose(simulation->pInputFile);
+    free(simulation->arrivalGroup);
+    if (simulation->pTraceMap != NULL)
+        munmap(simulation->pTraceMap, simulation->lTraceMapSize);
+    else if (simulation->bArrivalsBorrowed == FALSE)
+        free(simulation->arrivalWidgets);
+    freeLinkedList(simulation->eventList);
+    freeWidgetTable(&simulation->widgets);
+    free(simulation);
+}
+//replace the servers and queues with iServerCount new ones, named
+//M, W, X, Y, S5, S6, ... (0 just frees them)
+void setServerCount(Simulation simulation, int iServerCount)
+{
+    char szName[16];
+    int i;
+    
+    for (i = 0; i < simulation->iServerCount; i++)
+    {
+        freeQueue(simulation->queues[i]);
+        free(simulation->servers[i]);
+    }
+    free(simulation->queues);
+    free(simulation->servers);
+    free(simulation->dAvgQueueTimes);
+    simulation->queues = NULL;
+    simulation->servers = NULL;
+    simulation->dAvgQueueTimes = NULL;
+    simulation->iServerCount = iServerCount;
+    if (iServerCount == 0)
+        return;
+    
+    simulation->queues = (Queue *)malloc(iServerCount * sizeof(Queue));
+    simulation->servers = (Server *)malloc(iServerCount * sizeof(Server));
+    simulation->dAvgQueueTimes = (double *)malloc(iServerCount * sizeof(double));
+    if (simulation->queues == NULL || simulation->servers == NULL
+        || simulation->dAvgQueueTimes == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for %d servers", iServerCount);
+    for (i = 0; i < iServerCount; i++)
+    {
+        char szTag[6];
+        serverTag(i, szTag);
+        sprintf(szName, "queue%s", szTag);
+        simulation->queues[i] = newQueue(szName);
+        simulation->queues[i]->iIndex = i;
+        sprintf(szName, "server%s", szTag);
+        simulation->servers[i] = newServer(szName);
+        strcpy(simulation->servers[i]->szTag, szTag);
+        simulation->servers[i]->iIndex = i;
+    }
+}
+//short name of server iServer: M, W, X, Y, S5, S6, ...
+void serverTag(int iServer, char szTag[])
+{
+    static const char *pszTags[] = { "M", "W", "X", "Y" };
+    
+    if (iServer < 4)
+        strcpy(szTag, pszTags[iServer]);
+    else
+        sprintf(szTag, "S%d", iServer + 1);
+}
 //create a new server, and mark it as not busy
 Server newServer(char szServerNm[])
 {
     Server s = (Server)malloc(sizeof(ServerImp));
     strcpy(s->szServerName,szServerNm);
+    strcpy(s->szTag, "");
+    s->iIndex = 0;
     s->bBusy = FALSE;
     return s;
 }
+/******************** printNodePoolReport ********************************
+ void printNodePoolReport(char szName[], NodePool *pool)
+ Purpose:
+ Prints the allocation counts of a node pool (-m).
+ Parameters:
+ I  char szName[]                   name of the structure owning the pool
+ I  NodePool *pool                  the pool
+ **************************************************************************/
+void printNodePoolReport(char szName[], NodePool *pool)
+{
+    printf("%s nodes: %ld allocated, %ld freed, %ld malloc calls (%s)\n"
+           , szName, pool->lAllocCount, pool->lFreeCount, pool->lMallocCount
+           , pool->bPooled == TRUE ? "pool" : "malloc");
+}
+// monotonic wall clock in seconds, for the --stats timers
+double wallSeconds(void)
+{
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+/*************************** nextRandom **********************************
+ unsigned long long nextRandom(unsigned long long *pullState)
+ Purpose:
+ Returns the next 64-bit value of a splitmix64 generator. The whole state
+ is *pullState, so every stream is reproducible from its seed.
+ **************************************************************************/
+unsigned long long nextRandom(unsigned long long *pullState)
+{
+    unsigned long long ullZ = (*pullState += 0x9e3779b97f4a7c15ULL);
+    ullZ = (ullZ ^ (ullZ >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    ullZ = (ullZ ^ (ullZ >> 27)) * 0x94d049bb133111ebULL;
+    return ullZ ^ (ullZ >> 31);
+}
+// error handler of each thread; NULL - ErrExit prints and exits
+static _Thread_local ErrorHandler pfnErrorHandler = NULL;
+
+// set this thread's error handler, returning the previous one
+ErrorHandler setErrorHandler(ErrorHandler pfnHandler)
+{
+    ErrorHandler pfnPrevious = pfnErrorHandler;
+    
+    pfnErrorHandler = pfnHandler;
+    return pfnPrevious;
+}
 /******************** processCommandSwitches *****************************
  void processCommandSwitches(int argc, char *argv[])
  Purpose:
@@ -67,6 +242,7 @@ Server newServer(char szServerNm[])
 void processCommandSwitches(int argc, char *argv[], Simulation simulation)
 {
     int i;
+    int iServerCount;
     // Examine each of the command arguments other than the name of the program.
     for (i = 1; i < argc; i++)
     {
@@ -79,9 +255,171 @@ void processCommandSwitches(int argc, char *argv[], Simulation simulation)
             case 'v':
                 simulation->bVerbose = TRUE;
                 break;
+            case 'm':
+                simulation->bMemoryReport = TRUE;
+                break;
+            case 'p':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                if (strcmp(argv[i], "pool") == 0)
+                    simulation->eventList->nodePool.bPooled = TRUE;
+                else if (strcmp(argv[i], "malloc") == 0)
+                    simulation->eventList->nodePool.bPooled = FALSE;
+                else
+                    exitUsage(i, ERR_ALLOCATOR_KIND, argv[i]);
+                break;
+            case 's':
+                simulation->bStreaming = TRUE;
+                break;
+            case 'i':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                simulation->pszInputFile = argv[i];
+                break;
+            case 't':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                if (sscanf(argv[i], "%d", &simulation->iParseThreads) != 1
+                    || simulation->iParseThreads < 0)
+                    exitUsage(i, ERR_THREAD_COUNT, argv[i]);
+                break;
+            case 'r':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                if (sscanf(argv[i], "%d", &simulation->iReplications) != 1
+                    || simulation->iReplications < 0)
+                    exitUsage(i, ERR_NUMBER, argv[i]);
+                break;
+            case 'R':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                if (sscanf(argv[i], "%llu", &simulation->ullSeed) != 1)
+                    exitUsage(i, ERR_NUMBER, argv[i]);
+                break;
+            case 'j':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                if (sscanf(argv[i], "%d", &simulation->iWorkerThreads) != 1
+                    || simulation->iWorkerThreads < 0)
+                    exitUsage(i, ERR_THREAD_COUNT, argv[i]);
+                break;
+            case 'n':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                if (sscanf(argv[i], "%d", &iServerCount) != 1
+                    || iServerCount < 1 || iServerCount > MAX_SERVERS)
+                    exitUsage(i, ERR_SERVER_COUNT, argv[i]);
+                setServerCount(simulation, iServerCount);
+                break;
+            case 'T':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                simulation->pszTraceFile = argv[i];
+                break;
+            case 'W':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                simulation->pszResultFile = argv[i];
+                break;
+            case 'S':
+            {
+                char *pszEnd;
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                simulation->dSteadyHalfWidth = strtod(argv[i], &pszEnd);
+                simulation->bSteadyRelative = *pszEnd == '%';
+                if (simulation->bSteadyRelative == TRUE)
+                {
+                    simulation->dSteadyHalfWidth /= 100.0;
+                    pszEnd++;
+                }
+                if (pszEnd == argv[i] || *pszEnd != '\0'
+                    || !(simulation->dSteadyHalfWidth > 0.0))
+                    exitUsage(i, ERR_HALF_WIDTH, argv[i]);
+                break;
+            }
+            case 'H':
+                simulation->bPercentiles = TRUE;
+                break;
+            case 'J':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                simulation->pszHistogramFile = argv[i];
+                break;
+            case 'l':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                if (sscanf(argv[i], "%d", &simulation->iTimeLimit) != 1
+                    || simulation->iTimeLimit < 0)
+                    exitUsage(i, ERR_TIME, argv[i]);
+                break;
+            case 'c':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                simulation->pszCheckpointFile = argv[i];
+                break;
+            case 'k':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                if (sscanf(argv[i], "%d", &simulation->iCheckpointInterval) != 1
+                    || simulation->iCheckpointInterval <= 0)
+                    exitUsage(i, ERR_TIME, argv[i]);
+                break;
+            case 'x':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                simulation->pszResumeFile = argv[i];
+                break;
+            case 'w':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                simulation->pszWhatIfFiles = argv[i];
+                break;
+            case 'P':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                if (sscanf(argv[i], "%d", &simulation->iPartitions) != 1
+                    || simulation->iPartitions < 0)
+                    exitUsage(i, ERR_NUMBER, argv[i]);
+                break;
+            case 'g':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                simulation->pszSweepGrid = argv[i];
+                break;
+            case 'e':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                if (strcmp(argv[i], "heap") == 0)
+                    setEventListKind(simulation->eventList, EVL_HEAP);
+                else if (strcmp(argv[i], "list") == 0)
+                    setEventListKind(simulation->eventList, EVL_LIST);
+                else
+                    exitUsage(i, ERR_EVENT_LIST_KIND, argv[i]);
+                break;
+            case 'E':
+                if (++i >= argc)
+                    exitUsage(i - 1, ERR_MISSING_ARGUMENT, argv[i - 1]);
+                if (strcmp(argv[i], "auto") == 0)
+                    simulation->iEngine = ENG_AUTO;
+                else if (strcmp(argv[i], "event") == 0)
+                    simulation->iEngine = ENG_EVENT;
+                else
+                    exitUsage(i, ERR_ENGINE_KIND, argv[i]);
+                break;
             case '?':
                 exitUsage(USAGE_ONLY, "", "");
                 break;
+            case '-':
+#ifndef NO_STATS
+                if (strcmp(argv[i], "--stats=json") == 0)
+                {
+                    simulation->bStats = TRUE;
+                    break;
+                }
+#endif
+                exitUsage(i, ERR_EXPECTED_SWITCH, argv[i]);
+                break;
             default:
                 exitUsage(i, ERR_EXPECTED_SWITCH, argv[i]);
         }
@@ -111,10 +449,20 @@ void processCommandSwitches(int argc, char *argv[], Simulation simulation)
  - Prints the file path and file name of the program having the error.
  This is the file that contains this routine.
  - Requires including <stdarg.h>
+ - When the thread has an error handler (setErrorHandler, used by the
+ library), the message is passed to it instead and nothing is printed.
  **************************************************************************/
 void ErrExit(int iexitRC, char szFmt[], ... )
 {
     va_list args;               // This is the standard C variable argument list type
+    if (pfnErrorHandler != NULL)
+    {
+        char szMessage[MAX_ERROR_MESSAGE];
+        va_start(args, szFmt);
+        vsnprintf(szMessage, sizeof(szMessage), szFmt, args);
+        va_end(args);
+        pfnErrorHandler(iexitRC, szMessage);
+    }
     va_start(args, szFmt);      // This tells the compiler where the variable arguments
     // begins.  They begin after szFmt.
     printf("ERROR: ");
@@ -148,12 +496,48 @@ void exitUsage(int iArg, char *pszMessage, char *pszDiagnosticInfo)
     if (iArg == USAGE_ONLY)
     {
         printf("command line arguents:\n -v \t Enable verbose mode.\n");
+        printf(" -e heap|list \t Event list implementation (default heap).\n");
+        printf(" -E auto|event \t Engine: auto computes runs that need no events (-s with an\n");
+        printf(" \t\t in-memory trace, -r, -g, -P) with the Lindley recursion\n");
+        printf(" \t\t (default), event always runs the event loop.\n");
+        printf(" -i file \t Input file (default %s, - for standard input).\n", INPUT_FILE);
+        printf(" \t\t Binary traces written by p4convert are detected and mapped.\n");
+        printf(" -s \t Stream arrivals from the input instead of loading them first.\n");
+        printf(" -t threads \t Map the input and parse it in parallel (0 - one per CPU).\n");
+        printf(" -p pool|malloc \t Node allocator (default pool).\n");
+        printf(" -m \t Print node allocation counts.\n");
+        printf(" -r count \t Run count resampled replications and report confidence intervals.\n");
+        printf(" -R seed \t Seed for the replications (default 1).\n");
+        printf(" -j threads \t Replication and sweep worker threads (default one per CPU).\n");
+        printf(" -g grid \t Parameter sweep, e.g. \"scale=0.5,1,2;route=trace,M,W;servers=2,4\".\n");
+        printf(" -n count \t Number of servers, each with its own queue (default 2).\n");
+        printf(" -T file \t Write the events to file from a background thread, as binary\n");
+        printf(" \t\t records (see p4trace) or, with -v, as the verbose text.\n");
+        printf(" -W file \t Write each widget's arrival, queue, start and completion times,\n");
+        printf(" \t\t server, wait and time in system to file, in binary column\n");
+        printf(" \t\t blocks (see p4trace) or, for a .csv file name, as CSV.\n");
+        printf(" -S halfwidth \t Steady state: drop the warm-up (MSER-5), and stop once the\n");
+        printf(" \t\t 95%% half-widths of the mean queue and system times, from\n");
+        printf(" \t\t batch means, are at most halfwidth tu (or percent, e.g. 1%%).\n");
+        printf(" -H \t Print p50/p90/p99/p99.9/max of the queue and system times.\n");
+        printf(" -J file \t Write the queue and system time histograms to file as JSON.\n");
+        printf(" -l time \t Stop before the first event after time (default no limit).\n");
+        printf(" -c file \t Write a snapshot of the simulation to file when it stops.\n");
+        printf(" -k time \t With -c, also write the snapshot every time units.\n");
+        printf(" -x file \t Resume the simulation from a snapshot (same -i input).\n");
+        printf(" -P count \t Split the servers into count partitions simulated in parallel.\n");
+        printf(" -w file[,file...] \t Edited copies of the input: after the input, simulate each\n");
+        printf(" \t\t from the input's last checkpoint before its first change.\n");
+#ifndef NO_STATS
+        printf(" --stats=json \t Print event, search, allocation and queue length counters\n");
+        printf(" \t\t and the parse/simulate/report times as JSON.\n");
+#endif
         exit(USAGE_ONLY);
     }
     if (iArg >= 0)
     {
         fprintf(stderr, "Error: bad argument #%d.  %s %s\n", iArg, pszMessage, pszDiagnosticInfo);
-        printf("Valid arguments: -v, -?\n");
+        printf("Valid arguments: -v, -e heap|list, -E auto|event, -i file, -s, -t threads, -p pool|malloc, -m, -r count, -R seed, -j threads, -g grid, -n count, -T file, -W file, -S halfwidth, -H, -J file, -l time, -c file, -k time, -x file, -P count, -w files, --stats=json, -?\n");
     }
     if (iArg >= 0)
         exit(ERR_COMMAND_LINE_SYNTAX);
@@ -0,0 +1,212 @@
+/******************************************************************
+ cs2123p4_hist.c by Justin Mungal
+
+ Machine Improvement Proposal - Wait and System Time Histograms
+
+ Purpose:
+
+ This file contains the log-bucketed histograms behind the -H
+ percentiles and the -J JSON export. Each queue records the wait of
+ every widget it hands to its server (seize) and the simulation
+ records every widget's time in system (leaveSystem).
+
+ A value below 2 * HIST_SUB_HALF has a bucket of its own. A larger
+ value with its highest bit at position b is kept to its top
+ HIST_SUB_BITS + 1 bits, so each power of two is split into
+ HIST_SUB_HALF buckets. A percentile is reported as the largest value
+ of its bucket (never more than the recorded maximum), which is less
+ than 1% above the true value. Memory is fixed at HIST_BUCKETS counts
+ whatever the length of the run, and histograms of the same quantity
+ from different runs merge by adding their counts.
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include "cs2123p4.h"
+
+// percentiles reported by -H and -J
+static const double dReportPercentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+static const char *pszReportNames[] = { "p50", "p90", "p99", "p99.9" };
+#define REPORT_PERCENTILES  4
+
+// bucket subscript of a non-negative value
+static int bucketIndex(int iValue)
+{
+    int iShift;
+
+    if (iValue < 2 * HIST_SUB_HALF)
+        return iValue;
+    iShift = (31 - __builtin_clz((unsigned)iValue)) - HIST_SUB_BITS;
+    return iShift * HIST_SUB_HALF + (iValue >> iShift);
+}
+
+// smallest and largest value that fall in bucket iIndex
+static int bucketLow(int iIndex)
+{
+    int iShift;
+
+    if (iIndex < 2 * HIST_SUB_HALF)
+        return iIndex;
+    iShift = iIndex / HIST_SUB_HALF - 1;
+    return (iIndex - iShift * HIST_SUB_HALF) << iShift;
+}
+static int bucketHigh(int iIndex)
+{
+    if (iIndex < 2 * HIST_SUB_HALF)
+        return iIndex;
+    return bucketLow(iIndex) + ((1 << (iIndex / HIST_SUB_HALF - 1)) - 1);
+}
+
+void initHistogram(Histogram *pHist)
+{
+    memset(pHist, 0, sizeof(Histogram));
+}
+
+// record one value; negative values are recorded as 0
+void recordHistogram(Histogram *pHist, int iValue)
+{
+    if (iValue < 0)
+        iValue = 0;
+    pHist->lCounts[bucketIndex(iValue)]++;
+    if (pHist->lTotal == 0 || iValue < pHist->iMin)
+        pHist->iMin = iValue;
+    if (pHist->lTotal == 0 || iValue > pHist->iMax)
+        pHist->iMax = iValue;
+    pHist->lTotal++;
+    pHist->lSum += iValue;
+}
+
+// add the values of pFrom to pTo
+void mergeHistogram(Histogram *pTo, Histogram *pFrom)
+{
+    int i;
+
+    if (pFrom->lTotal == 0)
+        return;
+    for (i = 0; i < HIST_BUCKETS; i++)
+        pTo->lCounts[i] += pFrom->lCounts[i];
+    if (pTo->lTotal == 0 || pFrom->iMin < pTo->iMin)
+        pTo->iMin = pFrom->iMin;
+    if (pTo->lTotal == 0 || pFrom->iMax > pTo->iMax)
+        pTo->iMax = pFrom->iMax;
+    pTo->lTotal += pFrom->lTotal;
+    pTo->lSum += pFrom->lSum;
+}
+
+/************************* percentileHistogram ****************************
+ int percentileHistogram(Histogram *pHist, double dPercentile)
+ Purpose:
+ Returns the value at or below which dPercentile percent of the recorded
+ values fall (0 when nothing was recorded).
+ **************************************************************************/
+int percentileHistogram(Histogram *pHist, double dPercentile)
+{
+    double dRank = dPercentile / 100.0 * pHist->lTotal;
+    long lRank = (long)dRank;
+    long lSeen = 0;
+    int i;
+
+    if (pHist->lTotal == 0)
+        return 0;
+    if (lRank < dRank)
+        lRank++;
+    if (lRank < 1)
+        lRank = 1;
+    for (i = 0; i < HIST_BUCKETS; i++)
+    {
+        lSeen += pHist->lCounts[i];
+        if (lSeen >= lRank)
+            return bucketHigh(i) < pHist->iMax ? bucketHigh(i) : pHist->iMax;
+    }
+    return pHist->iMax;
+}
+
+// one -H line: szLabel: p50 n, p90 n, p99 n, p99.9 n, max n
+void printPercentiles(char szLabel[], Histogram *pHist)
+{
+    int i;
+
+    if (pHist->lTotal == 0)
+    {
+        printf("%s: no widgets\n", szLabel);
+        return;
+    }
+    printf("%s:", szLabel);
+    for (i = 0; i < REPORT_PERCENTILES; i++)
+        printf(" %s %d,", pszReportNames[i]
+               , percentileHistogram(pHist, dReportPercentiles[i]));
+    printf(" max %d\n", pHist->iMax);
+}
+
+static void writeHistogramObject(FILE *pFile, char szName[], Histogram *pHist
+                                 , int bLast)
+{
+    int i, bFirst = TRUE;
+
+    fprintf(pFile, "    \"%s\": {\n      \"count\": %ld,\n", szName, pHist->lTotal);
+    if (pHist->lTotal == 0)
+        fprintf(pFile, "      \"mean\": null,\n      \"min\": null,\n"
+                       "      \"max\": null,\n");
+    else
+        fprintf(pFile, "      \"mean\": %.6f,\n      \"min\": %d,\n      \"max\": %d,\n"
+                , (double)pHist->lSum / pHist->lTotal, pHist->iMin, pHist->iMax);
+    for (i = 0; i < REPORT_PERCENTILES; i++)
+    {
+        if (pHist->lTotal == 0)
+            fprintf(pFile, "      \"%s\": null,\n", pszReportNames[i]);
+        else
+            fprintf(pFile, "      \"%s\": %d,\n", pszReportNames[i]
+                    , percentileHistogram(pHist, dReportPercentiles[i]));
+    }
+    // only the buckets in use, as [low, high, count]
+    fprintf(pFile, "      \"buckets\": [");
+    for (i = 0; i < HIST_BUCKETS; i++)
+    {
+        if (pHist->lCounts[i] == 0)
+            continue;
+        fprintf(pFile, "%s[%d, %d, %ld]", bFirst ? "" : ", ", bucketLow(i)
+                , bucketHigh(i), pHist->lCounts[i]);
+        bFirst = FALSE;
+    }
+    fprintf(pFile, "]\n    }%s\n", bLast ? "" : ",");
+}
+
+/************************* writeHistogramJson *****************************
+ void writeHistogramJson(char szPath[], int iServerCount
+                         , Histogram *waitHists[], Histogram *pSystemHist)
+ Purpose:
+ Writes the wait histogram of each server's queue ("queue_M", ...) and
+ the time in system histogram ("system") to szPath as JSON.
+ Parameters:
+ I  char szPath[]                       The JSON file
+ I  int iServerCount                    Number of wait histograms
+ I  Histogram *waitHists[]              Wait histogram of each server
+ I  Histogram *pSystemHist              Time in system histogram
+ **************************************************************************/
+void writeHistogramJson(char szPath[], int iServerCount, Histogram *waitHists[]
+                        , Histogram *pSystemHist)
+{
+    FILE *pFile = fopen(szPath, "w");
+    char szName[16];
+    int i;
+
+    if (pFile == NULL)
+        ErrExit(ERR_BAD_INPUT, "Unable to create histogram file '%s'", szPath);
+    fprintf(pFile, "{\n  \"unit\": \"time units\",\n  \"histograms\": {\n");
+    for (i = 0; i < iServerCount; i++)
+    {
+        char szTag[6];
+        serverTag(i, szTag);
+        sprintf(szName, "queue_%s", szTag);
+        writeHistogramObject(pFile, szName, waitHists[i], FALSE);
+    }
+    writeHistogramObject(pFile, "system", pSystemHist, TRUE);
+    fprintf(pFile, "  }\n}\n");
+    if (fclose(pFile) != 0)
+        ErrExit(ERR_BAD_INPUT, "Unable to write histogram file '%s'", szPath);
+}
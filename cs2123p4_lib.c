@@ -0,0 +1,301 @@
+/******************************************************************
+ cs2123p4_lib.c by Justin Mungal
+
+ Machine Improvement Proposal - Simulation Library
+
+ Purpose:
+
+ This file contains the entry points of the p4sim library, which runs
+ simulations inside another program instead of through the completed
+ executable:
+
+     Simulation simulation;
+     SimulationResult result;
+
+     if (createSimulation(&simulation, 2) == SIM_OK
+         && loadWidgets(simulation, widgets, lCount) == SIM_OK
+         && executeSimulation(simulation, NO_TIME_LIMIT, &result) == SIM_OK)
+         ... use result, averageQueueTime(simulation, i), the histograms ...
+     else
+         ... simulation->szError says what went wrong ...
+     freeSimulation(simulation);
+
+ Each call returns SIM_OK or the ERR_... code the program would have
+ exited with; nothing is printed, no file is opened and the process
+ never exits. A call traps the errors raised by the engine (ErrExit)
+ with a per-thread error handler and returns them; after an error the
+ simulation can only be freed.
+
+ Simulations share no state, so different threads may run different
+ simulations at the same time. Between createSimulation and
+ executeSimulation the caller may change the simulation's settings
+ (event list kind, allocator, step scale, ...) as the switches would.
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include "cs2123p4.h"
+
+// one library call in progress on this thread
+typedef struct LibraryCall
+{
+    jmp_buf jumpBuffer;             // where trapError returns to
+    Simulation simulation;          // receives the error message, may be NULL
+    int iErrorCode;                 // SIM_OK or the ErrExit code
+    ErrorHandler pfnPrevious;       // handler to restore when the call ends
+    struct LibraryCall *pPrevious;  // enclosing call, if any
+} LibraryCall;
+
+static _Thread_local LibraryCall *pCurrentCall = NULL;
+
+static void trapError(int iExitRC, char szMessage[])
+{
+    LibraryCall *pCall = pCurrentCall;
+
+    pCall->iErrorCode = iExitRC;
+    if (pCall->simulation != NULL)
+        snprintf(pCall->simulation->szError, MAX_ERROR_MESSAGE, "%s", szMessage);
+    longjmp(pCall->jumpBuffer, 1);
+}
+
+// the setjmp itself must be in the caller: beginCall, then
+// if (setjmp(call.jumpBuffer) != 0) return endCall(&call);
+static void beginCall(LibraryCall *pCall, Simulation simulation)
+{
+    pCall->simulation = simulation;
+    pCall->iErrorCode = SIM_OK;
+    pCall->pPrevious = pCurrentCall;
+    pCall->pfnPrevious = setErrorHandler(trapError);
+    pCurrentCall = pCall;
+    if (simulation != NULL)
+        simulation->szError[0] = '\0';
+}
+
+static int endCall(LibraryCall *pCall)
+{
+    pCurrentCall = pCall->pPrevious;
+    setErrorHandler(pCall->pfnPrevious);
+    return pCall->iErrorCode;
+}
+
+/*************************** createSimulation *****************************
+ int createSimulation(Simulation *pSimulation, int iServerCount)
+ Purpose:
+ Creates a simulation with iServerCount servers, which reads its widgets
+ as it runs (streaming mode).
+ Parameters:
+ O  Simulation *pSimulation             The new simulation, NULL on error
+ I  int iServerCount                    1 to MAX_SERVERS
+ Returns:
+ SIM_OK, ERR_COMMAND_LINE for a bad server count or ERR_ALGORITHM when
+ out of memory.
+ **************************************************************************/
+int createSimulation(Simulation *pSimulation, int iServerCount)
+{
+    LibraryCall call;
+
+    *pSimulation = NULL;
+    if (iServerCount < 1 || iServerCount > MAX_SERVERS)
+        return ERR_COMMAND_LINE;
+    beginCall(&call, NULL);
+    if (setjmp(call.jumpBuffer) != 0)
+        return endCall(&call);
+
+    *pSimulation = newSimulation();
+    (*pSimulation)->bStreaming = TRUE;
+    if (iServerCount != DEFAULT_SERVERS)
+        setServerCount(*pSimulation, iServerCount);
+    return endCall(&call);
+}
+
+/***************************** loadWidgets ********************************
+ int loadWidgets(Simulation simulation, Widget widgets[], long lCount)
+ Purpose:
+ Gives the simulation its widgets from a buffer. Each widget's
+ iArrivalTime is its arrival time (not the delta of the text input).
+ Parameters:
+ I  Simulation simulation               The simulation, not yet run
+ I  Widget widgets[]                    lCount widgets by arrival time
+ I  long lCount                         Number of widgets
+ Returns:
+ SIM_OK, or ERR_BAD_INPUT when the simulation already has widgets or the
+ arrival times go backwards.
+ Notes:
+ The buffer is not copied; it must stay unchanged until the simulation
+ is freed.
+ **************************************************************************/
+int loadWidgets(Simulation simulation, Widget widgets[], long lCount)
+{
+    LibraryCall call;
+    long i;
+
+    beginCall(&call, simulation);
+    if (setjmp(call.jumpBuffer) != 0)
+        return endCall(&call);
+
+    if (simulation->arrivalWidgets != NULL || simulation->pfnWidgetSource != NULL)
+        ErrExit(ERR_BAD_INPUT, "The simulation already has its widgets");
+    for (i = 1; i < lCount; i++)
+        if (widgets[i].iArrivalTime < widgets[i - 1].iArrivalTime)
+            ErrExit(ERR_BAD_INPUT, "Widget %ld arrives before widget %ld"
+                    , widgets[i].lWidgetNr, widgets[i - 1].lWidgetNr);
+
+    simulation->arrivalWidgets = widgets;
+    simulation->bArrivalsBorrowed = TRUE;
+    simulation->lArrivalTotal = lCount;
+    simulation->iArrivalEndClock = lCount > 0 ? widgets[lCount - 1].iArrivalTime : 0;
+    if (lCount > 0)
+        simulation->iArrivalClock = widgets[0].iArrivalTime;
+    return endCall(&call);
+}
+
+/**************************** streamWidgets *******************************
+ int streamWidgets(Simulation simulation, WidgetSource pfnSource
+                   , void *pContext)
+ Purpose:
+ Gives the simulation a callback that supplies its widgets one at a time
+ while it runs, so the widgets never have to be held in memory at once.
+ Parameters:
+ I  Simulation simulation               The simulation, not yet run
+ I  WidgetSource pfnSource              Called with pContext for each
+                                        widget, in arrival time order
+ I  void *pContext                      Passed to pfnSource
+ Returns:
+ SIM_OK, ERR_BAD_INPUT when the simulation already has widgets, or the
+ error raised by the first call of pfnSource.
+ Notes:
+ executeSimulation returns ERR_BAD_INPUT if an arrival time goes
+ backwards. The first widget is requested right away.
+ **************************************************************************/
+int streamWidgets(Simulation simulation, WidgetSource pfnSource, void *pContext)
+{
+    LibraryCall call;
+
+    beginCall(&call, simulation);
+    if (setjmp(call.jumpBuffer) != 0)
+        return endCall(&call);
+
+    if (simulation->arrivalWidgets != NULL || simulation->pfnWidgetSource != NULL)
+        ErrExit(ERR_BAD_INPUT, "The simulation already has its widgets");
+    simulation->pfnWidgetSource = pfnSource;
+    simulation->pSourceContext = pContext;
+    if (pfnSource(pContext, &simulation->nextWidget) == FALSE)
+        simulation->bInputDone = TRUE;
+    else
+        simulation->iArrivalClock = simulation->nextWidget.iArrivalTime;
+    return endCall(&call);
+}
+
+/**************************** loadTraceFile *******************************
+ int loadTraceFile(Simulation simulation, char szPath[])
+ Purpose:
+ Gives the simulation its widgets from a trace file, text (as -i) or
+ binary (as written by p4convert).
+ Parameters:
+ I  Simulation simulation               The simulation, not yet run
+ I  char szPath[]                       Path of the trace
+ Returns:
+ SIM_OK, or ERR_BAD_INPUT when the file cannot be read or is not a
+ valid trace, or the simulation already has widgets.
+ Notes:
+ A text trace is parsed with simulation->iParseThreads threads (0 or
+ less - one per CPU). The parsed widgets belong to the simulation, so
+ another simulation may loadWidgets them while this one lives.
+ **************************************************************************/
+int loadTraceFile(Simulation simulation, char szPath[])
+{
+    LibraryCall call;
+    char *pszInputFile = simulation->pszInputFile;
+
+    beginCall(&call, simulation);
+    if (setjmp(call.jumpBuffer) != 0)
+    {
+        simulation->pszInputFile = pszInputFile;
+        return endCall(&call);
+    }
+
+    if (simulation->arrivalWidgets != NULL || simulation->pfnWidgetSource != NULL)
+        ErrExit(ERR_BAD_INPUT, "The simulation already has its widgets");
+    simulation->pszInputFile = szPath;
+    if (isBinaryTrace(szPath))
+        mapBinaryTrace(simulation);
+    else
+        mapArrivals(simulation);
+    simulation->pszInputFile = pszInputFile;
+    return endCall(&call);
+}
+
+/**************************** loadTraceText *******************************
+ int loadTraceText(Simulation simulation, const char *pszText, long lSize)
+ Purpose:
+ Gives the simulation its widgets from text trace lines in memory, in
+ the format of the -i input file.
+ Parameters:
+ I  Simulation simulation               The simulation, not yet run
+ I  const char *pszText                 The trace lines
+ I  long lSize                          Number of bytes of pszText
+ Returns:
+ SIM_OK, or ERR_BAD_INPUT when the simulation already has widgets or a
+ non-empty line does not hold five integers.
+ Notes:
+ The text is parsed into the simulation; it need not be kept.
+ **************************************************************************/
+int loadTraceText(Simulation simulation, const char *pszText, long lSize)
+{
+    LibraryCall call;
+    long lBadLine;
+
+    beginCall(&call, simulation);
+    if (setjmp(call.jumpBuffer) != 0)
+        return endCall(&call);
+
+    if (simulation->arrivalWidgets != NULL || simulation->pfnWidgetSource != NULL)
+        ErrExit(ERR_BAD_INPUT, "The simulation already has its widgets");
+    lBadLine = parseArrivals(simulation, pszText, lSize);
+    if (lBadLine != 0)
+        ErrExit(ERR_BAD_INPUT, "Trace line %ld does not hold five integers", lBadLine);
+    return endCall(&call);
+}
+
+/************************** executeSimulation *****************************
+ int executeSimulation(Simulation simulation, int iTimeLimit
+                       , SimulationResult *pResult)
+ Purpose:
+ Runs the simulation on its widgets until they have all left the system
+ or the next event is after iTimeLimit, and returns its statistics.
+ Parameters:
+ I  Simulation simulation               The simulation, given its widgets
+ I  int iTimeLimit                      NO_TIME_LIMIT - none
+ O  SimulationResult *pResult           The statistics of the run
+ Returns:
+ SIM_OK, ERR_BAD_INPUT when there are no widgets or they are out of
+ order, or ERR_ALGORITHM.
+ Notes:
+ The per-server averages (pResult->dAvgQueueTimes) and histograms
+ (queues[i]->waitHist and systemHist) stay in the simulation until it is
+ freed.
+ A simulation is run only once.
+ **************************************************************************/
+int executeSimulation(Simulation simulation, int iTimeLimit, SimulationResult *pResult)
+{
+    LibraryCall call;
+
+    beginCall(&call, simulation);
+    if (setjmp(call.jumpBuffer) != 0)
+        return endCall(&call);
+
+    if (simulation->arrivalWidgets == NULL && simulation->pfnWidgetSource == NULL)
+        ErrExit(ERR_BAD_INPUT, "The simulation has no widgets");
+    if (simulation->lArrivalNext != 0 || simulation->lWidgetCount != 0)
+        ErrExit(ERR_ALGORITHM, "The simulation has already been run");
+    simulation->bStreaming = TRUE;
+    readArrivalGroup(simulation);
+    simulate(simulation, iTimeLimit, pResult);
+    return endCall(&call);
+}
@@ -0,0 +1,213 @@
+/******************************************************************
+ cs2123p4_lindley.c by Justin Mungal
+
+ Machine Improvement Proposal - Lindley Recursion Engine
+
+ Purpose:
+
+ This file contains the event-free engine simulate uses when it can.
+ Every server has its own FIFO queue, and a widget is given its server
+ when it arrives and never moves, so each server is a single-server
+ queue fed by the widgets routed to it. The wait of the next widget of
+ a server follows the Lindley recursion
+
+     W[n+1] = max(0, W[n] + S[n] - A[n+1])
+
+ where S[n] is the service time (iStep1tu + iStep2tu) of widget n and
+ A[n+1] the time between the two arrivals. Keeping the time the server
+ becomes free instead of the wait gives the same recursion as
+
+     start = max(arrival, free); free = start + S
+
+ which is what seize and release compute, one event at a time.
+
+ The trace is walked once in the order arrive processes it, with the
+ state of every server (its free time and sums) held in a small array,
+ so the run is one sequential pass over the widgets and needs no event
+ list, queue nodes or widget table. The sums and histograms are the
+ ones the event engine keeps, so the statistics are bit for bit the
+ same.
+
+ The order matters within a server. A completion is processed before
+ an arrival at the same time, so a widget arriving when its server
+ becomes free does not wait (the max above). Simultaneous arrivals are
+ processed last line first (see readArrivalGroup), so each run of
+ equal arrival times is walked backwards.
+
+ The widgets must be in memory and not yet in the event list: a
+ streaming run (-s) of a parsed (-t) or binary trace, or any
+ replication, sweep configuration, partition or library simulation.
+ simulate uses the event loop instead when anything needs the events
+ themselves (verbose output or a trace, -W results or -S steady-state
+ batches in the order the widgets leave, a time limit, checkpoints, a
+ what-if run, -m allocation counts), when the simulation is not
+ fresh, when the trace is not in arrival order, or when -E event is
+ given.
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "cs2123p4.h"
+
+// state of one server, in the order of its widgets
+typedef struct
+{
+    int iFreeAt;                    // time the server finishes its last widget
+    long lWaitSum;                  // queue times of its widgets
+    long lCount;                    // widgets routed to it
+} LindleyServer;
+
+/************************* canSimulateLindley *****************************
+ int canSimulateLindley(Simulation simulation, int iTimeLimit)
+ Purpose:
+ Determines whether simulate may use simulateLindley for this run.
+ Parameters:
+ I  Simulation simulation           The simulation, ready to simulate
+ I  int iTimeLimit                  The time limit passed to simulate
+ Returns:
+ TRUE if the run has no use for its events and its widgets are all in
+ simulation->arrivalWidgets, with none of them processed yet.
+ Notes:
+ After readArrivalGroup, the only widgets read are the look-ahead
+ arrivals; simulateLindley takes them from arrivalWidgets again.
+ **************************************************************************/
+int canSimulateLindley(Simulation simulation, int iTimeLimit)
+{
+    if (simulation->iEngine != ENG_AUTO || simulation->bVerbose == TRUE
+        || simulation->traceSink != NULL || simulation->resultSink != NULL
+        || simulation->steadyState != NULL
+        || simulation->bMemoryReport == TRUE
+        || iTimeLimit != NO_TIME_LIMIT || simulation->whatIf != NULL
+        || simulation->pszCheckpointFile != NULL)
+        return FALSE;
+
+    //only a fresh streaming simulation over an in-memory trace
+    return simulation->bStreaming == TRUE && simulation->arrivalWidgets != NULL
+           && simulation->pfnWidgetSource == NULL
+           && simulation->lWidgetCount == 0
+           && simulation->lArrivalNext == simulation->iArrivalGroupCount
+           && peekTimeLL(simulation->eventList) == NO_EVENT_TIME;
+}
+/************************** simulateLindley *******************************
+ int simulateLindley(Simulation simulation)
+ Purpose:
+ Runs a simulation allowed by canSimulateLindley to its end with the
+ Lindley recursion, leaving the clock, sums and histograms as the event
+ loop would.
+ Parameters:
+ I/O Simulation simulation          The simulation structure
+ Returns:
+ TRUE if the run was simulated. FALSE if the trace is not in arrival
+ order, or has a negative service time; the simulation is then left as
+ it was, for the event loop.
+ Notes:
+ The step scale and routing that readArrival applies, and the fallback
+ of arrive to the last server, are applied to each widget here.
+ **************************************************************************/
+int simulateLindley(Simulation simulation)
+{
+    Widget *widgets = simulation->arrivalWidgets;
+    long lTotal = simulation->lArrivalTotal;
+    int iServerCount = simulation->iServerCount;
+    LindleyServer *servers;
+    long i, j, lGroupEnd;
+    int iClock = simulation->iClock;
+    int iServer, bInOrder = TRUE;
+
+    servers = (LindleyServer *)malloc(iServerCount * sizeof(LindleyServer));
+    if (servers == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for %d servers", iServerCount);
+    for (iServer = 0; iServer < iServerCount; iServer++)
+    {
+        servers[iServer].iFreeAt = INT_MIN;
+        servers[iServer].lWaitSum = 0;
+        servers[iServer].lCount = 0;
+    }
+
+    for (i = 0; i < lTotal && bInOrder == TRUE; i = lGroupEnd)
+    {
+        //the run of arrivals at the same time, processed last line first
+        for (lGroupEnd = i + 1; lGroupEnd < lTotal
+             && widgets[lGroupEnd].iArrivalTime == widgets[i].iArrivalTime; lGroupEnd++)
+            ;
+        if (lGroupEnd < lTotal && widgets[lGroupEnd].iArrivalTime < widgets[i].iArrivalTime)
+            bInOrder = FALSE;
+
+        for (j = lGroupEnd - 1; j >= i && bInOrder == TRUE; j--)
+        {
+            Widget *pWidget = &widgets[j];
+            LindleyServer *pServer;
+            int iService, iStart, iWaited;
+
+            //the widget as readArrival and arrive see it
+            if (simulation->dStepScale != 1.0)
+                iService = (int)(pWidget->iStep1tu * simulation->dStepScale + 0.5)
+                         + (int)(pWidget->iStep2tu * simulation->dStepScale + 0.5);
+            else
+                iService = pWidget->iStep1tu + pWidget->iStep2tu;
+            if (simulation->iForceServer == ROUTE_SPREAD)
+                iServer = (int)(pWidget->lWidgetNr % iServerCount);
+            else if (simulation->iForceServer != 0)
+                iServer = simulation->iForceServer - 1;
+            else
+                iServer = pWidget->iWhichServer - 1;
+            if (iServer < 0 || iServer >= iServerCount)
+                iServer = iServerCount - 1;
+            pServer = &servers[iServer];
+
+            //a completion before its arrival would move the clock back
+            if (iService < 0)
+                bInOrder = FALSE;
+
+            //seize when the server becomes free, release after the service
+            iStart = pWidget->iArrivalTime > pServer->iFreeAt ? pWidget->iArrivalTime
+                                                              : pServer->iFreeAt;
+            iWaited = iStart - pWidget->iArrivalTime;
+            pServer->iFreeAt = iStart + iService;
+            pServer->lWaitSum += iWaited;
+            pServer->lCount++;
+            recordHistogram(&simulation->queues[iServer]->waitHist, iWaited);
+
+            //leaveSystem
+            simulation->lSystemTimeSum += iWaited + iService;
+            recordHistogram(&simulation->systemHist, iWaited + iService);
+            if (pServer->iFreeAt > iClock)
+                iClock = pServer->iFreeAt;
+        }
+    }
+
+    if (bInOrder == FALSE)
+    {
+        //out of order: undo the histograms for the event loop
+        for (iServer = 0; iServer < iServerCount; iServer++)
+            initHistogram(&simulation->queues[iServer]->waitHist);
+        initHistogram(&simulation->systemHist);
+        simulation->lSystemTimeSum = 0;
+        free(servers);
+        return FALSE;
+    }
+
+    for (iServer = 0; iServer < iServerCount; iServer++)
+    {
+        simulation->queues[iServer]->lQueueWaitSum = servers[iServer].lWaitSum;
+        simulation->queues[iServer]->lQueueWidgetTotalCount = servers[iServer].lCount;
+    }
+    simulation->lWidgetCount = lTotal;
+    simulation->iClock = iClock;
+
+    //every widget has been read, and the look-ahead arrivals are done with
+    while (simulation->iArrivalGroupCount > 0)
+        removeWidget(&simulation->widgets
+                     , simulation->arrivalGroup[--simulation->iArrivalGroupCount].uWidgetId);
+    simulation->lArrivalNext = lTotal;
+    simulation->iArrivalClock = simulation->iArrivalEndClock;
+    STAT(simulation->stats.bLindley = TRUE);
+    free(servers);
+    return TRUE;
+}
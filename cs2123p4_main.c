@@ -0,0 +1,104 @@
+/******************************************************************
+ cs2123p4_main.c by Justin Mungal
+ 
+ Machine Improvement Proposal - Main Program
+ 
+ Purpose:
+ 
+ Processes the command line switches, generates the arrivals and
+ runs the simulation (or the replications or parameter sweep that
+ were requested). See cs2123p4.c for the simulation and the input
+ format.
+ 
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include "cs2123p4.h"
+
+int main(int argc, char *argv[])
+{
+    int iTimeLimit;
+    double dStart;
+    
+    Simulation simulation = newSimulation();
+    
+    //process command line switches
+    processCommandSwitches(argc, argv, simulation);
+    iTimeLimit = simulation->iTimeLimit;
+    
+    //replications, sweeps and partitions share the parsed trace, so it
+    //must be kept in memory
+    if (simulation->iReplications > 0 || simulation->pszSweepGrid != NULL
+        || simulation->iPartitions > 0 || simulation->pszWhatIfFiles != NULL)
+    {
+        if (simulation->iParseThreads < 0)
+            simulation->iParseThreads = 0;
+        simulation->bStreaming = TRUE;
+    }
+    
+    //partitions print no events and keep no single state to snapshot
+    if (simulation->iPartitions > 0
+        && (simulation->iReplications > 0 || simulation->pszSweepGrid != NULL
+            || simulation->bVerbose || simulation->pszTraceFile != NULL
+            || simulation->pszCheckpointFile != NULL
+            || simulation->pszResumeFile != NULL))
+        ErrExit(ERR_COMMAND_LINE, "-P cannot be combined with -r, -g, -v, -T, -c or -x");
+    
+    //a what-if run resumes from its own in-memory checkpoints
+    if (simulation->pszWhatIfFiles != NULL
+        && (simulation->iReplications > 0 || simulation->pszSweepGrid != NULL
+            || simulation->iPartitions > 0 || simulation->bVerbose
+            || simulation->pszTraceFile != NULL || simulation->pszCheckpointFile != NULL
+            || simulation->pszResumeFile != NULL || simulation->bStats == TRUE))
+        ErrExit(ERR_COMMAND_LINE, "-w cannot be combined with -r, -g, -P, -v, -T, -c, -x or --stats");
+    
+    //the results file follows one simulation's widgets as they leave
+    if (simulation->pszResultFile != NULL
+        && (simulation->iReplications > 0 || simulation->pszSweepGrid != NULL
+            || simulation->iPartitions > 0 || simulation->pszWhatIfFiles != NULL))
+        ErrExit(ERR_COMMAND_LINE, "-W cannot be combined with -r, -g, -P or -w");
+    
+    //steady state follows one simulation's widgets as they leave, and
+    //stops it early
+    if (simulation->dSteadyHalfWidth > 0.0
+        && (simulation->iReplications > 0 || simulation->pszSweepGrid != NULL
+            || simulation->iPartitions > 0 || simulation->pszWhatIfFiles != NULL))
+        ErrExit(ERR_COMMAND_LINE, "-S cannot be combined with -r, -g, -P or -w");
+    
+    //--stats reports one simulation (the partitions are gathered into one)
+    if (simulation->bStats == TRUE
+        && (simulation->iReplications > 0 || simulation->pszSweepGrid != NULL))
+        ErrExit(ERR_COMMAND_LINE, "--stats cannot be combined with -r or -g");
+    
+    //a resumed run takes its state, pending arrivals included, from the
+    //snapshot
+    dStart = wallSeconds();
+    if (simulation->pszResumeFile != NULL)
+    {
+        if (simulation->iReplications > 0 || simulation->pszSweepGrid != NULL)
+            ErrExit(ERR_COMMAND_LINE, "A snapshot can only be resumed by a single run");
+        readSnapshot(simulation, simulation->pszResumeFile);
+    }
+    else
+        //call populateSim to populate our sim from standard input
+        generateArrival(simulation);
+    simulation->stats.dParseSeconds = wallSeconds() - dStart;
+    
+    //call run simulation
+    if (simulation->pszSweepGrid != NULL)
+        runSweep(simulation, iTimeLimit);
+    else if (simulation->iReplications > 0)
+        runReplications(simulation, iTimeLimit);
+    else if (simulation->iPartitions > 0)
+        runParallel(simulation, iTimeLimit);
+    else if (simulation->pszWhatIfFiles != NULL)
+        runWhatIf(simulation, iTimeLimit);
+    else
+        runSimulation(simulation, iTimeLimit);
+
+}
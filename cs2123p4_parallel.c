@@ -0,0 +1,237 @@
+/******************************************************************
+ cs2123p4_parallel.c by Justin Mungal
+
+ Machine Improvement Proposal - Partitioned Parallel Simulation
+
+ Purpose:
+
+ This file contains the parallel engine (-P partitions). The servers
+ are split into contiguous blocks, and each block is simulated by its
+ own Simulation, with its own event list, queues and servers, on the
+ work-stealing pool.
+
+ A conservative parallel simulation may only process an event once
+ no other partition can still send it an earlier one; the lookahead
+ is the least time a message between partitions takes. Here a widget
+ is given its server when it arrives and never moves to another
+ server, so no events pass between partitions and the lookahead is
+ unbounded. Each partition therefore runs to the end without waiting
+ on the others, on the arrivals routed to its servers.
+
+ The arrivals of a partition keep their order from the trace, and
+ the event list orders every subset of its events the way it orders
+ all of them, so each server sees exactly the events it sees in the
+ sequential engine, in the same order. The statistics are integer
+ sums and histograms, which are added together afterwards, so the
+ results are bit for bit those of the sequential engine.
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include "cs2123p4.h"
+
+typedef struct
+{
+    Simulation base;                // the parsed trace and the switches
+    int iTimeLimit;
+    int iPartitions;
+    int *iFirstServer;              // iFirstServer[p] to iFirstServer[p + 1] - 1
+    Widget **partitionWidgets;      // arrivals routed to each partition
+    long *lPartitionCounts;         // number of arrivals in each partition
+    Simulation *partitions;         // the finished partition simulations
+    SimulationResult *results;      // one per partition
+} ParallelContext;
+
+// server subscript arrive uses for a widget
+static int routeServer(Widget *pWidget, int iServerCount)
+{
+    int iServer = pWidget->iWhichServer - 1;
+
+    if (iServer < 0 || iServer >= iServerCount)
+        iServer = iServerCount - 1;
+    return iServer;
+}
+
+static void runPartition(void *pContext, long lPartition)
+{
+    ParallelContext *pParallel = (ParallelContext *)pContext;
+    Simulation base = pParallel->base;
+    Simulation simulation = newSimulation();
+
+    setEventListKind(simulation->eventList, base->eventList->iKind);
+    simulation->iEngine = base->iEngine;
+    simulation->bMemoryReport = base->bMemoryReport;
+    simulation->eventList->nodePool.bPooled = base->eventList->nodePool.bPooled;
+    simulation->bStreaming = TRUE;
+    setServerCount(simulation, pParallel->iFirstServer[lPartition + 1]
+                               - pParallel->iFirstServer[lPartition]);
+
+    simulation->arrivalWidgets = pParallel->partitionWidgets[lPartition];
+    simulation->lArrivalTotal = pParallel->lPartitionCounts[lPartition];
+    simulation->iArrivalEndClock = base->iArrivalEndClock;
+    readArrivalGroup(simulation);
+
+    simulate(simulation, pParallel->iTimeLimit, &pParallel->results[lPartition]);
+    pParallel->partitions[lPartition] = simulation;
+}
+
+/**************************** splitArrivals *******************************
+ void splitArrivals(ParallelContext *pParallel)
+ Purpose:
+ Copies each widget of the trace to the arrivals of the partition that
+ owns its server, renumbering iWhichServer within the partition.
+ **************************************************************************/
+static void splitArrivals(ParallelContext *pParallel)
+{
+    Simulation base = pParallel->base;
+    int *iPartitionOf = (int *)malloc(base->iServerCount * sizeof(int));
+    long *lNext = (long *)calloc(pParallel->iPartitions, sizeof(long));
+    long i;
+    int p, iServer;
+
+    if (iPartitionOf == NULL || lNext == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the partitions");
+    for (p = 0; p < pParallel->iPartitions; p++)
+        for (iServer = pParallel->iFirstServer[p]
+             ; iServer < pParallel->iFirstServer[p + 1]; iServer++)
+            iPartitionOf[iServer] = p;
+
+    for (i = 0; i < base->lArrivalTotal; i++)
+        pParallel->lPartitionCounts[iPartitionOf[routeServer(&base->arrivalWidgets[i]
+                                                             , base->iServerCount)]]++;
+    for (p = 0; p < pParallel->iPartitions; p++)
+    {
+        pParallel->partitionWidgets[p] = (Widget *)malloc(
+                                         (pParallel->lPartitionCounts[p] + 1) * sizeof(Widget));
+        if (pParallel->partitionWidgets[p] == NULL)
+            ErrExit(ERR_ALGORITHM, "No available memory for the partitions");
+    }
+    for (i = 0; i < base->lArrivalTotal; i++)
+    {
+        iServer = routeServer(&base->arrivalWidgets[i], base->iServerCount);
+        p = iPartitionOf[iServer];
+        pParallel->partitionWidgets[p][lNext[p]] = base->arrivalWidgets[i];
+        pParallel->partitionWidgets[p][lNext[p]++].iWhichServer
+            = iServer - pParallel->iFirstServer[p] + 1;
+    }
+    free(iPartitionOf);
+    free(lNext);
+}
+
+/***************************** runParallel ********************************
+ void runParallel(Simulation simulation, int iTimeLimit)
+ Purpose:
+ Simulates the input trace with the servers split into
+ simulation->iPartitions partitions run in parallel, and prints the
+ same statistics as runSimulation.
+ Parameters:
+ I  Simulation simulation           The simulation holding the parsed
+                                    input (arrivalWidgets) and switches.
+ I  int iTimeLimit                  Passed on to simulate.
+ Notes:
+ The partitions' statistics are gathered into the simulation's own
+ servers and queues, which is then freed.
+ **************************************************************************/
+void runParallel(Simulation simulation, int iTimeLimit)
+{
+    ParallelContext parallel;
+    SimulationResult result;
+    LinkedList list = simulation->eventList;
+    double dStart;
+    int p, i;
+
+    if (simulation->arrivalWidgets == NULL)
+        ErrExit(ERR_BAD_INPUT, "Partitions need an input file");
+
+    parallel.base = simulation;
+    parallel.iTimeLimit = iTimeLimit;
+    parallel.iPartitions = simulation->iPartitions < simulation->iServerCount
+                         ? simulation->iPartitions : simulation->iServerCount;
+    parallel.iFirstServer = (int *)malloc((parallel.iPartitions + 1) * sizeof(int));
+    parallel.partitionWidgets = (Widget **)malloc(parallel.iPartitions * sizeof(Widget *));
+    parallel.lPartitionCounts = (long *)calloc(parallel.iPartitions, sizeof(long));
+    parallel.partitions = (Simulation *)malloc(parallel.iPartitions * sizeof(Simulation));
+    parallel.results = (SimulationResult *)malloc(parallel.iPartitions
+                                                  * sizeof(SimulationResult));
+    if (parallel.iFirstServer == NULL || parallel.partitionWidgets == NULL
+        || parallel.lPartitionCounts == NULL || parallel.partitions == NULL
+        || parallel.results == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the partitions");
+    for (p = 0; p <= parallel.iPartitions; p++)
+        parallel.iFirstServer[p] = (int)((long)simulation->iServerCount * p
+                                         / parallel.iPartitions);
+
+    dStart = wallSeconds();
+    splitArrivals(&parallel);
+    runWorkPool(parallel.iPartitions, simulation->iWorkerThreads, runPartition
+                , &parallel);
+
+    // gather the partitions into the simulation's servers and queues
+    result.bTimeLimitReached = FALSE;
+    for (p = 0; p < parallel.iPartitions; p++)
+    {
+        Simulation partition = parallel.partitions[p];
+
+        if (partition->iClock > simulation->iClock)
+            simulation->iClock = partition->iClock;
+        if (parallel.results[p].bTimeLimitReached)
+            result.bTimeLimitReached = TRUE;
+        simulation->lSystemTimeSum += partition->lSystemTimeSum;
+        simulation->lWidgetCount += partition->lWidgetCount;
+        mergeHistogram(&simulation->systemHist, &partition->systemHist);
+        for (i = 0; i < partition->iServerCount; i++)
+        {
+            Queue queue = simulation->queues[parallel.iFirstServer[p] + i];
+            queue->lQueueWaitSum = partition->queues[i]->lQueueWaitSum;
+            queue->lQueueWidgetTotalCount = partition->queues[i]->lQueueWidgetTotalCount;
+            queue->waitHist = partition->queues[i]->waitHist;
+#ifndef QUEUE_RING
+            queue->nodePool.lAllocCount = partition->queues[i]->nodePool.lAllocCount;
+            queue->nodePool.lFreeCount = partition->queues[i]->nodePool.lFreeCount;
+            queue->nodePool.lMallocCount = partition->queues[i]->nodePool.lMallocCount;
+            queue->nodePool.lPeakInUse = partition->queues[i]->nodePool.lPeakInUse;
+#else
+            queue->lPeakCount = partition->queues[i]->lPeakCount;
+#endif
+        }
+        list->nodePool.lAllocCount += partition->eventList->nodePool.lAllocCount;
+        list->nodePool.lFreeCount += partition->eventList->nodePool.lFreeCount;
+        list->nodePool.lMallocCount += partition->eventList->nodePool.lMallocCount;
+
+        // --stats: counts add up, peaks are the largest of any partition
+        for (i = 0; i < EVT_TYPE_COUNT; i++)
+            simulation->stats.lEventCounts[i] += partition->stats.lEventCounts[i];
+        if (partition->stats.bLindley == TRUE)
+            simulation->stats.bLindley = TRUE;
+        list->lSearchCalls += partition->eventList->lSearchCalls;
+        list->lSearchSteps += partition->eventList->lSearchSteps;
+        if (partition->eventList->lSearchMax > list->lSearchMax)
+            list->lSearchMax = partition->eventList->lSearchMax;
+        if (partition->eventList->nodePool.lPeakInUse > list->nodePool.lPeakInUse)
+            list->nodePool.lPeakInUse = partition->eventList->nodePool.lPeakInUse;
+        simulation->stats.uWidgetRows += partition->widgets.uRows;
+        simulation->stats.uWidgetCapacity += partition->widgets.uCapacity;
+        freeSimulation(partition);
+    }
+    summarizeSimulation(simulation, &result);
+    simulation->stats.dSimulateSeconds = wallSeconds() - dStart;
+
+    printf("Time\t       \t Event");
+    dStart = wallSeconds();
+    printSimulationResult(simulation, &result);
+    simulation->stats.dReportSeconds = wallSeconds() - dStart;
+    if (simulation->bStats == TRUE)
+        printStatsJson(simulation);
+
+    free(parallel.iFirstServer);
+    free(parallel.partitionWidgets);
+    free(parallel.lPartitionCounts);
+    free(parallel.partitions);
+    free(parallel.results);
+    freeSimulation(simulation);
+}
@@ -0,0 +1,317 @@
+/******************************************************************
+ cs2123p4_parse.c by Justin Mungal
+
+ Machine Improvement Proposal - Parallel Input Parser
+
+ Purpose:
+
+ This file contains the memory-mapped input parser used with -t.
+ The input file is mapped, split into line-aligned chunks and each
+ chunk is parsed by its own thread with a hand-written integer
+ scanner. Arrival times are then computed with a parallel prefix
+ sum over iArrivalDelta.
+
+ The parsed widgets are kept in simulation->arrivalWidgets, and
+ readArrival hands them out in input order exactly like lines read
+ with fgets. parseArrivals does the same for text already in memory
+ (the library's loadTraceText).
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cs2123p4.h"
+
+// work for one parser thread
+typedef struct
+{
+    const char *pszBegin;           // first byte of the chunk (start of a line)
+    const char *pszEnd;             // one past the last byte of the chunk
+    long lLineCount;                // lines in the chunk before any empty line
+    int bEmptyLine;                 // TRUE - the chunk contains an empty line
+    long lBadLine;                  // first line without five integers, -1 if none
+    Widget *widgets;                // where the chunk's widgets are stored
+    int iDeltaSum;                  // sum of the chunk's iArrivalDelta values
+    int iTimeBase;                  // arrival time of the chunk's first widget
+} ParseChunk;
+
+/************************** scanInt ***************************************
+ int scanInt(const char **ppsz, const char *pszEnd, long *plValue)
+ Purpose:
+ Skips blanks and converts an optionally signed decimal integer into
+ *plValue, leaving *ppsz just past it. This replaces sscanf's %d on the
+ hot path.
+ Returns:
+ TRUE, or FALSE when there are no digits (the end of the line or
+ anything else), as sscanf would fail.
+ **************************************************************************/
+static int scanInt(const char **ppsz, const char *pszEnd, long *plValue)
+{
+    const char *p = *ppsz;
+    const char *pszDigits;
+    long lValue = 0;
+    int bNegative = FALSE;
+
+    while (p < pszEnd && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+    if (p < pszEnd && (*p == '-' || *p == '+'))
+    {
+        bNegative = *p == '-';
+        p++;
+    }
+    pszDigits = p;
+    while (p < pszEnd && *p >= '0' && *p <= '9')
+        lValue = lValue * 10 + (*p++ - '0');
+    if (p == pszDigits)
+        return FALSE;
+    *ppsz = p;
+    *plValue = bNegative ? -lValue : lValue;
+    return TRUE;
+}
+
+// pass 1: count the lines of a chunk, stopping at an empty line
+static void *countChunk(void *pArg)
+{
+    ParseChunk *pChunk = (ParseChunk *)pArg;
+    const char *p = pChunk->pszBegin;
+
+    pChunk->lLineCount = 0;
+    pChunk->bEmptyLine = FALSE;
+    while (p < pChunk->pszEnd)
+    {
+        const char *pszNewLine;
+        if (*p == '\n')
+        {
+            pChunk->bEmptyLine = TRUE;
+            break;
+        }
+        pChunk->lLineCount++;
+        pszNewLine = memchr(p, '\n', pChunk->pszEnd - p);
+        if (pszNewLine == NULL)
+            break;
+        p = pszNewLine + 1;
+    }
+    return NULL;
+}
+
+// pass 2: parse the lines of a chunk and compute arrival times relative
+// to the start of the chunk, stopping at a line without five integers
+static void *parseChunk(void *pArg)
+{
+    ParseChunk *pChunk = (ParseChunk *)pArg;
+    const char *p = pChunk->pszBegin;
+    int iTime = 0;
+    long i;
+
+    pChunk->lBadLine = -1;
+    for (i = 0; i < pChunk->lLineCount; i++)
+    {
+        Widget *pWidget = &pChunk->widgets[i];
+        const char *pszNewLine;
+        long lValues[5];
+        int k;
+
+        for (k = 0; k < 5; k++)
+            if (scanInt(&p, pChunk->pszEnd, &lValues[k]) == FALSE)
+            {
+                pChunk->lBadLine = i;
+                break;
+            }
+        if (pChunk->lBadLine >= 0)
+            break;
+        pWidget->lWidgetNr = lValues[0];
+        pWidget->iStep1tu = (int)lValues[1];
+        pWidget->iStep2tu = (int)lValues[2];
+        pWidget->iWhichServer = (int)lValues[4];
+        pWidget->iArrivalTime = iTime;
+        iTime += (int)lValues[3];
+
+        pszNewLine = memchr(p, '\n', pChunk->pszEnd - p);
+        p = pszNewLine == NULL ? pChunk->pszEnd : pszNewLine + 1;
+    }
+    pChunk->iDeltaSum = iTime;
+    return NULL;
+}
+
+// pass 3: shift the chunk's arrival times by the sum of the earlier chunks
+static void *offsetChunk(void *pArg)
+{
+    ParseChunk *pChunk = (ParseChunk *)pArg;
+    long i;
+
+    if (pChunk->iTimeBase != 0)
+        for (i = 0; i < pChunk->lLineCount; i++)
+            pChunk->widgets[i].iArrivalTime += pChunk->iTimeBase;
+    return NULL;
+}
+
+// run one pass over every chunk, one thread per chunk
+static void runParsePass(ParseChunk chunks[], int iChunks, void *(*pass)(void *))
+{
+    pthread_t threads[MAX_PARSE_THREADS];
+    int i;
+
+    for (i = 1; i < iChunks; i++)
+        if (pthread_create(&threads[i], NULL, pass, &chunks[i]) != 0)
+            ErrExit(ERR_ALGORITHM, "Unable to create parser thread");
+    pass(&chunks[0]);
+    for (i = 1; i < iChunks; i++)
+        pthread_join(threads[i], NULL);
+}
+
+/**************************** mapArrivals *********************************
+ void mapArrivals(Simulation simulation)
+ Purpose:
+ Parses the whole input file in parallel into simulation->arrivalWidgets.
+ Parameters:
+ I  Simulation simulation               The simulation structure
+ Notes:
+ simulation->iParseThreads chunks are used (0 means one per online CPU).
+ As with fgets, the input ends at the end of the file or at the first
+ empty line, and any other line without five integers is ERR_BAD_INPUT.
+ **************************************************************************/
+void mapArrivals(Simulation simulation)
+{
+    struct stat fileStat;
+    const char *pszMap;
+    long lSize, lBadLine;
+    int iFd;
+
+    iFd = open(simulation->pszInputFile, O_RDONLY);
+    if (iFd < 0)
+        ErrExit(ERR_BAD_INPUT, "Unable to open input file '%s'"
+                , simulation->pszInputFile);
+    if (fstat(iFd, &fileStat) != 0)
+    {
+        close(iFd);
+        ErrExit(ERR_BAD_INPUT, "Unable to open input file '%s'"
+                , simulation->pszInputFile);
+    }
+    lSize = (long)fileStat.st_size;
+
+    pszMap = "";
+    if (lSize > 0)
+    {
+        pszMap = mmap(NULL, lSize, PROT_READ, MAP_PRIVATE, iFd, 0);
+        if (pszMap == MAP_FAILED)
+        {
+            close(iFd);
+            ErrExit(ERR_BAD_INPUT, "Unable to map input file '%s'"
+                    , simulation->pszInputFile);
+        }
+        madvise((void *)pszMap, lSize, MADV_SEQUENTIAL);
+    }
+    close(iFd);
+
+    lBadLine = parseArrivals(simulation, pszMap, lSize);
+
+    if (lSize > 0)
+        munmap((void *)pszMap, lSize);
+    if (lBadLine != 0)
+        ErrExit(ERR_BAD_INPUT, "Line %ld of '%s' does not hold five integers"
+                , lBadLine, simulation->pszInputFile);
+}
+
+/*************************** parseArrivals ********************************
+ long parseArrivals(Simulation simulation, const char *pszText, long lSize)
+ Purpose:
+ Parses lSize bytes of input text in parallel into
+ simulation->arrivalWidgets.
+ Parameters:
+ I  Simulation simulation               The simulation structure
+ I  const char *pszText                 The input lines (need not end in '\0')
+ I  long lSize                          Number of bytes of pszText
+ Returns:
+ 0, or the number (from 1) of the first line without five integers, in
+ which case the simulation is given no widgets.
+ Notes:
+ See mapArrivals. The caller reports a bad line, after releasing the
+ text.
+ **************************************************************************/
+long parseArrivals(Simulation simulation, const char *pszText, long lSize)
+{
+    ParseChunk chunks[MAX_PARSE_THREADS];
+    const char *pszMap = pszText;
+    long lTotal;
+    int iChunks, i;
+
+    iChunks = simulation->iParseThreads;
+    if (iChunks <= 0)
+        iChunks = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (iChunks > MAX_PARSE_THREADS)
+        iChunks = MAX_PARSE_THREADS;
+    if (iChunks < 1 || lSize < (long)iChunks * MAX_LINE_SIZE)
+        iChunks = 1;
+
+    // split into chunks that start at the beginning of a line
+    chunks[0].pszBegin = pszMap;
+    for (i = 1; i < iChunks; i++)
+    {
+        const char *p = pszMap + lSize * i / iChunks;
+        const char *pszNewLine;
+        if (p < chunks[i - 1].pszBegin)
+            p = chunks[i - 1].pszBegin;
+        pszNewLine = memchr(p, '\n', pszMap + lSize - p);
+        chunks[i].pszBegin = pszNewLine == NULL ? pszMap + lSize : pszNewLine + 1;
+        chunks[i - 1].pszEnd = chunks[i].pszBegin;
+    }
+    chunks[iChunks - 1].pszEnd = pszMap + lSize;
+
+    runParsePass(chunks, iChunks, countChunk);
+
+    // the input ends in the first chunk holding an empty line
+    for (i = 0; i < iChunks; i++)
+        if (chunks[i].bEmptyLine == TRUE)
+        {
+            iChunks = i + 1;
+            break;
+        }
+
+    lTotal = 0;
+    for (i = 0; i < iChunks; i++)
+        lTotal += chunks[i].lLineCount;
+    simulation->arrivalWidgets = (Widget *)malloc((lTotal + 1) * sizeof(Widget));
+    if (simulation->arrivalWidgets == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for %ld widgets", lTotal);
+    lTotal = 0;
+    for (i = 0; i < iChunks; i++)
+    {
+        chunks[i].widgets = simulation->arrivalWidgets + lTotal;
+        lTotal += chunks[i].lLineCount;
+    }
+
+    runParsePass(chunks, iChunks, parseChunk);
+
+    lTotal = 0;
+    for (i = 0; i < iChunks; i++)
+    {
+        if (chunks[i].lBadLine >= 0)
+        {
+            free(simulation->arrivalWidgets);
+            simulation->arrivalWidgets = NULL;
+            return lTotal + chunks[i].lBadLine + 1;
+        }
+        lTotal += chunks[i].lLineCount;
+    }
+
+    // exclusive prefix sum of the chunk delta sums, then shift each chunk
+    chunks[0].iTimeBase = 0;
+    for (i = 1; i < iChunks; i++)
+        chunks[i].iTimeBase = chunks[i - 1].iTimeBase + chunks[i - 1].iDeltaSum;
+    runParsePass(chunks, iChunks, offsetChunk);
+
+    simulation->lArrivalTotal = lTotal;
+    simulation->lArrivalNext = 0;
+    simulation->iArrivalEndClock = chunks[iChunks - 1].iTimeBase
+                                 + chunks[iChunks - 1].iDeltaSum;
+    return 0;
+}
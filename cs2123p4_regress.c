@@ -0,0 +1,339 @@
+/******************************************************************
+ cs2123p4_regress.c by Justin Mungal
+
+ Machine Improvement Proposal - Performance Regression Check (p4regress)
+
+ Purpose:
+
+ Measures the throughput and peak memory of the engine on a generated
+ trace and compares the throughput with a stored baseline, so that a
+ change that makes the engine slower fails the tests (ctest runs this
+ as perf_regression). The cases are
+
+ parse           parseArrivals of the trace's text on one thread;
+                 each op is a widget
+ event           the event loop (heap, pooled nodes); each op is an
+                 event
+ lindley         the same run computed by simulateLindley; each op is
+                 an event the event loop would process
+
+ Each case runs in its own child process, so that its peak RSS is its
+ own. The throughput is the best of REGRESS_REPEATS runs, which is the
+ least disturbed by the rest of the machine.
+
+ The baseline is a CSV file with the rows
+
+ case,build,widgets,ops_per_sec,peak_rss_kb
+
+ for each build type (CMAKE_BUILD_TYPE, "default" when it is empty),
+ as the throughput differs between optimized and debug builds. A case
+ fails when its throughput is more than the threshold below the
+ baseline; a case without a baseline row only reports. -u replaces this
+ build's rows with the new measurements (the perf_baseline target).
+
+ Usage:
+ p4regress [-b baseline.csv] [-t threshold] [-c widgets] [-u]
+
+ -b file        baseline file (default perf_baseline.csv)
+ -t threshold   largest allowed fraction lost (default 0.25)
+ -c widgets     trace size (default 1000000)
+ -u             record the measurements as this build's baseline
+
+ Returns:
+ 0 when no case regressed, 1 when one did, ERR_COMMAND_LINE or
+ ERR_BAD_INPUT otherwise.
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "cs2123p4.h"
+
+#ifndef P4_BUILD_TYPE
+#define P4_BUILD_TYPE       ""
+#endif
+
+#define REGRESS_REPEATS     5           // runs per case, the best is kept
+#define REGRESS_MAX_ROWS    64          // baseline rows kept by -u
+#define REGRESS_CASES       3
+
+static const char *pszCaseNames[REGRESS_CASES] = { "parse", "event", "lindley" };
+
+// one row of the baseline file
+typedef struct
+{
+    char szCase[16];
+    char szBuild[32];
+    long lWidgets;
+    double dOpsPerSec;
+    long lPeakRssKb;
+} BaselineRow;
+
+static void regressUsage(void)
+{
+    fprintf(stderr, "usage: p4regress [-b baseline.csv] [-t threshold] [-c widgets] [-u]\n");
+    exit(ERR_COMMAND_LINE);
+}
+
+// widgets like the sample input, the same for every run (see p4bench)
+static Widget *generateWidgets(long lCount)
+{
+    Widget *widgets = (Widget *)malloc(lCount * sizeof(Widget));
+    unsigned long long ullSeed = 1;
+    int iArrivalClock = 0;
+    long i;
+
+    if (widgets == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for %ld widgets", lCount);
+    for (i = 0; i < lCount; i++)
+    {
+        unsigned long long ullRandom = nextRandom(&ullSeed);
+        widgets[i].lWidgetNr = i + 1;
+        widgets[i].iStep1tu = (int)(ullRandom % 17);
+        widgets[i].iStep2tu = (int)((ullRandom >> 8) % 21);
+        widgets[i].iWhichServer = (int)((ullRandom >> 16) & 1) + 1;
+        widgets[i].iArrivalTime = iArrivalClock;
+        iArrivalClock += (int)((ullRandom >> 24) % 21);
+    }
+    return widgets;
+}
+
+// the widgets as the text of an input file; *plSize receives its length
+static char *traceText(Widget widgets[], long lCount, long *plSize)
+{
+    char *pszText = (char *)malloc(lCount * MAX_LINE_SIZE);
+    long lSize = 0, i;
+
+    if (pszText == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the trace text");
+    for (i = 0; i < lCount; i++)
+    {
+        int iNextArrival = i + 1 < lCount ? widgets[i + 1].iArrivalTime
+                                          : widgets[i].iArrivalTime;
+        lSize += sprintf(pszText + lSize, "%ld %d %d %d %d\n", widgets[i].lWidgetNr
+                         , widgets[i].iStep1tu, widgets[i].iStep2tu
+                         , iNextArrival - widgets[i].iArrivalTime, widgets[i].iWhichServer);
+    }
+    *plSize = lSize;
+    return pszText;
+}
+
+/****************************** measureCase *******************************
+ double measureCase(int iCase, long lWidgets)
+ Purpose:
+ Runs case iCase REGRESS_REPEATS times on a trace of lWidgets widgets
+ and returns its best throughput in ops per second.
+ **************************************************************************/
+static double measureCase(int iCase, long lWidgets)
+{
+    Widget *widgets = generateWidgets(lWidgets);
+    char *pszText = NULL;
+    long lTextSize = 0, lOps = 0;
+    double dBest = 0.0;
+    int iRepeat;
+
+    if (iCase == 0)
+        pszText = traceText(widgets, lWidgets, &lTextSize);
+    for (iRepeat = 0; iRepeat < REGRESS_REPEATS; iRepeat++)
+    {
+        Simulation simulation;
+        SimulationResult result;
+        double dStart, dSeconds;
+        int rc;
+
+        if (createSimulation(&simulation, DEFAULT_SERVERS) != SIM_OK)
+            ErrExit(ERR_ALGORITHM, "Unable to create a simulation");
+        simulation->iParseThreads = 1;
+        simulation->iEngine = iCase == 2 ? ENG_AUTO : ENG_EVENT;
+        dStart = wallSeconds();
+        if (iCase == 0)
+        {
+            rc = loadTraceText(simulation, pszText, lTextSize);
+            lOps = simulation->lArrivalTotal;
+        }
+        else
+        {
+            rc = loadWidgets(simulation, widgets, lWidgets);
+            if (rc == SIM_OK)
+                rc = executeSimulation(simulation, NO_TIME_LIMIT, &result);
+            if (rc == SIM_OK)
+                lOps = 2 * result.lWidgetCount;
+        }
+        dSeconds = wallSeconds() - dStart;
+        if (rc != SIM_OK)
+            ErrExit(rc, "%s: %s", pszCaseNames[iCase], simulation->szError);
+        if (dSeconds > 0 && lOps / dSeconds > dBest)
+            dBest = lOps / dSeconds;
+        freeSimulation(simulation);
+    }
+    free(pszText);
+    free(widgets);
+    return dBest;
+}
+
+/****************************** runCase ***********************************
+ void runCase(int iCase, long lWidgets, BaselineRow *pRow)
+ Purpose:
+ Measures case iCase in a child process, filling in pRow with its
+ throughput and the child's peak RSS.
+ **************************************************************************/
+static void runCase(int iCase, long lWidgets, BaselineRow *pRow)
+{
+    struct rusage usage;
+    int iPipe[2], iStatus;
+    double dOpsPerSec;
+    pid_t pid;
+
+    fflush(stdout);
+    if (pipe(iPipe) != 0 || (pid = fork()) < 0)
+        ErrExit(ERR_ALGORITHM, "Unable to start the %s case", pszCaseNames[iCase]);
+    if (pid == 0)
+    {
+        close(iPipe[0]);
+        dOpsPerSec = measureCase(iCase, lWidgets);
+        if (write(iPipe[1], &dOpsPerSec, sizeof(dOpsPerSec)) != sizeof(dOpsPerSec))
+            _exit(ERR_ALGORITHM);
+        _exit(0);
+    }
+    close(iPipe[1]);
+    if (read(iPipe[0], &dOpsPerSec, sizeof(dOpsPerSec)) != sizeof(dOpsPerSec))
+        dOpsPerSec = -1;
+    close(iPipe[0]);
+    if (wait4(pid, &iStatus, 0, &usage) != pid || !WIFEXITED(iStatus)
+        || WEXITSTATUS(iStatus) != 0 || dOpsPerSec < 0)
+        ErrExit(ERR_ALGORITHM, "The %s case failed", pszCaseNames[iCase]);
+
+    strcpy(pRow->szCase, pszCaseNames[iCase]);
+    snprintf(pRow->szBuild, sizeof(pRow->szBuild), "%s"
+             , P4_BUILD_TYPE[0] == '\0' ? "default" : P4_BUILD_TYPE);
+    pRow->lWidgets = lWidgets;
+    pRow->dOpsPerSec = dOpsPerSec;
+    pRow->lPeakRssKb = usage.ru_maxrss;
+}
+
+// read the rows of the baseline file, returning their number (0 when
+// there is no file)
+static int readBaseline(char szPath[], BaselineRow rows[])
+{
+    FILE *pFile = fopen(szPath, "r");
+    char szLine[MAX_LINE_SIZE * 2];
+    int iRows = 0;
+
+    if (pFile == NULL)
+        return 0;
+    while (fgets(szLine, sizeof(szLine), pFile) != NULL && iRows < REGRESS_MAX_ROWS)
+    {
+        BaselineRow *pRow = &rows[iRows];
+        //the heading does not scan
+        if (sscanf(szLine, "%15[^,],%31[^,],%ld,%lf,%ld", pRow->szCase, pRow->szBuild
+                   , &pRow->lWidgets, &pRow->dOpsPerSec, &pRow->lPeakRssKb) == 5)
+            iRows++;
+    }
+    fclose(pFile);
+    return iRows;
+}
+
+static void writeBaseline(char szPath[], BaselineRow rows[], int iRows)
+{
+    FILE *pFile = fopen(szPath, "w");
+    int i;
+
+    if (pFile == NULL)
+        ErrExit(ERR_BAD_INPUT, "Unable to create '%s'", szPath);
+    fprintf(pFile, "case,build,widgets,ops_per_sec,peak_rss_kb\n");
+    for (i = 0; i < iRows; i++)
+        fprintf(pFile, "%s,%s,%ld,%.0f,%ld\n", rows[i].szCase, rows[i].szBuild
+                , rows[i].lWidgets, rows[i].dOpsPerSec, rows[i].lPeakRssKb);
+    if (fclose(pFile) != 0)
+        ErrExit(ERR_BAD_INPUT, "Unable to write '%s'", szPath);
+}
+
+// baseline row for the case, build and size of pRow, NULL - none
+static BaselineRow *findBaseline(BaselineRow rows[], int iRows, BaselineRow *pRow)
+{
+    int i;
+
+    for (i = 0; i < iRows; i++)
+        if (strcmp(rows[i].szCase, pRow->szCase) == 0
+            && strcmp(rows[i].szBuild, pRow->szBuild) == 0
+            && rows[i].lWidgets == pRow->lWidgets)
+            return &rows[i];
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    BaselineRow rows[REGRESS_MAX_ROWS + REGRESS_CASES];
+    BaselineRow measured;
+    char *pszBaseline = "perf_baseline.csv";
+    double dThreshold = 0.25;
+    long lWidgets = 1000000;
+    int bUpdate = FALSE, bRegressed = FALSE;
+    int iArg, iCase, iRows;
+
+    for (iArg = 1; iArg < argc; iArg++)
+    {
+        if (strcmp(argv[iArg], "-u") == 0)
+            bUpdate = TRUE;
+        else if (strcmp(argv[iArg], "-b") == 0 && iArg + 1 < argc)
+            pszBaseline = argv[++iArg];
+        else if (strcmp(argv[iArg], "-t") == 0 && iArg + 1 < argc)
+        {
+            if (sscanf(argv[++iArg], "%lf", &dThreshold) != 1
+                || dThreshold < 0 || dThreshold >= 1)
+                regressUsage();
+        }
+        else if (strcmp(argv[iArg], "-c") == 0 && iArg + 1 < argc)
+        {
+            if (sscanf(argv[++iArg], "%ld", &lWidgets) != 1 || lWidgets < 1)
+                regressUsage();
+        }
+        else
+            regressUsage();
+    }
+
+    iRows = readBaseline(pszBaseline, rows);
+    printf("case,build,widgets,ops_per_sec,peak_rss_kb,baseline_ops_per_sec,change,status\n");
+    for (iCase = 0; iCase < REGRESS_CASES; iCase++)
+    {
+        BaselineRow *pBaseline;
+
+        runCase(iCase, lWidgets, &measured);
+        pBaseline = findBaseline(rows, iRows, &measured);
+        printf("%s,%s,%ld,%.0f,%ld,", measured.szCase, measured.szBuild
+               , measured.lWidgets, measured.dOpsPerSec, measured.lPeakRssKb);
+        if (pBaseline == NULL)
+            printf(",,no baseline\n");
+        else
+        {
+            double dChange = measured.dOpsPerSec / pBaseline->dOpsPerSec - 1.0;
+            int bFailed = dChange < -dThreshold;
+            printf("%.0f,%+.1f%%,%s\n", pBaseline->dOpsPerSec, 100.0 * dChange
+                   , bFailed ? "REGRESSED" : "ok");
+            if (bFailed)
+                bRegressed = TRUE;
+        }
+
+        if (bUpdate == FALSE)
+            continue;
+        if (pBaseline != NULL)
+            *pBaseline = measured;
+        else if (iRows < REGRESS_MAX_ROWS)
+            rows[iRows++] = measured;
+    }
+
+    if (bUpdate)
+    {
+        writeBaseline(pszBaseline, rows, iRows);
+        printf("Baseline written to %s\n", pszBaseline);
+        return 0;
+    }
+    if (bRegressed)
+        printf("Throughput fell more than %.0f%% below the baseline\n", 100.0 * dThreshold);
+    return bRegressed ? 1 : 0;
+}
@@ -0,0 +1,410 @@
+/******************************************************************
+ cs2123p4_replicate.c by Justin Mungal
+
+ Machine Improvement Proposal - Replication Runner
+
+ Purpose:
+
+ This file contains the Monte Carlo replication mode (-r). Each
+ replication simulates a bootstrap resample of the input trace:
+ widgets (step times, arrival delta and server) are drawn with
+ replacement from the trace using a seeded generator, so every
+ replication is reproducible from (-R seed, replication number)
+ no matter which thread runs it.
+
+ Replications are spread over a pool of worker threads (runWorkPool,
+ also used by the parameter sweep). Each worker owns a deque of job
+ numbers; it takes work from the front of its own deque and, when
+ that is empty, steals the back half of another worker's deque.
+ Every replication builds its own Simulation with its own event
+ list, queues and servers, so the workers share nothing but the
+ read-only input trace.
+
+ The mean of each average printed by runSimulation is reported
+ with a 95% confidence interval across the replications.
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "cs2123p4.h"
+
+// job numbers [lNext, lEnd) not yet started by a worker
+typedef struct
+{
+    pthread_mutex_t lock;
+    long lNext;
+    long lEnd;
+} WorkDeque;
+
+typedef struct
+{
+    void (*runJob)(void *pContext, long lJob);
+    void *pContext;                 // passed to runJob
+    WorkDeque *deques;              // one per worker
+    int iWorkers;
+} WorkPool;
+
+typedef struct
+{
+    WorkPool *pool;
+    int iWorker;
+} PoolWorker;
+
+typedef struct
+{
+    Simulation base;                // the input trace and the switches
+    int iTimeLimit;
+    SimulationResult *results;      // one per replication
+    double *dAvgQueueTimes;         // their per-server averages, iServerCount
+                                    //   per replication
+    int bHistograms;                // TRUE - merge the histograms (-H or -J)
+    pthread_mutex_t histogramLock;  // guards waitHists and systemHist
+    Histogram *waitHists;           // each server's waits over all replications
+    Histogram systemHist;           // times in system over all replications
+} ReplicationContext;
+
+// 95% two-sided Student t quantiles for 1 to 30 degrees of freedom
+static const double dTQuantile95[] =
+{
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+/*************************** runReplication *******************************
+ void runReplication(void *pContext, long lReplication)
+ Purpose:
+ Builds the resampled trace for one replication, simulates it and stores
+ its statistics in the ReplicationContext's results.
+ **************************************************************************/
+static void runReplication(void *pContext, long lReplication)
+{
+    ReplicationContext *pReplications = (ReplicationContext *)pContext;
+    Simulation base = pReplications->base;
+    Simulation simulation = newSimulation();
+    unsigned long long ullState = base->ullSeed
+                                + (unsigned long long)lReplication * 0x9e3779b97f4a7c15ULL;
+    long lCount = base->lArrivalTotal;
+    int iClock = 0;
+    long i;
+
+    setEventListKind(simulation->eventList, base->eventList->iKind);
+    simulation->iEngine = base->iEngine;
+    simulation->eventList->nodePool.bPooled = base->eventList->nodePool.bPooled;
+    simulation->bStreaming = TRUE;
+    setServerCount(simulation, base->iServerCount);
+
+    simulation->arrivalWidgets = (Widget *)malloc((lCount + 1) * sizeof(Widget));
+    if (simulation->arrivalWidgets == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for %ld widgets", lCount);
+    for (i = 0; i < lCount; i++)
+    {
+        long j = (long)(nextRandom(&ullState) % (unsigned long long)lCount);
+        int iNextArrival = j + 1 < lCount ? base->arrivalWidgets[j + 1].iArrivalTime
+                                          : base->iArrivalEndClock;
+        simulation->arrivalWidgets[i] = base->arrivalWidgets[j];
+        simulation->arrivalWidgets[i].lWidgetNr = i + 1;
+        simulation->arrivalWidgets[i].iArrivalTime = iClock;
+        iClock += iNextArrival - base->arrivalWidgets[j].iArrivalTime;
+    }
+    simulation->lArrivalTotal = lCount;
+    simulation->iArrivalEndClock = iClock;
+    readArrivalGroup(simulation);
+
+    simulate(simulation, pReplications->iTimeLimit
+             , &pReplications->results[lReplication]);
+    
+    // keep the per-server averages, which are freed with the simulation
+    {
+        SimulationResult *pResult = &pReplications->results[lReplication];
+        double *dAverages = pReplications->dAvgQueueTimes
+                          + lReplication * base->iServerCount;
+        memcpy(dAverages, pResult->dAvgQueueTimes
+               , base->iServerCount * sizeof(double));
+        pResult->dAvgQueueTimes = dAverages;
+    }
+    
+    if (pReplications->bHistograms)
+    {
+        pthread_mutex_lock(&pReplications->histogramLock);
+        for (i = 0; i < simulation->iServerCount; i++)
+            mergeHistogram(&pReplications->waitHists[i]
+                           , &simulation->queues[i]->waitHist);
+        mergeHistogram(&pReplications->systemHist, &simulation->systemHist);
+        pthread_mutex_unlock(&pReplications->histogramLock);
+    }
+    freeSimulation(simulation);
+}
+
+// take the next job from the front of a worker's own deque
+static int takeJob(WorkDeque *pDeque, long *plJob)
+{
+    int bFound = FALSE;
+    pthread_mutex_lock(&pDeque->lock);
+    if (pDeque->lNext < pDeque->lEnd)
+    {
+        *plJob = pDeque->lNext++;
+        bFound = TRUE;
+    }
+    pthread_mutex_unlock(&pDeque->lock);
+    return bFound;
+}
+
+// move the back half of a victim's deque into the thief's deque
+static int stealJobs(WorkDeque *pVictim, WorkDeque *pThief)
+{
+    long lFirst, lEnd;
+
+    pthread_mutex_lock(&pVictim->lock);
+    lEnd = pVictim->lEnd;
+    lFirst = pVictim->lNext + (pVictim->lEnd - pVictim->lNext) / 2;
+    pVictim->lEnd = lFirst;
+    pthread_mutex_unlock(&pVictim->lock);
+    if (lFirst >= lEnd)
+        return FALSE;
+
+    pthread_mutex_lock(&pThief->lock);
+    pThief->lNext = lFirst;
+    pThief->lEnd = lEnd;
+    pthread_mutex_unlock(&pThief->lock);
+    return TRUE;
+}
+
+static void *poolWorker(void *pArg)
+{
+    PoolWorker *pWorker = (PoolWorker *)pArg;
+    WorkPool *pool = pWorker->pool;
+    WorkDeque *pOwn = &pool->deques[pWorker->iWorker];
+    long lJob;
+    int i;
+
+    for (;;)
+    {
+        while (takeJob(pOwn, &lJob))
+            pool->runJob(pool->pContext, lJob);
+
+        // out of work: try every other worker once, starting with the next
+        for (i = 1; i < pool->iWorkers; i++)
+            if (stealJobs(&pool->deques[(pWorker->iWorker + i) % pool->iWorkers]
+                                  , pOwn))
+                break;
+        if (i >= pool->iWorkers)
+            return NULL;
+    }
+}
+
+/************************** printConfidence *******************************
+ void printConfidence(char szLabel[], double dValues[], int iCount)
+ Purpose:
+ Prints the mean and 95% confidence half-width of one statistic, given
+ its value in each of the iCount replications. Replications where the
+ statistic is undefined (NaN: no widget went to that server) are left
+ out, and a statistic undefined in all of them prints "no widgets".
+ **************************************************************************/
+static void printConfidence(char szLabel[], double dValues[], int iCount)
+{
+    double dSum = 0.0, dSumSquares = 0.0, dMean, dHalfWidth = 0.0;
+    int iValid = 0, i;
+
+    for (i = 0; i < iCount; i++)
+    {
+        if (isnan(dValues[i]))
+            continue;
+        dSum += dValues[i];
+        iValid++;
+    }
+    if (iValid == 0)
+    {
+        printf("%s: no widgets\n", szLabel);
+        return;
+    }
+    dMean = dSum / iValid;
+    for (i = 0; i < iCount; i++)
+    {
+        if (!isnan(dValues[i]))
+            dSumSquares += (dValues[i] - dMean) * (dValues[i] - dMean);
+    }
+    if (iValid > 1)
+    {
+        double dT = iValid - 1 <= 30 ? dTQuantile95[iValid - 2] : 1.960;
+        dHalfWidth = dT * sqrt(dSumSquares / (iValid - 1) / iValid);
+    }
+    printf("%s: %.1f +/- %.2f\n", szLabel, dMean, dHalfWidth);
+}
+
+/**************************** runWorkPool *********************************
+ int runWorkPool(long lJobs, int iThreads
+                 , void (*runJob)(void *pContext, long lJob), void *pContext)
+ Purpose:
+ Calls runJob(pContext, lJob) for every lJob from 0 to lJobs - 1 across a
+ work-stealing pool of threads and waits for all of them to finish.
+ Parameters:
+ I  long lJobs                      Number of jobs
+ I  int iThreads                    Worker threads, 0 - one per CPU
+ I  void (*runJob)(...)             Runs one job; must be thread safe
+ I  void *pContext                  Passed to runJob
+ Returns:
+ The number of worker threads used.
+ **************************************************************************/
+int runWorkPool(long lJobs, int iThreads
+                , void (*runJob)(void *pContext, long lJob), void *pContext)
+{
+    WorkPool pool;
+    PoolWorker workers[MAX_WORKER_THREADS];
+    pthread_t threads[MAX_WORKER_THREADS];
+    long lPerWorker;
+    int i;
+
+    pool.runJob = runJob;
+    pool.pContext = pContext;
+    pool.iWorkers = iThreads;
+    if (pool.iWorkers <= 0)
+        pool.iWorkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (pool.iWorkers > MAX_WORKER_THREADS)
+        pool.iWorkers = MAX_WORKER_THREADS;
+    if (pool.iWorkers > lJobs)
+        pool.iWorkers = (int)lJobs;
+    if (pool.iWorkers < 1)
+        pool.iWorkers = 1;
+
+    pool.deques = (WorkDeque *)malloc(pool.iWorkers * sizeof(WorkDeque));
+    if (pool.deques == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the work pool");
+
+    // deal the jobs out in contiguous blocks
+    lPerWorker = (lJobs + pool.iWorkers - 1) / pool.iWorkers;
+    for (i = 0; i < pool.iWorkers; i++)
+    {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+        pool.deques[i].lNext = i * lPerWorker;
+        pool.deques[i].lEnd = (i + 1) * lPerWorker;
+        if (pool.deques[i].lEnd > lJobs)
+            pool.deques[i].lEnd = lJobs;
+        workers[i].pool = &pool;
+        workers[i].iWorker = i;
+    }
+
+    for (i = 1; i < pool.iWorkers; i++)
+        if (pthread_create(&threads[i], NULL, poolWorker, &workers[i]) != 0)
+            ErrExit(ERR_ALGORITHM, "Unable to create worker thread");
+    poolWorker(&workers[0]);
+    for (i = 1; i < pool.iWorkers; i++)
+        pthread_join(threads[i], NULL);
+
+    for (i = 0; i < pool.iWorkers; i++)
+        pthread_mutex_destroy(&pool.deques[i].lock);
+    free(pool.deques);
+    return pool.iWorkers;
+}
+
+/************************** runReplications *******************************
+ void runReplications(Simulation simulation, int iTimeLimit)
+ Purpose:
+ Runs simulation->iReplications resampled replications of the input
+ trace across a pool of worker threads and prints the mean and 95%
+ confidence interval of the averages. With -H or -J the histograms of all
+ the replications are merged and reported together.
+ Parameters:
+ I  Simulation simulation           The simulation holding the parsed
+                                    input (arrivalWidgets) and switches.
+ I  int iTimeLimit                  Passed on to simulate.
+ Notes:
+ The simulation is freed.
+ **************************************************************************/
+void runReplications(Simulation simulation, int iTimeLimit)
+{
+    ReplicationContext replications;
+    double *dValues;                // one statistic of each replication
+    char szLabel[48];
+    int iWorkers, i, r;
+
+    if (simulation->arrivalWidgets == NULL || simulation->lArrivalTotal == 0)
+        ErrExit(ERR_BAD_INPUT, "Replications need a non-empty input file");
+
+    replications.base = simulation;
+    replications.iTimeLimit = iTimeLimit;
+    replications.results = (SimulationResult *)malloc(simulation->iReplications
+                                                      * sizeof(SimulationResult));
+    replications.dAvgQueueTimes = (double *)malloc((size_t)simulation->iReplications
+                                                   * simulation->iServerCount
+                                                   * sizeof(double));
+    dValues = (double *)malloc(simulation->iReplications * sizeof(double));
+    if (replications.results == NULL || replications.dAvgQueueTimes == NULL
+        || dValues == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for replications");
+    replications.bHistograms = simulation->bPercentiles
+                               || simulation->pszHistogramFile != NULL;
+    pthread_mutex_init(&replications.histogramLock, NULL);
+    replications.waitHists = (Histogram *)malloc(simulation->iServerCount
+                                                 * sizeof(Histogram));
+    if (replications.waitHists == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for replications");
+    for (i = 0; i < simulation->iServerCount; i++)
+        initHistogram(&replications.waitHists[i]);
+    initHistogram(&replications.systemHist);
+
+    iWorkers = runWorkPool(simulation->iReplications, simulation->iWorkerThreads
+                           , runReplication, &replications);
+
+    printf("Replications: %d of %ld widgets (seed %llu, %d threads)\n\n"
+           , simulation->iReplications, simulation->lArrivalTotal
+           , simulation->ullSeed, iWorkers);
+    for (i = 0; i < simulation->iServerCount; i++)
+    {
+        for (r = 0; r < simulation->iReplications; r++)
+            dValues[r] = replications.results[r].dAvgQueueTimes[i];
+        sprintf(szLabel, "Average Queue Time for Server %s"
+                , simulation->servers[i]->szTag);
+        printConfidence(szLabel, dValues, simulation->iReplications);
+    }
+    if (simulation->iServerCount > 2)
+    {
+        for (r = 0; r < simulation->iReplications; r++)
+            dValues[r] = replications.results[r].dAvgQueueTime;
+        printConfidence("Average Queue Time for All Servers", dValues
+                        , simulation->iReplications);
+    }
+    for (r = 0; r < simulation->iReplications; r++)
+        dValues[r] = replications.results[r].dAvgSystemTime;
+    printConfidence("Average time in System", dValues, simulation->iReplications);
+    printf("(mean +/- 95%% confidence half-width)\n\n");
+    
+    if (simulation->bPercentiles)
+    {
+        for (i = 0; i < simulation->iServerCount; i++)
+        {
+            sprintf(szLabel, "Queue Time Percentiles for Server %s"
+                    , simulation->servers[i]->szTag);
+            printPercentiles(szLabel, &replications.waitHists[i]);
+        }
+        printPercentiles("Time in System Percentiles", &replications.systemHist);
+        printf("(all replications)\n\n");
+    }
+    if (simulation->pszHistogramFile != NULL)
+    {
+        Histogram **waitHists = (Histogram **)malloc(simulation->iServerCount
+                                                     * sizeof(Histogram *));
+        if (waitHists == NULL)
+            ErrExit(ERR_ALGORITHM, "No available memory for the histograms");
+        for (i = 0; i < simulation->iServerCount; i++)
+            waitHists[i] = &replications.waitHists[i];
+        writeHistogramJson(simulation->pszHistogramFile, simulation->iServerCount
+                           , waitHists, &replications.systemHist);
+        free(waitHists);
+    }
+
+    pthread_mutex_destroy(&replications.histogramLock);
+    free(replications.waitHists);
+    free(replications.dAvgQueueTimes);
+    free(replications.results);
+    free(dValues);
+    freeSimulation(simulation);
+}
@@ -0,0 +1,179 @@
+/******************************************************************
+ cs2123p4_results.c by Justin Mungal
+
+ Machine Improvement Proposal - Per-Widget Results
+
+ Purpose:
+
+ This file contains the result sink used by -W. leaveSystem hands it
+ one WidgetResult per widget: its number, arrival, queue enter, service
+ start and completion times, its server, its wait and its time in the
+ system. The rows are written in the order the widgets leave.
+
+ The file is binary and column ordered (see ResultHeader): the rows
+ are gathered into a block of RESULT_BLOCK_ROWS, one array per column,
+ and each full block is written with one fwrite per column. Reading a
+ column back is then a single read of contiguous integers, and writing
+ costs about a copy of each value. When the file name ends in .csv,
+ the rows are written as CSV text instead, formatted like p4trace
+ formats a binary results file.
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include "cs2123p4.h"
+
+#define RESULT_FILE_BUFFER  (1 << 20)   // stdio buffer for the results file
+
+struct ResultSinkImp
+{
+    FILE *pFile;
+    int bCsv;                       // TRUE - CSV rows, FALSE - column blocks
+    long lRows;                     // rows in the current block
+    long long lWritten;             // rows written before the current block
+    long *lWidgetNr;                // the current block, one array per column
+    int *iColumns[RESULT_INT_COLUMNS];
+};
+
+// write the current block's row count and columns, and empty it
+static void flushResultBlock(ResultSink sink)
+{
+    long long lRows = sink->lRows;
+    int iColumn, bError;
+
+    if (lRows == 0)
+        return;
+    bError = fwrite(&lRows, sizeof(lRows), 1, sink->pFile) != 1
+             || fwrite(sink->lWidgetNr, sizeof(long), lRows, sink->pFile) != (size_t)lRows;
+    for (iColumn = 0; iColumn < RESULT_INT_COLUMNS; iColumn++)
+        if (fwrite(sink->iColumns[iColumn], sizeof(int), lRows, sink->pFile) != (size_t)lRows)
+            bError = TRUE;
+    if (bError)
+        ErrExit(ERR_BAD_INPUT, "Unable to write the widget results file");
+    sink->lWritten += lRows;
+    sink->lRows = 0;
+}
+
+/**************************** newResultSink *******************************
+ ResultSink newResultSink(char szPath[])
+ Purpose:
+ Creates the results file szPath, as CSV when its name ends in .csv.
+ **************************************************************************/
+ResultSink newResultSink(char szPath[])
+{
+    ResultSink sink = (ResultSink)malloc(sizeof(struct ResultSinkImp));
+    size_t iLength = strlen(szPath);
+    int iColumn;
+
+    if (sink == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the widget results");
+    sink->bCsv = iLength >= 4 && strcmp(szPath + iLength - 4, ".csv") == 0;
+    sink->lRows = 0;
+    sink->lWritten = 0;
+    sink->lWidgetNr = NULL;
+    for (iColumn = 0; iColumn < RESULT_INT_COLUMNS; iColumn++)
+        sink->iColumns[iColumn] = NULL;
+
+    sink->pFile = fopen(szPath, sink->bCsv ? "w" : "wb");
+    if (sink->pFile == NULL)
+        ErrExit(ERR_BAD_INPUT, "Unable to create widget results file '%s'", szPath);
+    setvbuf(sink->pFile, NULL, _IOFBF, RESULT_FILE_BUFFER);
+    if (sink->bCsv)
+    {
+        fprintf(sink->pFile, "widget,arrival,enter_queue,start,complete,server,wait,system\n");
+        return sink;
+    }
+
+    sink->lWidgetNr = (long *)malloc(RESULT_BLOCK_ROWS * sizeof(long));
+    if (sink->lWidgetNr == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the widget results");
+    for (iColumn = 0; iColumn < RESULT_INT_COLUMNS; iColumn++)
+    {
+        sink->iColumns[iColumn] = (int *)malloc(RESULT_BLOCK_ROWS * sizeof(int));
+        if (sink->iColumns[iColumn] == NULL)
+            ErrExit(ERR_ALGORITHM, "No available memory for the widget results");
+    }
+    {
+        ResultHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.szMagic, RESULT_MAGIC, sizeof(header.szMagic));
+        header.iVersion = RESULT_VERSION;
+        header.iBlockRows = RESULT_BLOCK_ROWS;
+        header.lWidgetCount = -1;
+        if (fwrite(&header, sizeof(header), 1, sink->pFile) != 1)
+            ErrExit(ERR_BAD_INPUT, "Unable to write widget results file '%s'", szPath);
+    }
+    return sink;
+}
+
+/*************************** putWidgetResult ******************************
+ void putWidgetResult(ResultSink sink, WidgetResult *pResult)
+ Purpose:
+ Adds the row of a widget that left the system.
+ **************************************************************************/
+void putWidgetResult(ResultSink sink, WidgetResult *pResult)
+{
+    long lRow = sink->lRows;
+
+    if (sink->bCsv)
+    {
+        printWidgetResult(sink->pFile, pResult);
+        sink->lWritten++;
+        return;
+    }
+    sink->lWidgetNr[lRow] = pResult->lWidgetNr;
+    sink->iColumns[0][lRow] = pResult->iArrivalTime;
+    sink->iColumns[1][lRow] = pResult->iEnterQTime;
+    sink->iColumns[2][lRow] = pResult->iStartTime;
+    sink->iColumns[3][lRow] = pResult->iCompleteTime;
+    sink->iColumns[4][lRow] = pResult->iServer;
+    sink->iColumns[5][lRow] = pResult->iWait;
+    sink->iColumns[6][lRow] = pResult->iSystemTime;
+    if (++sink->lRows == RESULT_BLOCK_ROWS)
+        flushResultBlock(sink);
+}
+
+/*************************** closeResultSink ******************************
+ void closeResultSink(ResultSink sink)
+ Purpose:
+ Writes the last block, fills in the header's row count, then closes
+ the results file and frees the sink.
+ Notes:
+ The row count stays -1 when the file cannot be repositioned (a pipe);
+ readers then take the blocks up to the end of the file.
+ **************************************************************************/
+void closeResultSink(ResultSink sink)
+{
+    int iColumn, bError;
+
+    if (sink->bCsv == FALSE)
+    {
+        flushResultBlock(sink);
+        if (fseek(sink->pFile, offsetof(ResultHeader, lWidgetCount), SEEK_SET) == 0)
+            fwrite(&sink->lWritten, sizeof(sink->lWritten), 1, sink->pFile);
+        else
+            clearerr(sink->pFile);
+    }
+    bError = ferror(sink->pFile);
+    if (fclose(sink->pFile) != 0 || bError)
+        ErrExit(ERR_BAD_INPUT, "Unable to write the widget results file");
+    free(sink->lWidgetNr);
+    for (iColumn = 0; iColumn < RESULT_INT_COLUMNS; iColumn++)
+        free(sink->iColumns[iColumn]);
+    free(sink);
+}
+
+// print a result as its CSV row
+void printWidgetResult(FILE *pFile, WidgetResult *pResult)
+{
+    fprintf(pFile, "%ld,%d,%d,%d,%d,%d,%d,%d\n", pResult->lWidgetNr
+            , pResult->iArrivalTime, pResult->iEnterQTime, pResult->iStartTime
+            , pResult->iCompleteTime, pResult->iServer, pResult->iWait
+            , pResult->iSystemTime);
+}
@@ -0,0 +1,345 @@
+/******************************************************************
+ cs2123p4_snapshot.c by Justin Mungal
+
+ Machine Improvement Proposal - Simulation Snapshots
+
+ Purpose:
+
+ This file contains the checkpoint (-c) and resume (-x) of a single
+ simulation. A snapshot is a SnapshotHeader followed by
+
+     the widget table:  each column, uWidgetRows rows long, free
+                        rows included (they hold the free id list)
+     for each server:   bBusy, the id of the widget being served, the
+                        queue's wait statistics and histogram, the
+                        number of widgets waiting and their QElements
+                        (enter times included) in queue order
+     the time in system histogram
+     the streaming look-ahead arrivals
+     the pending events in the order they will be processed
+
+ The input itself is not copied. A streaming run records how many
+ widgets it has read, and the resumed run reopens the same input
+ (-i) and skips that many, so the resumed run must be given the same
+ input file. A run that loaded its arrivals up front has all of them
+ in the pending events and needs no input.
+
+ A resumed run processes exactly the events the original run would
+ have, in the same order, so stopping at a time limit and resuming
+ gives the same statistics as one uninterrupted run.
+
+ Snapshots use the byte order and structure layout of the machine
+ that wrote them.
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include "cs2123p4.h"
+
+static void writeItems(FILE *pFile, const void *pItems, size_t iSize, long lCount)
+{
+    if (lCount > 0 && fwrite(pItems, iSize, lCount, pFile) != (size_t)lCount)
+        ErrExit(ERR_BAD_INPUT, "Unable to write the snapshot");
+}
+
+static void readItems(FILE *pFile, void *pItems, size_t iSize, long lCount
+                      , char szPath[])
+{
+    if (lCount > 0 && fread(pItems, iSize, lCount, pFile) != (size_t)lCount)
+        ErrExit(ERR_BAD_INPUT, "Truncated snapshot '%s'", szPath);
+}
+
+static void *allocItems(size_t iSize, long lCount)
+{
+    void *pItems = malloc(lCount > 0 ? iSize * lCount : 1);
+    if (pItems == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the snapshot");
+    return pItems;
+}
+
+static void writeWidgetTable(FILE *pFile, WidgetTable *pTable)
+{
+    writeItems(pFile, pTable->lWidgetNr, sizeof(long), pTable->uRows);
+    writeItems(pFile, pTable->iStep1tu, sizeof(int), pTable->uRows);
+    writeItems(pFile, pTable->iStep2tu, sizeof(int), pTable->uRows);
+    writeItems(pFile, pTable->iArrivalTime, sizeof(int), pTable->uRows);
+    writeItems(pFile, pTable->iWhichServer, sizeof(int), pTable->uRows);
+}
+
+// a widget id read from a snapshot must be a row of the widget table and,
+// for iServerNr other than 0, a widget routed to that server
+static void checkWidgetId(Simulation simulation, unsigned uWidgetId, int iServerNr
+                          , char szPath[])
+{
+    if (uWidgetId >= simulation->widgets.uRows
+        || (iServerNr != 0 && simulation->widgets.iWhichServer[uWidgetId] != iServerNr))
+        ErrExit(ERR_BAD_INPUT, "Corrupt snapshot '%s'", szPath);
+}
+
+// an arrival read from a snapshot must be of a widget; a completion must
+// be of the widget its server is serving
+static void checkEvent(Simulation simulation, const Event *pEvent, char szPath[])
+{
+    int iServer;
+
+    checkWidgetId(simulation, pEvent->uWidgetId, 0, szPath);
+    if (pEvent->iEventType == EVT_ARRIVAL)
+        return;
+    iServer = simulation->widgets.iWhichServer[pEvent->uWidgetId] - 1;
+    if (pEvent->iEventType != EVT_SERVER_COMPLETE
+        || iServer < 0 || iServer >= simulation->iServerCount
+        || simulation->servers[iServer]->bBusy != TRUE
+        || simulation->servers[iServer]->uWidgetId != pEvent->uWidgetId)
+        ErrExit(ERR_BAD_INPUT, "Corrupt snapshot '%s'", szPath);
+}
+
+static void readWidgetTable(FILE *pFile, WidgetTable *pTable, unsigned uRows
+                            , unsigned uFree, char szPath[])
+{
+    unsigned uId, uFreeCount = 0;
+
+    reserveWidgetTable(pTable, uRows);
+    readItems(pFile, pTable->lWidgetNr, sizeof(long), uRows, szPath);
+    readItems(pFile, pTable->iStep1tu, sizeof(int), uRows, szPath);
+    readItems(pFile, pTable->iStep2tu, sizeof(int), uRows, szPath);
+    readItems(pFile, pTable->iArrivalTime, sizeof(int), uRows, szPath);
+    readItems(pFile, pTable->iWhichServer, sizeof(int), uRows, szPath);
+
+    // the free list is linked through iStep1tu; it must stay in the
+    // table and end (no more links than rows)
+    for (uId = uFree; uId != NO_WIDGET_ID; uId = (unsigned)pTable->iStep1tu[uId])
+        if (uId >= uRows || ++uFreeCount > uRows)
+            ErrExit(ERR_BAD_INPUT, "Corrupt snapshot '%s'", szPath);
+    pTable->uRows = uRows;
+    pTable->uFree = uFree;
+}
+
+/**************************** writeSnapshot *******************************
+ void writeSnapshot(Simulation simulation, char szPath[])
+ Purpose:
+ Writes the state of the simulation to szPath.
+ Parameters:
+ I  Simulation simulation               The simulation structure
+ I  char szPath[]                       The snapshot file
+ Notes:
+ The snapshot is written to szPath.tmp and renamed, so an interrupted
+ checkpoint leaves the previous snapshot intact.
+ The event list and queues are emptied to be written and then refilled;
+ events with the same time are refilled last first, because the event
+ list places a new event ahead of the ones with its time.
+ **************************************************************************/
+void writeSnapshot(Simulation simulation, char szPath[])
+{
+    SnapshotHeader header;
+    char *pszTemp = (char *)allocItems(1, strlen(szPath) + 5);
+    FILE *pFile;
+    Event *events;
+    long lCount, lCapacity = 64, i;
+    int iServer;
+
+    sprintf(pszTemp, "%s.tmp", szPath);
+    pFile = fopen(pszTemp, "wb");
+    if (pFile == NULL)
+        ErrExit(ERR_BAD_INPUT, "Unable to create snapshot '%s'", pszTemp);
+
+    // take the pending events out in processing order
+    events = (Event *)allocItems(sizeof(Event), lCapacity);
+    for (lCount = 0; removeLL(simulation->eventList, &events[lCount]); )
+        if (++lCount == lCapacity)
+        {
+            lCapacity *= 2;
+            events = (Event *)realloc(events, lCapacity * sizeof(Event));
+            if (events == NULL)
+                ErrExit(ERR_ALGORITHM, "No available memory for the snapshot");
+        }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.szMagic, SNAPSHOT_MAGIC, sizeof(header.szMagic));
+    header.iVersion = SNAPSHOT_VERSION;
+    header.iEventSize = (int)sizeof(Event);
+    header.iElementSize = (int)sizeof(QElement);
+    header.iServerCount = simulation->iServerCount;
+    header.bStreaming = simulation->bStreaming;
+    header.iClock = simulation->iClock;
+    header.iArrivalClock = simulation->iArrivalClock;
+    header.bInputDone = simulation->bInputDone;
+    header.iArrivalGroupCount = simulation->bStreaming ? simulation->iArrivalGroupCount : 0;
+    header.lSystemTimeSum = simulation->lSystemTimeSum;
+    header.lWidgetCount = simulation->lWidgetCount;
+    header.lArrivalsRead = simulation->lArrivalNext;
+    header.lEventCount = lCount;
+    header.uWidgetRows = simulation->widgets.uRows;
+    header.uWidgetFree = simulation->widgets.uFree;
+    writeItems(pFile, &header, sizeof(header), 1);
+    writeWidgetTable(pFile, &simulation->widgets);
+
+    for (iServer = 0; iServer < simulation->iServerCount; iServer++)
+    {
+        Server server = simulation->servers[iServer];
+        Queue queue = simulation->queues[iServer];
+        QElement *elements;
+        long lWaiting = 0, lElementCapacity = 16;
+
+        elements = (QElement *)allocItems(sizeof(QElement), lElementCapacity);
+        while (removeQ(queue, &elements[lWaiting]))
+            if (++lWaiting == lElementCapacity)
+            {
+                lElementCapacity *= 2;
+                elements = (QElement *)realloc(elements
+                                               , lElementCapacity * sizeof(QElement));
+                if (elements == NULL)
+                    ErrExit(ERR_ALGORITHM, "No available memory for the snapshot");
+            }
+        writeItems(pFile, &server->bBusy, sizeof(server->bBusy), 1);
+        writeItems(pFile, &server->uWidgetId, sizeof(unsigned), 1);
+        writeItems(pFile, &queue->lQueueWaitSum, sizeof(long), 1);
+        writeItems(pFile, &queue->lQueueWidgetTotalCount, sizeof(long), 1);
+        writeItems(pFile, &queue->waitHist, sizeof(Histogram), 1);
+        writeItems(pFile, &lWaiting, sizeof(long), 1);
+        writeItems(pFile, elements, sizeof(QElement), lWaiting);
+        for (i = 0; i < lWaiting; i++)
+            insertQ(queue, elements[i]);
+        free(elements);
+    }
+    writeItems(pFile, &simulation->systemHist, sizeof(Histogram), 1);
+    writeItems(pFile, simulation->arrivalGroup, sizeof(Event), header.iArrivalGroupCount);
+    writeItems(pFile, events, sizeof(Event), lCount);
+
+    for (i = lCount - 1; i >= 0; i--)
+        insertOrderedLL(simulation->eventList, events[i]);
+    free(events);
+
+    if (fclose(pFile) != 0)
+        ErrExit(ERR_BAD_INPUT, "Unable to write snapshot '%s'", pszTemp);
+    if (rename(pszTemp, szPath) != 0)
+        ErrExit(ERR_BAD_INPUT, "Unable to replace snapshot '%s'", szPath);
+    free(pszTemp);
+}
+
+/***************************** readSnapshot *******************************
+ void readSnapshot(Simulation simulation, char szPath[])
+ Purpose:
+ Restores the state written by writeSnapshot into a new simulation, in
+ place of generateArrival.
+ Parameters:
+ I  Simulation simulation               The simulation structure, with the
+                                        switches processed
+ I  char szPath[]                       The snapshot file
+ Notes:
+ The number of servers and streaming mode come from the snapshot. The
+ event list kind and allocator are those of the resumed run.
+ A snapshot whose counts, widget ids or events do not fit its widget
+ table and servers is rejected as corrupt.
+ **************************************************************************/
+void readSnapshot(Simulation simulation, char szPath[])
+{
+    SnapshotHeader header;
+    FILE *pFile = fopen(szPath, "rb");
+    Event *events;
+    long i;
+    int iServer;
+
+    if (pFile == NULL)
+        ErrExit(ERR_BAD_INPUT, "Unable to open snapshot '%s'", szPath);
+    if (fread(&header, sizeof(header), 1, pFile) != 1
+        || memcmp(header.szMagic, SNAPSHOT_MAGIC, sizeof(header.szMagic)) != 0)
+        ErrExit(ERR_BAD_INPUT, "'%s' is not a snapshot", szPath);
+    if (header.iVersion != SNAPSHOT_VERSION || header.iEventSize != (int)sizeof(Event)
+        || header.iElementSize != (int)sizeof(QElement))
+        ErrExit(ERR_BAD_INPUT, "Unsupported snapshot version %d in '%s'"
+                , header.iVersion, szPath);
+    // each widget has at most one pending event, look-ahead arrivals included
+    if (header.iServerCount < 1 || header.iServerCount > MAX_SERVERS
+        || header.iArrivalGroupCount < 0
+        || (unsigned long)header.iArrivalGroupCount > header.uWidgetRows
+        || header.lEventCount < 0
+        || (unsigned long long)header.lEventCount > header.uWidgetRows)
+        ErrExit(ERR_BAD_INPUT, "Corrupt snapshot '%s'", szPath);
+
+    setServerCount(simulation, header.iServerCount);
+    simulation->bStreaming = header.bStreaming;
+    simulation->iClock = header.iClock;
+    simulation->lSystemTimeSum = (long)header.lSystemTimeSum;
+    simulation->lWidgetCount = (long)header.lWidgetCount;
+    readWidgetTable(pFile, &simulation->widgets, header.uWidgetRows
+                    , header.uWidgetFree, szPath);
+
+    for (iServer = 0; iServer < header.iServerCount; iServer++)
+    {
+        Server server = simulation->servers[iServer];
+        Queue queue = simulation->queues[iServer];
+        QElement element;
+        long lWaiting;
+
+#ifndef QUEUE_RING
+        queue->nodePool.bPooled = simulation->eventList->nodePool.bPooled;
+#endif
+        readItems(pFile, &server->bBusy, sizeof(server->bBusy), 1, szPath);
+        readItems(pFile, &server->uWidgetId, sizeof(unsigned), 1, szPath);
+        readItems(pFile, &queue->lQueueWaitSum, sizeof(long), 1, szPath);
+        readItems(pFile, &queue->lQueueWidgetTotalCount, sizeof(long), 1, szPath);
+        readItems(pFile, &queue->waitHist, sizeof(Histogram), 1, szPath);
+        readItems(pFile, &lWaiting, sizeof(long), 1, szPath);
+        if ((server->bBusy != TRUE && server->bBusy != FALSE)
+            || lWaiting < 0 || (unsigned long)lWaiting > header.uWidgetRows)
+            ErrExit(ERR_BAD_INPUT, "Corrupt snapshot '%s'", szPath);
+        if (server->bBusy == TRUE)
+            checkWidgetId(simulation, server->uWidgetId, iServer + 1, szPath);
+        for (i = 0; i < lWaiting; i++)
+        {
+            readItems(pFile, &element, sizeof(QElement), 1, szPath);
+            checkWidgetId(simulation, element.uWidgetId, iServer + 1, szPath);
+            insertQ(queue, element);
+        }
+    }
+    readItems(pFile, &simulation->systemHist, sizeof(Histogram), 1, szPath);
+
+    simulation->arrivalGroup = (Event *)allocItems(sizeof(Event)
+                                                   , header.iArrivalGroupCount);
+    simulation->iArrivalGroupCapacity = header.iArrivalGroupCount;
+    simulation->iArrivalGroupCount = header.iArrivalGroupCount;
+    readItems(pFile, simulation->arrivalGroup, sizeof(Event)
+              , header.iArrivalGroupCount, szPath);
+    for (i = 0; i < header.iArrivalGroupCount; i++)
+        if (simulation->arrivalGroup[i].iEventType != EVT_ARRIVAL)
+            ErrExit(ERR_BAD_INPUT, "Corrupt snapshot '%s'", szPath);
+        else
+            checkEvent(simulation, &simulation->arrivalGroup[i], szPath);
+
+    events = (Event *)allocItems(sizeof(Event), (long)header.lEventCount);
+    readItems(pFile, events, sizeof(Event), (long)header.lEventCount, szPath);
+    for (i = 0; i < (long)header.lEventCount; i++)
+        checkEvent(simulation, &events[i], szPath);
+    for (i = (long)header.lEventCount - 1; i >= 0; i--)
+        insertOrderedLL(simulation->eventList, events[i]);
+    free(events);
+    fclose(pFile);
+
+    // a streaming run continues reading its input where it left off
+    if (header.bStreaming && !header.bInputDone)
+    {
+        openArrivals(simulation);
+        if (simulation->arrivalWidgets != NULL)
+        {
+            if (header.lArrivalsRead > simulation->lArrivalTotal)
+                ErrExit(ERR_BAD_INPUT, "Input '%s' is shorter than the snapshot's"
+                        , simulation->pszInputFile);
+        }
+        else
+        {
+            char szInputBuffer[MAX_LINE_SIZE];
+            for (i = 0; i < header.lArrivalsRead; i++)
+                if (fgets(szInputBuffer, MAX_LINE_SIZE, simulation->pInputFile) == NULL)
+                    ErrExit(ERR_BAD_INPUT, "Input '%s' is shorter than the snapshot's"
+                            , simulation->pszInputFile);
+        }
+    }
+    simulation->bInputDone = header.bInputDone;
+    simulation->lArrivalNext = (long)header.lArrivalsRead;
+    simulation->iArrivalClock = header.iArrivalClock;
+}
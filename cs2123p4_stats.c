@@ -0,0 +1,103 @@
+/******************************************************************
+ cs2123p4_stats.c by Justin Mungal
+
+ Machine Improvement Proposal - Instrumentation Report
+
+ Purpose:
+
+ This file contains the --stats=json report. It shows where a slow run
+ spends its time:
+
+     engine         "lindley" when simulateLindley computed the run
+                    without events (the event counters are then 0),
+                    else "event"
+     events         events processed, by type
+     event_list     inserts, the steps they took (nodes passed by
+                    searchLL, or levels sifted by the heap) in total and
+                    at most, the peak number of pending events and the
+                    node allocator counts
+     queues         peak length and allocator counts of each queue
+     widget_table   rows in use at the peak and rows allocated
+     wall_seconds   reading the input, the event loop and the report
+
+ The counters are updated through the STAT macro. They are plain
+ increments and compares, so counting costs a few percent, and a build
+ with NO_STATS compiles them out (and --stats=json is then rejected).
+ In streaming mode (-s) most of the input is read during the event loop,
+ so its time is counted as simulate rather than parse.
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include "cs2123p4.h"
+
+static void printPoolJson(NodePool *pool)
+{
+    printf("\"allocated\": %ld, \"freed\": %ld, \"malloc_calls\": %ld, \"allocator\": \"%s\""
+           , pool->lAllocCount, pool->lFreeCount, pool->lMallocCount
+           , pool->bPooled == TRUE ? "pool" : "malloc");
+}
+
+/**************************** printStatsJson ******************************
+ void printStatsJson(Simulation simulation)
+ Purpose:
+ Prints the instrumentation counters and timers of a finished run to
+ standard output as one JSON object.
+ Parameters:
+ I  Simulation simulation               The simulation that was run
+ **************************************************************************/
+void printStatsJson(Simulation simulation)
+{
+    SimulationStats *pStats = &simulation->stats;
+    LinkedList list = simulation->eventList;
+    long lEventTotal = 0;
+    int i;
+
+    for (i = 1; i < EVT_TYPE_COUNT; i++)
+        lEventTotal += pStats->lEventCounts[i];
+
+    printf("{\n  \"engine\": \"%s\",\n", pStats->bLindley == TRUE ? "lindley" : "event");
+    printf("  \"events\": {\"arrival\": %ld, \"server_complete\": %ld, \"total\": %ld},\n"
+           , pStats->lEventCounts[EVT_ARRIVAL], pStats->lEventCounts[EVT_SERVER_COMPLETE]
+           , lEventTotal);
+
+    printf("  \"event_list\": {\"kind\": \"%s\", \"inserts\": %ld, \"search_steps\": %ld"
+           ", \"search_max\": %ld, \"search_mean\": %.3f, \"peak_length\": %ld, "
+           , list->iKind == EVL_HEAP ? "heap" : "list", list->lSearchCalls
+           , list->lSearchSteps, list->lSearchMax
+           , list->lSearchCalls == 0 ? 0.0 : (double)list->lSearchSteps / list->lSearchCalls
+           , list->nodePool.lPeakInUse);
+    printPoolJson(&list->nodePool);
+    printf("},\n");
+
+    printf("  \"queues\": [\n");
+    for (i = 0; i < simulation->iServerCount; i++)
+    {
+        Queue queue = simulation->queues[i];
+#ifndef QUEUE_RING
+        printf("    {\"name\": \"%s\", \"entered\": %ld, \"peak_length\": %ld, "
+               , queue->szQName, queue->lQueueWidgetTotalCount, queue->nodePool.lPeakInUse);
+        printPoolJson(&queue->nodePool);
+        printf("}");
+#else
+        printf("    {\"name\": \"%s\", \"entered\": %ld, \"peak_length\": %ld"
+               ", \"ring_capacity\": %ld}"
+               , queue->szQName, queue->lQueueWidgetTotalCount, queue->lPeakCount
+               , queue->lMask + 1);
+#endif
+        printf("%s\n", i + 1 < simulation->iServerCount ? "," : "");
+    }
+    printf("  ],\n");
+
+    // with -P the partitions' tables are in pStats, the base table is unused
+    printf("  \"widget_table\": {\"rows\": %u, \"capacity\": %u},\n"
+           , simulation->widgets.uRows + pStats->uWidgetRows
+           , simulation->widgets.uCapacity + pStats->uWidgetCapacity);
+    printf("  \"wall_seconds\": {\"parse\": %.6f, \"simulate\": %.6f, \"report\": %.6f}\n}\n"
+           , pStats->dParseSeconds, pStats->dSimulateSeconds, pStats->dReportSeconds);
+}
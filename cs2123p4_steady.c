@@ -0,0 +1,291 @@
+/******************************************************************
+ cs2123p4_steady.c by Justin Mungal
+
+ Machine Improvement Proposal - Steady-State Estimation
+
+ Purpose:
+
+ This file contains the steady-state mode (-S). The averages printed
+ for a run include its start, when the queues are still filling, and
+ a long run spends most of its time refining averages that stopped
+ moving long before. With -S the widgets' queue waits and times in
+ system are also gathered, in the order the widgets leave, into
+ batches of consecutive widgets:
+
+ - The end of the warm-up is found by MSER-5 (the marginal standard
+   error rule over batches of 5 widgets): the first d batches are
+   dropped, where d makes the remaining batch means' squared standard
+   error, sum (Y[j] - mean)^2 / (n - d)^2, smallest. A d past the
+   middle of the batches means the run has not warmed up yet (or never
+   will: an overloaded server's waits keep growing).
+ - The widgets after the warm-up are grouped into STEADY_CI_BATCHES
+   batches, and the mean and 95% confidence half-width are those of
+   the batch means. The batches are taken to be independent when the
+   lag-1 autocorrelation of their means is under 2 / sqrt(batches).
+ - The run stops once both half-widths are at most the target given to
+   -S, in time units or (with %) relative to the mean.
+
+ At most STEADY_MAX_BATCHES batches are kept: when they are full,
+ neighbouring batches are merged and the batch size doubles, so the
+ memory does not depend on the length of the run. The warm-up and
+ interval are worked out every STEADY_CHECK_BATCHES batches, so they
+ cost a few operations per widget.
+
+ Stopping early pays off most when streaming (-s), since the rest of
+ the input is then never read.
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <math.h>
+#include "cs2123p4.h"
+
+struct SteadyStateImp
+{
+    double dTarget;                 // half-width to reach, in tu or relative
+    int bRelative;                  // TRUE - dTarget is a fraction of the mean
+    long lBatchWidgets;             // widgets per batch
+    long long *lWaitSums;           // per batch: sum of the queue waits
+    long long *lSystemSums;         //   sum of the times in system
+    int *iEndClocks;                //   clock when its last widget left
+    int iBatches;                   // full batches
+    long lPartWidgets;              // widgets in the batch being filled
+    long long lPartWait;
+    long long lPartSystem;
+    long lWidgets;                  // widgets observed
+    SteadyStateResult result;       // estimates at the last check
+};
+
+/**************************** newSteadyState ******************************
+ SteadyState newSteadyState(double dHalfWidth, int bRelative)
+ Purpose:
+ Creates the estimator of a run that is to stop once the half-widths
+ are at most dHalfWidth (time units, or a fraction of the means when
+ bRelative is TRUE).
+ **************************************************************************/
+SteadyState newSteadyState(double dHalfWidth, int bRelative)
+{
+    SteadyState steady = (SteadyState)calloc(1, sizeof(struct SteadyStateImp));
+
+    if (steady == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the steady-state batches");
+    steady->lWaitSums = (long long *)malloc(STEADY_MAX_BATCHES * sizeof(long long));
+    steady->lSystemSums = (long long *)malloc(STEADY_MAX_BATCHES * sizeof(long long));
+    steady->iEndClocks = (int *)malloc(STEADY_MAX_BATCHES * sizeof(int));
+    if (steady->lWaitSums == NULL || steady->lSystemSums == NULL
+        || steady->iEndClocks == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the steady-state batches");
+    steady->dTarget = dHalfWidth;
+    steady->bRelative = bRelative;
+    steady->lBatchWidgets = STEADY_BATCH_WIDGETS;
+    return steady;
+}
+
+void freeSteadyState(SteadyState steady)
+{
+    free(steady->lWaitSums);
+    free(steady->lSystemSums);
+    free(steady->iEndClocks);
+    free(steady);
+}
+
+// the batch at which the warm-up of one series ends (MSER), or iBatches
+// when it is in the second half of the batches
+static int mserTruncation(long long lSums[], int iBatches, long lBatchWidgets)
+{
+    double dMean = 0.0, dSquares = 0.0, dBest = HUGE_VAL;
+    int iBest = iBatches, iLast = iBatches - STEADY_CI_BATCHES, j;
+
+    // the batches from j on, added last first (Welford's update)
+    for (j = iBatches - 1; j >= 0; j--)
+    {
+        double dValue = (double)lSums[j] / lBatchWidgets;
+        double dDelta = dValue - dMean;
+        int iCount = iBatches - j;
+
+        dMean += dDelta / iCount;
+        dSquares += dDelta * (dValue - dMean);
+        if (j <= iLast && dSquares / ((double)iCount * iCount) <= dBest)
+        {
+            dBest = dSquares / ((double)iCount * iCount);
+            iBest = j;
+        }
+    }
+    return iBest <= iBatches / 2 ? iBest : iBatches;
+}
+
+// mean, half-width and lag-1 autocorrelation of the STEADY_CI_BATCHES
+// groups of iGroup batches that start at batch iFirst
+static void batchMeans(long long lSums[], int iFirst, int iGroup, long lBatchWidgets
+                       , double *pdMean, double *pdHalfWidth, double *pdLag1)
+{
+    double dMeans[STEADY_CI_BATCHES];
+    double dMean = 0.0, dSquares = 0.0, dLag = 0.0;
+    int k, j;
+
+    for (k = 0; k < STEADY_CI_BATCHES; k++)
+    {
+        long long lSum = 0;
+        for (j = 0; j < iGroup; j++)
+            lSum += lSums[iFirst + k * iGroup + j];
+        dMeans[k] = (double)lSum / ((double)iGroup * lBatchWidgets);
+        dMean += dMeans[k];
+    }
+    dMean /= STEADY_CI_BATCHES;
+    for (k = 0; k < STEADY_CI_BATCHES; k++)
+    {
+        dSquares += (dMeans[k] - dMean) * (dMeans[k] - dMean);
+        if (k > 0)
+            dLag += (dMeans[k] - dMean) * (dMeans[k - 1] - dMean);
+    }
+    *pdMean = dMean;
+    *pdHalfWidth = STEADY_T_QUANTILE * sqrt(dSquares / (STEADY_CI_BATCHES - 1)
+                                            / STEADY_CI_BATCHES);
+    *pdLag1 = dSquares > 0.0 ? dLag / dSquares : 0.0;
+}
+
+// work out the warm-up and the estimates from the batches so far
+static void checkSteadyState(SteadyState steady)
+{
+    SteadyStateResult *pResult = &steady->result;
+    int iWarmup, iGroup, iSystemWarmup;
+    double dWaitLag, dSystemLag, dLimit;
+
+    iWarmup = mserTruncation(steady->lWaitSums, steady->iBatches, steady->lBatchWidgets);
+    iSystemWarmup = mserTruncation(steady->lSystemSums, steady->iBatches
+                                   , steady->lBatchWidgets);
+    if (iSystemWarmup > iWarmup)
+        iWarmup = iSystemWarmup;
+    pResult->bWarmedUp = iWarmup < steady->iBatches;
+    if (pResult->bWarmedUp == FALSE)
+        return;
+
+    // whole groups of batches; what is left over goes to the warm-up
+    iGroup = (steady->iBatches - iWarmup) / STEADY_CI_BATCHES;
+    iWarmup = steady->iBatches - iGroup * STEADY_CI_BATCHES;
+    pResult->lWarmupWidgets = iWarmup * steady->lBatchWidgets;
+    pResult->iWarmupTime = iWarmup > 0 ? steady->iEndClocks[iWarmup - 1] : 0;
+    pResult->lBatchWidgets = iGroup * steady->lBatchWidgets;
+    batchMeans(steady->lWaitSums, iWarmup, iGroup, steady->lBatchWidgets
+               , &pResult->dWaitMean, &pResult->dWaitHalfWidth, &dWaitLag);
+    batchMeans(steady->lSystemSums, iWarmup, iGroup, steady->lBatchWidgets
+               , &pResult->dSystemMean, &pResult->dSystemHalfWidth, &dSystemLag);
+
+    // batches still correlated are too short to trust the half-widths
+    dLimit = 2.0 / sqrt(STEADY_CI_BATCHES);
+    if (dWaitLag > dLimit || dSystemLag > dLimit)
+        return;
+    if (steady->bRelative == TRUE)
+        pResult->bConverged
+            = pResult->dWaitHalfWidth <= steady->dTarget * pResult->dWaitMean
+              && pResult->dSystemHalfWidth <= steady->dTarget * pResult->dSystemMean;
+    else
+        pResult->bConverged = pResult->dWaitHalfWidth <= steady->dTarget
+                              && pResult->dSystemHalfWidth <= steady->dTarget;
+}
+
+/************************** observeSteadyState ****************************
+ int observeSteadyState(SteadyState steady, int iWait, int iSystemTime
+                        , int iClock)
+ Purpose:
+ Adds a widget that left the system at iClock after waiting iWait in
+ its queue and iSystemTime in the system.
+ Returns:
+ TRUE once the run may stop: the warm-up is over and both half-widths
+ have reached the target.
+ **************************************************************************/
+int observeSteadyState(SteadyState steady, int iWait, int iSystemTime, int iClock)
+{
+    int j;
+
+    steady->lWidgets++;
+    steady->lPartWait += iWait;
+    steady->lPartSystem += iSystemTime;
+    if (++steady->lPartWidgets < steady->lBatchWidgets)
+        return FALSE;
+
+    // the batch is full
+    if (steady->iBatches == STEADY_MAX_BATCHES)
+    {
+        //merge neighbouring batches, doubling the batch size
+        for (j = 0; j < STEADY_MAX_BATCHES / 2; j++)
+        {
+            steady->lWaitSums[j] = steady->lWaitSums[2 * j] + steady->lWaitSums[2 * j + 1];
+            steady->lSystemSums[j] = steady->lSystemSums[2 * j]
+                                   + steady->lSystemSums[2 * j + 1];
+            steady->iEndClocks[j] = steady->iEndClocks[2 * j + 1];
+        }
+        steady->iBatches = STEADY_MAX_BATCHES / 2;
+        steady->lBatchWidgets *= 2;
+        
+        //the widgets gathered are half of a batch now
+        return FALSE;
+    }
+    steady->lWaitSums[steady->iBatches] = steady->lPartWait;
+    steady->lSystemSums[steady->iBatches] = steady->lPartSystem;
+    steady->iEndClocks[steady->iBatches] = iClock;
+    steady->iBatches++;
+    steady->lPartWidgets = 0;
+    steady->lPartWait = 0;
+    steady->lPartSystem = 0;
+
+    if (steady->iBatches % STEADY_CHECK_BATCHES == 0
+        && steady->iBatches >= 2 * STEADY_CI_BATCHES)
+        checkSteadyState(steady);
+    return steady->result.bConverged;
+}
+
+/**************************** printSteadyState ****************************
+ void printSteadyState(SteadyState steady)
+ Purpose:
+ Prints the warm-up and the steady-state means with their half-widths:
+ as of the check that stopped the run, or else of all the batches.
+ **************************************************************************/
+void printSteadyState(SteadyState steady)
+{
+    SteadyStateResult *pResult = &steady->result;
+    int bStopped = pResult->bConverged;
+    char szTarget[32];
+
+    //a run that did not stop is reported with all of its batches
+    if (bStopped == FALSE && steady->iBatches >= 2 * STEADY_CI_BATCHES)
+        checkSteadyState(steady);
+    if (steady->bRelative == TRUE)
+        sprintf(szTarget, "%g%% of the mean", steady->dTarget * 100.0);
+    else
+        sprintf(szTarget, "%g", steady->dTarget);
+
+    if (steady->iBatches < 2 * STEADY_CI_BATCHES)
+    {
+        printf("Steady state: %ld widgets are too few to find the warm-up\n\n"
+               , steady->lWidgets);
+        return;
+    }
+    if (pResult->bWarmedUp == FALSE)
+    {
+        printf("Steady state: no end of the warm-up found in %ld widgets\n\n"
+               , steady->lWidgets);
+        return;
+    }
+    printf("Steady state: warm-up of %ld widgets (to time %d), then %d batches of %ld widgets\n"
+           , pResult->lWarmupWidgets, pResult->iWarmupTime, STEADY_CI_BATCHES
+           , pResult->lBatchWidgets);
+    printf("Steady-State Average Queue Time: %.1f +/- %.2f\n"
+           , pResult->dWaitMean, pResult->dWaitHalfWidth);
+    printf("Steady-State Average time in System: %.1f +/- %.2f\n"
+           , pResult->dSystemMean, pResult->dSystemHalfWidth);
+    if (bStopped == TRUE)
+        printf("(mean +/- 95%% confidence half-width, stopped at a half-width of %s)\n\n"
+               , szTarget);
+    else if (pResult->bConverged == TRUE)
+        printf("(mean +/- 95%% confidence half-width, a half-width of %s was reached"
+               " at the end)\n\n", szTarget);
+    else
+        printf("(mean +/- 95%% confidence half-width, a half-width of %s was not reached)\n\n"
+               , szTarget);
+}
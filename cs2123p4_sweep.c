@@ -0,0 +1,287 @@
+/******************************************************************
+ cs2123p4_sweep.c by Justin Mungal
+
+ Machine Improvement Proposal - Parameter Sweep
+
+ Purpose:
+
+ This file contains the parameter sweep mode (-g grid). The input
+ trace is parsed once; every configuration of the grid is then
+ simulated concurrently on the work-stealing pool against that same
+ read-only widget array. A configuration's changes are applied as
+ each widget is read (see readArrival), so the trace is never
+ copied. One CSV summary row is written per configuration, with an
+ avg_queue_<server> column for each server of the largest
+ configuration (empty where a configuration has fewer servers, or a
+ server had no widgets).
+
+ The grid is a list of dimensions separated by ';', each a name and
+ a comma-separated list of values:
+
+     scale=0.5,1,1.5;route=trace,M,W;servers=2,4,8
+
+ scale   multiplies iStep1tu and iStep2tu (rounded to nearest)
+ route   trace - keep iWhichServer, M - force server M, W - force W,
+         spread - spread widgets over all servers by widget number
+ servers number of servers, each with its own queue
+
+ A missing dimension has the single value 1 (scale), trace (route)
+ or the -n server count (servers). Every combination of the values
+ is run.
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <math.h>
+#include <ctype.h>
+#include "cs2123p4.h"
+
+typedef struct
+{
+    double dScale[MAX_SWEEP_VALUES];
+    int iScaleCount;
+    int iRoute[MAX_SWEEP_VALUES];   // iForceServer: 0 - as traced, ROUTE_SPREAD
+    int iRouteCount;                //   or a forced iWhichServer
+    int iServers[MAX_SWEEP_VALUES];
+    int iServersCount;
+} SweepGrid;
+
+typedef struct
+{
+    Simulation base;                // the parsed trace and the switches
+    int iTimeLimit;
+    SweepGrid *pGrid;
+    SimulationResult *results;      // one per configuration
+    int iMaxServers;                // most servers of any configuration
+    double *dAvgQueueTimes;         // the results' per-server averages,
+                                    //   iMaxServers per configuration
+} SweepContext;
+
+// name of an iRoute value
+static const char *routeName(int iRoute)
+{
+    switch (iRoute)
+    {
+        case 0:
+            return "trace";
+        case 1:
+            return "M";
+        case 2:
+            return "W";
+        default:
+            return "spread";
+    }
+}
+
+/*************************** parseSweepGrid *******************************
+ void parseSweepGrid(char szSpec[], int iDefaultServers, SweepGrid *pGrid)
+ Purpose:
+ Parses a -g grid specification (see the file header).
+ **************************************************************************/
+static void parseSweepGrid(char szSpec[], int iDefaultServers, SweepGrid *pGrid)
+{
+    char szCopy[MAX_SWEEP_SPEC];
+    char *pszDimension, *pszDimensionSave;
+
+    pGrid->dScale[0] = 1.0;
+    pGrid->iScaleCount = 1;
+    pGrid->iRoute[0] = 0;
+    pGrid->iRouteCount = 1;
+    pGrid->iServers[0] = iDefaultServers;
+    pGrid->iServersCount = 1;
+
+    if (strlen(szSpec) >= MAX_SWEEP_SPEC)
+        ErrExit(ERR_COMMAND_LINE, "Sweep grid is too long: %s", szSpec);
+    strcpy(szCopy, szSpec);
+
+    for (pszDimension = strtok_r(szCopy, ";", &pszDimensionSave)
+         ; pszDimension != NULL
+         ; pszDimension = strtok_r(NULL, ";", &pszDimensionSave))
+    {
+        char *pszValues = strchr(pszDimension, '=');
+        char *pszValue, *pszValueSave;
+        int iCount = 0;
+
+        if (pszValues == NULL)
+            ErrExit(ERR_COMMAND_LINE, "Expected name=values in sweep grid, found '%s'"
+                    , pszDimension);
+        *pszValues++ = '\0';
+
+        for (pszValue = strtok_r(pszValues, ",", &pszValueSave)
+             ; pszValue != NULL
+             ; pszValue = strtok_r(NULL, ",", &pszValueSave))
+        {
+            if (iCount >= MAX_SWEEP_VALUES)
+                ErrExit(ERR_COMMAND_LINE, "More than %d values for '%s'"
+                        , MAX_SWEEP_VALUES, pszDimension);
+            if (strcmp(pszDimension, "scale") == 0)
+            {
+                if (sscanf(pszValue, "%lf", &pGrid->dScale[iCount]) != 1
+                    || pGrid->dScale[iCount] < 0.0)
+                    ErrExit(ERR_COMMAND_LINE, "Bad scale '%s'", pszValue);
+            }
+            else if (strcmp(pszDimension, "route") == 0)
+            {
+                if (strcmp(pszValue, "trace") == 0)
+                    pGrid->iRoute[iCount] = 0;
+                else if (strcmp(pszValue, "M") == 0)
+                    pGrid->iRoute[iCount] = 1;
+                else if (strcmp(pszValue, "W") == 0)
+                    pGrid->iRoute[iCount] = 2;
+                else if (strcmp(pszValue, "spread") == 0)
+                    pGrid->iRoute[iCount] = ROUTE_SPREAD;
+                else
+                    ErrExit(ERR_COMMAND_LINE, "Bad route '%s'", pszValue);
+            }
+            else if (strcmp(pszDimension, "servers") == 0)
+            {
+                if (sscanf(pszValue, "%d", &pGrid->iServers[iCount]) != 1
+                    || pGrid->iServers[iCount] < 1
+                    || pGrid->iServers[iCount] > MAX_SERVERS)
+                    ErrExit(ERR_COMMAND_LINE, "Bad server count '%s'", pszValue);
+            }
+            else
+                ErrExit(ERR_COMMAND_LINE, "Unknown sweep dimension '%s'", pszDimension);
+            iCount++;
+        }
+        if (iCount == 0)
+            ErrExit(ERR_COMMAND_LINE, "No values for '%s'", pszDimension);
+
+        if (strcmp(pszDimension, "scale") == 0)
+            pGrid->iScaleCount = iCount;
+        else if (strcmp(pszDimension, "route") == 0)
+            pGrid->iRouteCount = iCount;
+        else
+            pGrid->iServersCount = iCount;
+    }
+}
+
+// configuration lConfig: scale varies slowest, then servers, route fastest
+static double configScale(SweepGrid *pGrid, long lConfig)
+{
+    return pGrid->dScale[lConfig / pGrid->iRouteCount / pGrid->iServersCount];
+}
+static int configServers(SweepGrid *pGrid, long lConfig)
+{
+    return pGrid->iServers[lConfig / pGrid->iRouteCount % pGrid->iServersCount];
+}
+static int configRoute(SweepGrid *pGrid, long lConfig)
+{
+    return pGrid->iRoute[lConfig % pGrid->iRouteCount];
+}
+
+static void runSweepConfig(void *pContext, long lConfig)
+{
+    SweepContext *pSweep = (SweepContext *)pContext;
+    Simulation base = pSweep->base;
+    Simulation simulation = newSimulation();
+
+    setEventListKind(simulation->eventList, base->eventList->iKind);
+    simulation->iEngine = base->iEngine;
+    simulation->eventList->nodePool.bPooled = base->eventList->nodePool.bPooled;
+    simulation->bStreaming = TRUE;
+    setServerCount(simulation, configServers(pSweep->pGrid, lConfig));
+
+    // share the parsed trace; readArrival applies the configuration
+    simulation->arrivalWidgets = base->arrivalWidgets;
+    simulation->bArrivalsBorrowed = TRUE;
+    simulation->lArrivalTotal = base->lArrivalTotal;
+    simulation->iArrivalEndClock = base->iArrivalEndClock;
+    simulation->dStepScale = configScale(pSweep->pGrid, lConfig);
+    simulation->iForceServer = configRoute(pSweep->pGrid, lConfig);
+    readArrivalGroup(simulation);
+
+    simulate(simulation, pSweep->iTimeLimit, &pSweep->results[lConfig]);
+    
+    // keep the per-server averages, which are freed with the simulation
+    {
+        SimulationResult *pResult = &pSweep->results[lConfig];
+        double *dAverages = pSweep->dAvgQueueTimes + lConfig * pSweep->iMaxServers;
+        memcpy(dAverages, pResult->dAvgQueueTimes
+               , pResult->iServerCount * sizeof(double));
+        pResult->dAvgQueueTimes = dAverages;
+    }
+    freeSimulation(simulation);
+}
+
+// CSV field for an average that is undefined when no widget was counted
+static void printCsvAverage(double dValue)
+{
+    if (isnan(dValue))
+        printf(",");
+    else
+        printf(",%.3f", dValue);
+}
+
+/****************************** runSweep **********************************
+ void runSweep(Simulation simulation, int iTimeLimit)
+ Purpose:
+ Runs every configuration of the simulation->pszSweepGrid grid against
+ the parsed input trace and prints one CSV row per configuration.
+ Parameters:
+ I  Simulation simulation           The simulation holding the parsed
+                                    input (arrivalWidgets) and switches.
+ I  int iTimeLimit                  Passed on to simulate.
+ Notes:
+ The simulation is freed.
+ **************************************************************************/
+void runSweep(Simulation simulation, int iTimeLimit)
+{
+    SweepGrid grid;
+    SweepContext sweep;
+    long lConfigs, lConfig;
+    int i;
+
+    if (simulation->arrivalWidgets == NULL)
+        ErrExit(ERR_BAD_INPUT, "A sweep needs an input file");
+
+    parseSweepGrid(simulation->pszSweepGrid, simulation->iServerCount, &grid);
+    lConfigs = (long)grid.iScaleCount * grid.iServersCount * grid.iRouteCount;
+
+    sweep.base = simulation;
+    sweep.iTimeLimit = iTimeLimit;
+    sweep.pGrid = &grid;
+    sweep.iMaxServers = 0;
+    for (i = 0; i < grid.iServersCount; i++)
+        if (grid.iServers[i] > sweep.iMaxServers)
+            sweep.iMaxServers = grid.iServers[i];
+    sweep.results = (SimulationResult *)malloc(lConfigs * sizeof(SimulationResult));
+    sweep.dAvgQueueTimes = (double *)malloc((size_t)lConfigs * sweep.iMaxServers
+                                            * sizeof(double));
+    if (sweep.results == NULL || sweep.dAvgQueueTimes == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the sweep");
+
+    runWorkPool(lConfigs, simulation->iWorkerThreads, runSweepConfig, &sweep);
+
+    printf("config,scale,servers,route,widgets,clock");
+    for (i = 0; i < sweep.iMaxServers; i++)
+    {
+        char szTag[6], *pszTag;
+        serverTag(i, szTag);
+        for (pszTag = szTag; *pszTag != '\0'; pszTag++)
+            *pszTag = tolower((unsigned char)*pszTag);
+        printf(",avg_queue_%s", szTag);
+    }
+    printf(",avg_queue_all,avg_system\n");
+    for (lConfig = 0; lConfig < lConfigs; lConfig++)
+    {
+        SimulationResult *pResult = &sweep.results[lConfig];
+        printf("%ld,%g,%d,%s,%ld,%d", lConfig, configScale(&grid, lConfig)
+               , configServers(&grid, lConfig), routeName(configRoute(&grid, lConfig))
+               , pResult->lWidgetCount, pResult->iClock);
+        for (i = 0; i < sweep.iMaxServers; i++)
+            printCsvAverage(i < pResult->iServerCount ? pResult->dAvgQueueTimes[i] : NAN);
+        printCsvAverage(pResult->dAvgQueueTime);
+        printCsvAverage(pResult->dAvgSystemTime);
+        printf("\n");
+    }
+
+    free(sweep.dAvgQueueTimes);
+    free(sweep.results);
+    freeSimulation(simulation);
+}
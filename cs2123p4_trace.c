@@ -0,0 +1,226 @@
+/******************************************************************
+ cs2123p4_trace.c by Justin Mungal
+
+ Machine Improvement Proposal - Asynchronous Event Trace
+
+ Purpose:
+
+ This file contains the trace sink used by -T. Each verbose event is
+ stored as a fixed-size TraceRecord in a single producer, single
+ consumer ring buffer; the simulation never waits for output unless
+ the ring is full. A background thread drains the ring to the trace
+ file, either as binary records (an EventTraceHeader followed by the
+ records, formatted later by p4trace) or, when text was asked for,
+ as the same lines -v prints.
+
+ printTraceRecord is the only place the verbose lines are formatted,
+ so -v, -v -T and p4trace all produce identical text.
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "cs2123p4.h"
+
+#define TRACE_IDLE_NS       50000       // writer sleep when the ring is empty
+#define TRACE_FILE_BUFFER   (1 << 20)   // stdio buffer for the trace file
+
+struct TraceSinkImp
+{
+    TraceRecord *ring;              // TRACE_RING_RECORDS records
+    atomic_long lHead;              // next record to write (writer thread)
+    atomic_long lTail;              // next free slot (simulation)
+    long lHeadSeen;                 // simulation's last view of lHead
+    atomic_int bClosing;            // TRUE - no more records will be put
+    FILE *pFile;
+    int bText;                      // TRUE - write text lines, FALSE - records
+    int bWriteError;                // set by the writer thread
+    pthread_t thread;
+};
+
+// write records [lFrom, lTo) of the ring
+static void writeTraceRange(TraceSink sink, long lFrom, long lTo)
+{
+    long lMask = TRACE_RING_RECORDS - 1;
+
+    if (sink->bText)
+    {
+        for (; lFrom < lTo; lFrom++)
+            printTraceRecord(sink->pFile, &sink->ring[lFrom & lMask]);
+        return;
+    }
+    // at most two contiguous pieces when the range wraps
+    while (lFrom < lTo)
+    {
+        long lCount = TRACE_RING_RECORDS - (lFrom & lMask);
+        if (lCount > lTo - lFrom)
+            lCount = lTo - lFrom;
+        if (fwrite(&sink->ring[lFrom & lMask], sizeof(TraceRecord), lCount
+                   , sink->pFile) != (size_t)lCount)
+            sink->bWriteError = TRUE;
+        lFrom += lCount;
+    }
+}
+
+static void *traceWriter(void *pArg)
+{
+    TraceSink sink = (TraceSink)pArg;
+    struct timespec idle = { 0, TRACE_IDLE_NS };
+    long lHead = atomic_load_explicit(&sink->lHead, memory_order_relaxed);
+
+    for (;;)
+    {
+        long lTail = atomic_load_explicit(&sink->lTail, memory_order_acquire);
+        if (lTail == lHead)
+        {
+            // every record put before closing is visible once bClosing is
+            if (atomic_load_explicit(&sink->bClosing, memory_order_acquire)
+                && atomic_load_explicit(&sink->lTail, memory_order_acquire) == lHead)
+                break;
+            nanosleep(&idle, NULL);
+            continue;
+        }
+        writeTraceRange(sink, lHead, lTail);
+        lHead = lTail;
+        atomic_store_explicit(&sink->lHead, lHead, memory_order_release);
+    }
+    return NULL;
+}
+
+/**************************** newTraceSink ********************************
+ TraceSink newTraceSink(char szPath[], int bText)
+ Purpose:
+ Creates the trace file szPath and starts its writer thread.
+ Parameters:
+ I  char szPath[]                       The trace file
+ I  int bText                           TRUE - write the verbose text,
+                                        FALSE - write binary records
+ **************************************************************************/
+TraceSink newTraceSink(char szPath[], int bText)
+{
+    TraceSink sink = (TraceSink)malloc(sizeof(struct TraceSinkImp));
+
+    if (sink == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the trace");
+    sink->ring = (TraceRecord *)malloc(TRACE_RING_RECORDS * sizeof(TraceRecord));
+    if (sink->ring == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the trace");
+    atomic_init(&sink->lHead, 0);
+    atomic_init(&sink->lTail, 0);
+    atomic_init(&sink->bClosing, FALSE);
+    sink->lHeadSeen = 0;
+    sink->bText = bText;
+    sink->bWriteError = FALSE;
+
+    sink->pFile = fopen(szPath, bText ? "w" : "wb");
+    if (sink->pFile == NULL)
+        ErrExit(ERR_BAD_INPUT, "Unable to create trace file '%s'", szPath);
+    setvbuf(sink->pFile, NULL, _IOFBF, TRACE_FILE_BUFFER);
+    if (bText)
+        fprintf(sink->pFile, "Time\t Widget\t Event\n");
+    else
+    {
+        EventTraceHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.szMagic, EVENT_TRACE_MAGIC, sizeof(header.szMagic));
+        header.iVersion = EVENT_TRACE_VERSION;
+        header.iRecordSize = (int)sizeof(TraceRecord);
+        if (fwrite(&header, sizeof(header), 1, sink->pFile) != 1)
+            ErrExit(ERR_BAD_INPUT, "Unable to write trace file '%s'", szPath);
+    }
+
+    if (pthread_create(&sink->thread, NULL, traceWriter, sink) != 0)
+        ErrExit(ERR_ALGORITHM, "Unable to start the trace writer");
+    return sink;
+}
+
+/*************************** putTraceRecord *******************************
+ void putTraceRecord(TraceSink sink, TraceRecord *pRecord)
+ Purpose:
+ Queues a record for the writer thread.
+ Notes:
+ Only one thread may put records. It waits only when the ring is full.
+ **************************************************************************/
+void putTraceRecord(TraceSink sink, TraceRecord *pRecord)
+{
+    long lTail = atomic_load_explicit(&sink->lTail, memory_order_relaxed);
+
+    while (lTail - sink->lHeadSeen >= TRACE_RING_RECORDS)
+    {
+        sink->lHeadSeen = atomic_load_explicit(&sink->lHead, memory_order_acquire);
+        if (lTail - sink->lHeadSeen >= TRACE_RING_RECORDS)
+            sched_yield();
+    }
+    sink->ring[lTail & (TRACE_RING_RECORDS - 1)] = *pRecord;
+    atomic_store_explicit(&sink->lTail, lTail + 1, memory_order_release);
+}
+
+/*************************** closeTraceSink *******************************
+ void closeTraceSink(TraceSink sink)
+ Purpose:
+ Waits for the writer thread to write every record, then closes the
+ trace file and frees the sink.
+ **************************************************************************/
+void closeTraceSink(TraceSink sink)
+{
+    int bError;
+
+    atomic_store_explicit(&sink->bClosing, TRUE, memory_order_release);
+    pthread_join(sink->thread, NULL);
+    bError = sink->bWriteError | ferror(sink->pFile);
+    if (fclose(sink->pFile) != 0 || bError)
+        ErrExit(ERR_BAD_INPUT, "Unable to write the trace file");
+    free(sink->ring);
+    free(sink);
+}
+
+/************************** printTraceRecord ******************************
+ void printTraceRecord(FILE *pFile, TraceRecord *pRecord)
+ Purpose:
+ Prints a record as its line of the verbose output.
+ Notes:
+ Server and queue names are rebuilt from the server subscript with
+ serverTag, as setServerCount names them.
+ **************************************************************************/
+void printTraceRecord(FILE *pFile, TraceRecord *pRecord)
+{
+    char szTag[6];
+
+    serverTag(pRecord->iServer, szTag);
+    switch (pRecord->iKind)
+    {
+        case TREC_ARRIVED:
+            fprintf(pFile, "%d\t %ld\t Arrived\n", pRecord->iTime, pRecord->lWidgetNr);
+            break;
+        case TREC_ENTER:
+            fprintf(pFile, "%d\t %ld\t Enter queue%s\n", pRecord->iTime
+                    , pRecord->lWidgetNr, szTag);
+            break;
+        case TREC_SEIZED:
+            fprintf(pFile, "%d\t %ld\t Seized server server%s\n", pRecord->iTime
+                    , pRecord->lWidgetNr, szTag);
+            break;
+        case TREC_LEAVE_QUEUE:
+            fprintf(pFile, "%d\t %ld\t Leave Queue %s, waited %d\n", pRecord->iTime
+                    , pRecord->lWidgetNr, szTag, pRecord->iValue);
+            break;
+        case TREC_RELEASED:
+            fprintf(pFile, "%d\t %ld\t Released server %s\n", pRecord->iTime
+                    , pRecord->lWidgetNr, szTag);
+            break;
+        case TREC_EXIT:
+            fprintf(pFile, "%d\t %ld\t Exit System, in system %d\n", pRecord->iTime
+                    , pRecord->lWidgetNr, pRecord->iValue);
+            break;
+        default:
+            ErrExit(ERR_BAD_INPUT, "Unknown trace record kind %d", pRecord->iKind);
+    }
+}
@@ -0,0 +1,138 @@
+/******************************************************************
+ cs2123p4_tracefmt.c by Justin Mungal
+
+ Machine Improvement Proposal - Event Trace Formatter (p4trace)
+
+ Purpose:
+
+ Formats a binary event trace written by the simulator's -T switch
+ as the verbose text that -v prints: the "Time Widget Event" header
+ followed by one line per event. With the trace of a quiet -T run,
+
+     completed -T run.trace > summary.txt
+     p4trace run.trace
+
+ the formatted trace followed by summary.txt without its first
+ "Time Event" heading is exactly the output of completed -v.
+
+ A widget results file written by -W is printed as CSV instead, the
+ same text -W writes for a .csv file name.
+
+ Usage:
+ p4trace traceFile|resultsFile [textOutput]
+
+ Returns:
+ 0 on success, ERR_COMMAND_LINE or ERR_BAD_INPUT otherwise.
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include "cs2123p4.h"
+
+#define TRACE_READ_RECORDS  4096        // records read at a time
+
+/************************* formatResults **********************************
+ void formatResults(FILE *pResults, char szPath[], ResultHeader *pHeader
+                    , FILE *pOutput)
+ Purpose:
+ Prints the widget results file pResults (szPath), whose header
+ *pHeader has been read, as CSV: a heading, then one row per widget.
+ **************************************************************************/
+static void formatResults(FILE *pResults, char szPath[], ResultHeader *pHeader
+                          , FILE *pOutput)
+{
+    long *lWidgetNr = (long *)malloc(pHeader->iBlockRows * sizeof(long));
+    int *iColumns = (int *)malloc((size_t)pHeader->iBlockRows * RESULT_INT_COLUMNS
+                                  * sizeof(int));
+    long long lRows, lTotal = 0, i;
+    WidgetResult result;
+
+    if (lWidgetNr == NULL || iColumns == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for a block of results");
+    fprintf(pOutput, "widget,arrival,enter_queue,start,complete,server,wait,system\n");
+    while (fread(&lRows, sizeof(lRows), 1, pResults) == 1)
+    {
+        if (lRows <= 0 || lRows > pHeader->iBlockRows
+            || fread(lWidgetNr, sizeof(long), lRows, pResults) != (size_t)lRows
+            || fread(iColumns, sizeof(int), lRows * RESULT_INT_COLUMNS, pResults)
+               != (size_t)(lRows * RESULT_INT_COLUMNS))
+            ErrExit(ERR_BAD_INPUT, "Truncated widget results file '%s'", szPath);
+        //the int columns of the block follow each other
+        for (i = 0; i < lRows; i++)
+        {
+            result.lWidgetNr = lWidgetNr[i];
+            result.iArrivalTime = iColumns[i];
+            result.iEnterQTime = iColumns[lRows + i];
+            result.iStartTime = iColumns[2 * lRows + i];
+            result.iCompleteTime = iColumns[3 * lRows + i];
+            result.iServer = iColumns[4 * lRows + i];
+            result.iWait = iColumns[5 * lRows + i];
+            result.iSystemTime = iColumns[6 * lRows + i];
+            printWidgetResult(pOutput, &result);
+        }
+        lTotal += lRows;
+    }
+    if (ferror(pResults)
+        || (pHeader->lWidgetCount >= 0 && pHeader->lWidgetCount != lTotal))
+        ErrExit(ERR_BAD_INPUT, "Truncated widget results file '%s'", szPath);
+    free(lWidgetNr);
+    free(iColumns);
+}
+
+int main(int argc, char *argv[])
+{
+    EventTraceHeader header;
+    ResultHeader resultHeader;
+    TraceRecord records[TRACE_READ_RECORDS];
+    FILE *pTrace, *pOutput;
+    size_t iCount, i;
+
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "usage: p4trace traceFile|resultsFile [textOutput]\n");
+        exit(ERR_COMMAND_LINE);
+    }
+    pTrace = fopen(argv[1], "rb");
+    if (pTrace == NULL)
+        ErrExit(ERR_BAD_INPUT, "Unable to open trace file '%s'", argv[1]);
+    pOutput = argc == 3 ? fopen(argv[2], "w") : stdout;
+    if (pOutput == NULL)
+        ErrExit(ERR_BAD_INPUT, "Unable to create '%s'", argv[2]);
+    
+    //a results file (-W) rather than an event trace
+    if (fread(&resultHeader, sizeof(resultHeader), 1, pTrace) == 1
+        && memcmp(resultHeader.szMagic, RESULT_MAGIC, sizeof(resultHeader.szMagic)) == 0)
+    {
+        if (resultHeader.iVersion != RESULT_VERSION || resultHeader.iBlockRows <= 0)
+            ErrExit(ERR_BAD_INPUT, "Unsupported widget results version %d in '%s'"
+                    , resultHeader.iVersion, argv[1]);
+        formatResults(pTrace, argv[1], &resultHeader, pOutput);
+        fclose(pTrace);
+        if (fclose(pOutput) != 0)
+            ErrExit(ERR_BAD_INPUT, "Unable to write the formatted results");
+        return 0;
+    }
+    rewind(pTrace);
+    
+    if (fread(&header, sizeof(header), 1, pTrace) != 1
+        || memcmp(header.szMagic, EVENT_TRACE_MAGIC, sizeof(header.szMagic)) != 0)
+        ErrExit(ERR_BAD_INPUT, "'%s' is not an event trace", argv[1]);
+    if (header.iVersion != EVENT_TRACE_VERSION
+        || header.iRecordSize != (int)sizeof(TraceRecord))
+        ErrExit(ERR_BAD_INPUT, "Unsupported event trace version %d in '%s'"
+                , header.iVersion, argv[1]);
+
+    fprintf(pOutput, "Time\t Widget\t Event\n");
+    while ((iCount = fread(records, sizeof(TraceRecord), TRACE_READ_RECORDS, pTrace)) > 0)
+        for (i = 0; i < iCount; i++)
+            printTraceRecord(pOutput, &records[i]);
+    if (ferror(pTrace))
+        ErrExit(ERR_BAD_INPUT, "Unable to read trace file '%s'", argv[1]);
+
+    fclose(pTrace);
+    if (fclose(pOutput) != 0)
+        ErrExit(ERR_BAD_INPUT, "Unable to write the formatted trace");
+    return 0;
+}
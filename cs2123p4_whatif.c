@@ -0,0 +1,743 @@
+/******************************************************************
+ cs2123p4_whatif.c by Justin Mungal
+
+ Machine Improvement Proposal - What-if Re-simulation
+
+ Purpose:
+
+ This file contains the what-if run (-w). The input (-i) is simulated
+ as usual, and then each edited copy of it given to -w, reusing as
+ much of the input's run as the edits allow:
+
+     completed -i base.txt -w moved.txt,slower.txt
+
+ While the input is simulated, checkpoints of its state are kept in
+ memory, about WHATIF_CHECKPOINTS of them, evenly spaced in time. A
+ checkpoint holds the widgets in the system (being served, queued,
+ arriving), the pending events in processing order, the number of
+ widgets read, and the statistics so far.
+
+ An edited trace is compared with the input widget by widget. Its run
+ starts from the last checkpoint taken before the first changed
+ widget had been read, since up to there the two runs are the same.
+ At each later checkpoint time its state is compared with the input's
+ checkpoint: once every changed widget has left the system and the
+ widgets still in it are the same (by their fields, not their ids in
+ the widget table), and the rest of the two traces are the same, the
+ two runs stay the same to the end. The edited run stops there, and
+ the statistics the input's run gathered after that checkpoint are
+ added to its own. An edit thus re-simulates from the checkpoint
+ before it until its effect has drained from the queues; the results
+ are the same as simulating the edited trace from the start.
+
+ The histograms' minimum and maximum can not be subtracted, so the
+ input's run keeps them per interval between checkpoints (see
+ markHistogram).
+
+ Widgets may also be inserted or removed: the unchanged end of the
+ traces is matched from the back, and compared with the subscripts
+ shifted by the difference in length.
+
+ Returns:
+ N/A
+ ******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "cs2123p4.h"
+
+// a histogram at a checkpoint: only the buckets in use are kept
+typedef struct
+{
+    long lTotal;
+    long lSum;
+    int iMin;                       // of all values so far, valid when lTotal > 0
+    int iMax;
+    long lSegmentTotal;             // values since the previous checkpoint
+    int iSegmentMin;                // and their extremes, valid when
+    int iSegmentMax;                //   lSegmentTotal > 0
+    int iTailMin;                   // extremes of the values recorded after
+    int iTailMax;                   //   this checkpoint in the whole run
+    int iLow;                       // lCounts[0] is bucket iLow
+    int iBuckets;
+    long *lCounts;
+} HistogramMark;
+
+// the widgets in the system, with widgets numbered in the order they are
+// first met (servers, queues, look-ahead arrivals, events) in place of
+// their ids, so the states of two runs can be compared
+typedef struct
+{
+    long lArrivalNext;
+    int bInputDone;
+    unsigned *uServing;             // per server, NO_WIDGET_ID - idle
+    long *lWaiting;                 // per server, widgets queued
+    QElement *elements;             // queued widgets, server by server
+    long lElements, lElementCapacity;
+    Event *arrivalGroup;            // streaming look-ahead arrivals
+    int iArrivalGroupCount;
+    Event *events;                  // pending events in processing order
+    long lEvents, lEventCapacity;
+    Widget *widgets;
+    long lWidgets, lWidgetCapacity;
+} WhatIfState;
+
+typedef struct
+{
+    int iTime;                      // the state holds every event before iTime
+    int iClock;
+    WhatIfState state;
+    long lSystemTimeSum;
+    long lWidgetCount;
+    long *lQueueWaitSum;            // per server
+    long *lQueueCount;              // per server
+    HistogramMark *waitMarks;       // per server
+    HistogramMark systemMark;
+} WhatIfCheckpoint;
+
+typedef struct WhatIfImp
+{
+    int iServerCount;
+    int iInterval;                  // time between checkpoints
+    int bRecording;                 // TRUE - the input's run, else an edited one
+    WhatIfCheckpoint *checkpoints;
+    int iCount;
+    int iCapacity;
+    WhatIfCheckpoint final;         // statistics at the end of the input's run
+    int bTimeLimitReached;          //   and how it ended
+    int iNext;                      // next checkpoint to compare with
+    long lBaseTailStart;            // input widgets from here on are unchanged
+    long lOffset;                   //   and are at this subscript + lOffset
+    int iConverged;                 // checkpoint the edit converged at, -1 - none
+    unsigned *uCompact;             // widget id -> compact number while capturing
+    unsigned uCompactSize;
+    WhatIfState scratch;            // the edited run's state being compared
+} WhatIfImp;
+
+static void *allocItems(size_t iSize, long lCount)
+{
+    void *pItems = calloc(lCount > 0 ? lCount : 1, iSize);
+    if (pItems == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the what-if checkpoints");
+    return pItems;
+}
+
+// make room for lNeeded items in *ppItems
+static void growItems(void **ppItems, long *plCapacity, long lNeeded, size_t iSize)
+{
+    void *pNew;
+    long lCapacity = *plCapacity;
+
+    if (lNeeded <= lCapacity)
+        return;
+    while (lCapacity < lNeeded)
+        lCapacity = lCapacity == 0 ? 16 : 2 * lCapacity;
+    pNew = realloc(*ppItems, lCapacity * iSize);
+    if (pNew == NULL)
+        ErrExit(ERR_ALGORITHM, "No available memory for the what-if checkpoints");
+    *ppItems = pNew;
+    *plCapacity = lCapacity;
+}
+
+// compact number of widget uWidgetId, adding its fields to the state
+static unsigned compactWidget(WhatIf whatIf, WidgetTable *pTable, WhatIfState *pState
+                              , unsigned uWidgetId)
+{
+    Widget *pWidget;
+
+    if (whatIf->uCompact[uWidgetId] != NO_WIDGET_ID)
+        return whatIf->uCompact[uWidgetId];
+    growItems((void **)&pState->widgets, &pState->lWidgetCapacity, pState->lWidgets + 1
+              , sizeof(Widget));
+    pWidget = &pState->widgets[pState->lWidgets];
+    pWidget->lWidgetNr = pTable->lWidgetNr[uWidgetId];
+    pWidget->iStep1tu = pTable->iStep1tu[uWidgetId];
+    pWidget->iStep2tu = pTable->iStep2tu[uWidgetId];
+    pWidget->iArrivalTime = pTable->iArrivalTime[uWidgetId];
+    pWidget->iWhichServer = pTable->iWhichServer[uWidgetId];
+    whatIf->uCompact[uWidgetId] = (unsigned)pState->lWidgets;
+    return (unsigned)pState->lWidgets++;
+}
+
+/***************************** captureState *******************************
+ void captureState(WhatIf whatIf, Simulation simulation, WhatIfState *pState)
+ Purpose:
+ Stores the widgets in the system and the pending events of the
+ simulation in pState.
+ Notes:
+ As in writeSnapshot, the event list and queues are emptied and
+ refilled, which keeps their processing order.
+ **************************************************************************/
+static void captureState(WhatIf whatIf, Simulation simulation, WhatIfState *pState)
+{
+    WidgetTable *pTable = &simulation->widgets;
+    long i, lFirst;
+    int iServer;
+
+    if (whatIf->uCompactSize < pTable->uRows)
+    {
+        free(whatIf->uCompact);
+        whatIf->uCompactSize = pTable->uCapacity;
+        whatIf->uCompact = (unsigned *)allocItems(sizeof(unsigned), whatIf->uCompactSize);
+    }
+    memset(whatIf->uCompact, 0xff, pTable->uRows * sizeof(unsigned));
+    if (pState->uServing == NULL)
+    {
+        pState->uServing = (unsigned *)allocItems(sizeof(unsigned), whatIf->iServerCount);
+        pState->lWaiting = (long *)allocItems(sizeof(long), whatIf->iServerCount);
+    }
+    pState->lArrivalNext = simulation->lArrivalNext;
+    pState->bInputDone = simulation->bInputDone;
+    pState->lElements = 0;
+    pState->lEvents = 0;
+    pState->lWidgets = 0;
+
+    for (iServer = 0; iServer < whatIf->iServerCount; iServer++)
+        pState->uServing[iServer] = simulation->servers[iServer]->bBusy == FALSE ? NO_WIDGET_ID
+                                  : compactWidget(whatIf, pTable, pState
+                                                  , simulation->servers[iServer]->uWidgetId);
+    for (iServer = 0; iServer < whatIf->iServerCount; iServer++)
+    {
+        Queue queue = simulation->queues[iServer];
+
+        lFirst = pState->lElements;
+        for (;;)
+        {
+            growItems((void **)&pState->elements, &pState->lElementCapacity
+                      , pState->lElements + 1, sizeof(QElement));
+            if (removeQ(queue, &pState->elements[pState->lElements]) == FALSE)
+                break;
+            pState->lElements++;
+        }
+        pState->lWaiting[iServer] = pState->lElements - lFirst;
+        for (i = lFirst; i < pState->lElements; i++)
+        {
+            insertQ(queue, pState->elements[i]);
+            pState->elements[i].uWidgetId = compactWidget(whatIf, pTable, pState
+                                                          , pState->elements[i].uWidgetId);
+        }
+    }
+
+    pState->iArrivalGroupCount = simulation->iArrivalGroupCount;
+    free(pState->arrivalGroup);
+    pState->arrivalGroup = (Event *)allocItems(sizeof(Event), pState->iArrivalGroupCount);
+    for (i = 0; i < pState->iArrivalGroupCount; i++)
+    {
+        pState->arrivalGroup[i] = simulation->arrivalGroup[i];
+        pState->arrivalGroup[i].uWidgetId = compactWidget(whatIf, pTable, pState
+                                                          , simulation->arrivalGroup[i].uWidgetId);
+    }
+
+    for (;;)
+    {
+        growItems((void **)&pState->events, &pState->lEventCapacity, pState->lEvents + 1
+                  , sizeof(Event));
+        if (removeLL(simulation->eventList, &pState->events[pState->lEvents]) == FALSE)
+            break;
+        pState->lEvents++;
+    }
+    for (i = pState->lEvents - 1; i >= 0; i--)
+        insertOrderedLL(simulation->eventList, pState->events[i]);
+    for (i = 0; i < pState->lEvents; i++)
+        pState->events[i].uWidgetId = compactWidget(whatIf, pTable, pState
+                                                    , pState->events[i].uWidgetId);
+}
+
+// TRUE when the two states go on the same way given the same input
+static int sameState(WhatIf whatIf, WhatIfState *pA, WhatIfState *pB)
+{
+    return pA->lWidgets == pB->lWidgets
+        && pA->lElements == pB->lElements
+        && pA->lEvents == pB->lEvents
+        && pA->iArrivalGroupCount == pB->iArrivalGroupCount
+        && memcmp(pA->uServing, pB->uServing, whatIf->iServerCount * sizeof(unsigned)) == 0
+        && memcmp(pA->lWaiting, pB->lWaiting, whatIf->iServerCount * sizeof(long)) == 0
+        && memcmp(pA->widgets, pB->widgets, pA->lWidgets * sizeof(Widget)) == 0
+        && memcmp(pA->elements, pB->elements, pA->lElements * sizeof(QElement)) == 0
+        && memcmp(pA->arrivalGroup, pB->arrivalGroup
+                  , pA->iArrivalGroupCount * sizeof(Event)) == 0
+        && memcmp(pA->events, pB->events, pA->lEvents * sizeof(Event)) == 0;
+}
+
+static void freeState(WhatIfState *pState)
+{
+    free(pState->uServing);
+    free(pState->lWaiting);
+    free(pState->elements);
+    free(pState->arrivalGroup);
+    free(pState->events);
+    free(pState->widgets);
+}
+
+/**************************** markHistogram *******************************
+ void markHistogram(HistogramMark *pMark, Histogram *pHist
+                    , HistogramMark *pPrevious)
+ Purpose:
+ Records pHist at a checkpoint of the input's run.
+ Notes:
+ The extremes of pHist are those since the previous checkpoint: they
+ are reset here for the next interval, and put back by finishBaseRun.
+ **************************************************************************/
+static void markHistogram(HistogramMark *pMark, Histogram *pHist, HistogramMark *pPrevious)
+{
+    long lPreviousTotal = pPrevious == NULL ? 0 : pPrevious->lTotal;
+    int iLow, iHigh;
+
+    pMark->lTotal = pHist->lTotal;
+    pMark->lSum = pHist->lSum;
+    pMark->lSegmentTotal = pHist->lTotal - lPreviousTotal;
+    pMark->iSegmentMin = pHist->iMin;
+    pMark->iSegmentMax = pHist->iMax;
+    pMark->iMin = pMark->iSegmentMin;
+    pMark->iMax = pMark->iSegmentMax;
+    if (lPreviousTotal > 0)
+    {
+        if (pMark->lSegmentTotal == 0 || pPrevious->iMin < pMark->iMin)
+            pMark->iMin = pPrevious->iMin;
+        if (pMark->lSegmentTotal == 0 || pPrevious->iMax > pMark->iMax)
+            pMark->iMax = pPrevious->iMax;
+    }
+    if (pHist->lTotal > 0)
+    {
+        pHist->iMin = INT_MAX;
+        pHist->iMax = INT_MIN;
+    }
+
+    for (iLow = 0; iLow < HIST_BUCKETS && pHist->lCounts[iLow] == 0; iLow++)
+        ;
+    for (iHigh = HIST_BUCKETS; iHigh > iLow && pHist->lCounts[iHigh - 1] == 0; iHigh--)
+        ;
+    pMark->iLow = iLow;
+    pMark->iBuckets = iHigh - iLow;
+    pMark->lCounts = (long *)allocItems(sizeof(long), pMark->iBuckets);
+    memcpy(pMark->lCounts, &pHist->lCounts[iLow], pMark->iBuckets * sizeof(long));
+}
+
+// set pHist to the histogram at pMark
+static void restoreHistogram(Histogram *pHist, HistogramMark *pMark)
+{
+    initHistogram(pHist);
+    memcpy(&pHist->lCounts[pMark->iLow], pMark->lCounts, pMark->iBuckets * sizeof(long));
+    pHist->lTotal = pMark->lTotal;
+    pHist->lSum = pMark->lSum;
+    pHist->iMin = pMark->iMin;
+    pHist->iMax = pMark->iMax;
+}
+
+// add to pHist the values the input's run recorded after pMark
+static void spliceHistogram(Histogram *pHist, HistogramMark *pMark, HistogramMark *pFinal)
+{
+    int i;
+
+    if (pFinal->lTotal == pMark->lTotal)
+        return;
+    for (i = 0; i < pFinal->iBuckets; i++)
+        pHist->lCounts[pFinal->iLow + i] += pFinal->lCounts[i];
+    for (i = 0; i < pMark->iBuckets; i++)
+        pHist->lCounts[pMark->iLow + i] -= pMark->lCounts[i];
+    if (pHist->lTotal == 0 || pMark->iTailMin < pHist->iMin)
+        pHist->iMin = pMark->iTailMin;
+    if (pHist->lTotal == 0 || pMark->iTailMax > pHist->iMax)
+        pHist->iMax = pMark->iTailMax;
+    pHist->lTotal += pFinal->lTotal - pMark->lTotal;
+    pHist->lSum += pFinal->lSum - pMark->lSum;
+}
+
+// the statistics part of a checkpoint
+static void markStatistics(WhatIf whatIf, Simulation simulation, WhatIfCheckpoint *pCheckpoint
+                           , WhatIfCheckpoint *pPrevious)
+{
+    int i;
+
+    pCheckpoint->iClock = simulation->iClock;
+    pCheckpoint->lSystemTimeSum = simulation->lSystemTimeSum;
+    pCheckpoint->lWidgetCount = simulation->lWidgetCount;
+    pCheckpoint->lQueueWaitSum = (long *)allocItems(sizeof(long), whatIf->iServerCount);
+    pCheckpoint->lQueueCount = (long *)allocItems(sizeof(long), whatIf->iServerCount);
+    pCheckpoint->waitMarks = (HistogramMark *)allocItems(sizeof(HistogramMark)
+                                                         , whatIf->iServerCount);
+    for (i = 0; i < whatIf->iServerCount; i++)
+    {
+        pCheckpoint->lQueueWaitSum[i] = simulation->queues[i]->lQueueWaitSum;
+        pCheckpoint->lQueueCount[i] = simulation->queues[i]->lQueueWidgetTotalCount;
+        markHistogram(&pCheckpoint->waitMarks[i], &simulation->queues[i]->waitHist
+                      , pPrevious == NULL ? NULL : &pPrevious->waitMarks[i]);
+    }
+    markHistogram(&pCheckpoint->systemMark, &simulation->systemHist
+                  , pPrevious == NULL ? NULL : &pPrevious->systemMark);
+}
+
+static void freeCheckpoint(WhatIf whatIf, WhatIfCheckpoint *pCheckpoint)
+{
+    int i;
+
+    freeState(&pCheckpoint->state);
+    for (i = 0; i < whatIf->iServerCount; i++)
+        free(pCheckpoint->waitMarks[i].lCounts);
+    free(pCheckpoint->waitMarks);
+    free(pCheckpoint->systemMark.lCounts);
+    free(pCheckpoint->lQueueWaitSum);
+    free(pCheckpoint->lQueueCount);
+}
+
+// extremes of the values recorded after pMark: those of the interval up
+// to pNext and, unless pNext is the end of the run, those after pNext
+static void setTailExtremes(HistogramMark *pMark, HistogramMark *pNext, HistogramMark *pFinal)
+{
+    int bAfterNext = pNext != pFinal && pFinal->lTotal > pNext->lTotal;
+
+    if (pNext->lSegmentTotal > 0)
+    {
+        pMark->iTailMin = pNext->iSegmentMin;
+        pMark->iTailMax = pNext->iSegmentMax;
+        if (bAfterNext && pNext->iTailMin < pMark->iTailMin)
+            pMark->iTailMin = pNext->iTailMin;
+        if (bAfterNext && pNext->iTailMax > pMark->iTailMax)
+            pMark->iTailMax = pNext->iTailMax;
+    }
+    else if (bAfterNext)
+    {
+        pMark->iTailMin = pNext->iTailMin;
+        pMark->iTailMax = pNext->iTailMax;
+    }
+}
+
+/**************************** recordCheckpoint ****************************
+ int recordCheckpoint(Simulation simulation, int iNextTime)
+ Purpose:
+ Takes a checkpoint of the input's run, holding every event before
+ iNextTime, and returns the time of the next one.
+ **************************************************************************/
+static int recordCheckpoint(Simulation simulation, int iNextTime)
+{
+    WhatIf whatIf = simulation->whatIf;
+    WhatIfCheckpoint *pCheckpoint;
+
+    if (whatIf->iCount == whatIf->iCapacity)
+    {
+        long lCapacity = whatIf->iCapacity;
+        growItems((void **)&whatIf->checkpoints, &lCapacity, lCapacity + 1
+                  , sizeof(WhatIfCheckpoint));
+        whatIf->iCapacity = (int)lCapacity;
+    }
+    pCheckpoint = &whatIf->checkpoints[whatIf->iCount];
+    memset(pCheckpoint, 0, sizeof(WhatIfCheckpoint));
+    pCheckpoint->iTime = iNextTime;
+    captureState(whatIf, simulation, &pCheckpoint->state);
+    markStatistics(whatIf, simulation, pCheckpoint
+                   , whatIf->iCount == 0 ? NULL : &whatIf->checkpoints[whatIf->iCount - 1]);
+    whatIf->iCount++;
+
+    if (iNextTime > NO_TIME_LIMIT - whatIf->iInterval)
+        return NO_TIME_LIMIT;
+    return iNextTime + whatIf->iInterval;
+}
+
+/***************************** checkWhatIf ********************************
+ int checkWhatIf(Simulation simulation, int iNextTime)
+ Purpose:
+ Called by simulate before the first event at or after the time it
+ last returned, when every event before iNextTime has been processed.
+ The input's run takes a checkpoint; an edited run compares its state
+ with the input's latest checkpoint at or before iNextTime.
+ Parameters:
+ I  Simulation simulation               The simulation being run
+ I  int iNextTime                       Time of the next event
+ Returns:
+ The time to be called again, or WHATIF_CONVERGED when the edited run
+ has the state the input's run had and may stop.
+ **************************************************************************/
+int checkWhatIf(Simulation simulation, int iNextTime)
+{
+    WhatIf whatIf = simulation->whatIf;
+    WhatIfCheckpoint *pCheckpoint;
+    int k = whatIf->iNext;
+
+    if (whatIf->bRecording == TRUE)
+        return recordCheckpoint(simulation, iNextTime);
+
+    if (k >= whatIf->iCount)
+        return NO_TIME_LIMIT;
+    if (whatIf->checkpoints[k].iTime > iNextTime)
+        return whatIf->checkpoints[k].iTime;
+    while (k + 1 < whatIf->iCount && whatIf->checkpoints[k + 1].iTime <= iNextTime)
+        k++;
+    whatIf->iNext = k + 1;
+
+    // cheap checks first: both runs must be at the same unchanged widget
+    pCheckpoint = &whatIf->checkpoints[k];
+    if (pCheckpoint->state.lArrivalNext >= whatIf->lBaseTailStart
+        && simulation->lArrivalNext == pCheckpoint->state.lArrivalNext + whatIf->lOffset
+        && simulation->bInputDone == pCheckpoint->state.bInputDone)
+    {
+        captureState(whatIf, simulation, &whatIf->scratch);
+        if (sameState(whatIf, &whatIf->scratch, &pCheckpoint->state))
+        {
+            whatIf->iConverged = k;
+            return WHATIF_CONVERGED;
+        }
+    }
+    return k + 1 < whatIf->iCount ? whatIf->checkpoints[k + 1].iTime : NO_TIME_LIMIT;
+}
+
+/*************************** restoreCheckpoint ****************************
+ void restoreCheckpoint(WhatIf whatIf, Simulation simulation
+                        , WhatIfCheckpoint *pCheckpoint)
+ Purpose:
+ Puts a new simulation, with its arrivals loaded, in the state of a
+ checkpoint of the input's run.
+ **************************************************************************/
+static void restoreCheckpoint(WhatIf whatIf, Simulation simulation
+                              , WhatIfCheckpoint *pCheckpoint)
+{
+    WhatIfState *pState = &pCheckpoint->state;
+    unsigned *uIds = (unsigned *)allocItems(sizeof(unsigned), pState->lWidgets);
+    long i, lElement = 0;
+    int iServer;
+
+    for (i = 0; i < pState->lWidgets; i++)
+        uIds[i] = addWidget(&simulation->widgets, &pState->widgets[i]);
+    for (iServer = 0; iServer < whatIf->iServerCount; iServer++)
+    {
+        Server server = simulation->servers[iServer];
+        Queue queue = simulation->queues[iServer];
+
+        server->bBusy = pState->uServing[iServer] != NO_WIDGET_ID;
+        if (server->bBusy == TRUE)
+            server->uWidgetId = uIds[pState->uServing[iServer]];
+#ifndef QUEUE_RING
+        queue->nodePool.bPooled = simulation->eventList->nodePool.bPooled;
+#endif
+        for (i = 0; i < pState->lWaiting[iServer]; i++, lElement++)
+        {
+            QElement element = pState->elements[lElement];
+            element.uWidgetId = uIds[element.uWidgetId];
+            insertQ(queue, element);
+        }
+        queue->lQueueWaitSum = pCheckpoint->lQueueWaitSum[iServer];
+        queue->lQueueWidgetTotalCount = pCheckpoint->lQueueCount[iServer];
+        restoreHistogram(&queue->waitHist, &pCheckpoint->waitMarks[iServer]);
+    }
+    restoreHistogram(&simulation->systemHist, &pCheckpoint->systemMark);
+
+    simulation->arrivalGroup = (Event *)allocItems(sizeof(Event), pState->iArrivalGroupCount);
+    simulation->iArrivalGroupCapacity = pState->iArrivalGroupCount;
+    simulation->iArrivalGroupCount = pState->iArrivalGroupCount;
+    for (i = 0; i < pState->iArrivalGroupCount; i++)
+    {
+        simulation->arrivalGroup[i] = pState->arrivalGroup[i];
+        simulation->arrivalGroup[i].uWidgetId = uIds[pState->arrivalGroup[i].uWidgetId];
+    }
+    for (i = pState->lEvents - 1; i >= 0; i--)
+    {
+        Event event = pState->events[i];
+        event.uWidgetId = uIds[event.uWidgetId];
+        insertOrderedLL(simulation->eventList, event);
+    }
+    free(uIds);
+
+    simulation->iClock = pCheckpoint->iClock;
+    simulation->lSystemTimeSum = pCheckpoint->lSystemTimeSum;
+    simulation->lWidgetCount = pCheckpoint->lWidgetCount;
+    simulation->lArrivalNext = pState->lArrivalNext;
+    simulation->bInputDone = pState->bInputDone;
+    simulation->iArrivalClock = pState->lArrivalNext < simulation->lArrivalTotal
+                              ? simulation->arrivalWidgets[pState->lArrivalNext].iArrivalTime
+                              : simulation->iArrivalEndClock;
+}
+
+/***************************** finishBaseRun ******************************
+ void finishBaseRun(WhatIf whatIf, Simulation simulation
+                    , SimulationResult *pResult)
+ Purpose:
+ Records the statistics at the end of the input's run, works out the
+ extremes after each checkpoint, and puts the full run's extremes back
+ in the simulation's histograms.
+ **************************************************************************/
+static void finishBaseRun(WhatIf whatIf, Simulation simulation, SimulationResult *pResult)
+{
+    WhatIfCheckpoint *pFinal = &whatIf->final;
+    int k, i;
+
+    markStatistics(whatIf, simulation, pFinal, whatIf->iCount == 0 ? NULL
+                   : &whatIf->checkpoints[whatIf->iCount - 1]);
+    whatIf->bTimeLimitReached = pResult->bTimeLimitReached;
+    for (i = 0; i < whatIf->iServerCount; i++)
+    {
+        simulation->queues[i]->waitHist.iMin = pFinal->waitMarks[i].iMin;
+        simulation->queues[i]->waitHist.iMax = pFinal->waitMarks[i].iMax;
+    }
+    simulation->systemHist.iMin = pFinal->systemMark.iMin;
+    simulation->systemHist.iMax = pFinal->systemMark.iMax;
+
+    for (k = whatIf->iCount - 1; k >= 0; k--)
+    {
+        WhatIfCheckpoint *pNext = k == whatIf->iCount - 1 ? pFinal
+                                : &whatIf->checkpoints[k + 1];
+
+        for (i = 0; i < whatIf->iServerCount; i++)
+            setTailExtremes(&whatIf->checkpoints[k].waitMarks[i], &pNext->waitMarks[i]
+                            , &pFinal->waitMarks[i]);
+        setTailExtremes(&whatIf->checkpoints[k].systemMark, &pNext->systemMark
+                        , &pFinal->systemMark);
+    }
+}
+
+// add the input run's statistics after checkpoint iConverged to the edit's
+static void spliceBaseRun(WhatIf whatIf, Simulation simulation, SimulationResult *pResult)
+{
+    WhatIfCheckpoint *pCheckpoint = &whatIf->checkpoints[whatIf->iConverged];
+    WhatIfCheckpoint *pFinal = &whatIf->final;
+    int i;
+
+    simulation->lSystemTimeSum += pFinal->lSystemTimeSum - pCheckpoint->lSystemTimeSum;
+    simulation->lWidgetCount += pFinal->lWidgetCount - pCheckpoint->lWidgetCount;
+    for (i = 0; i < whatIf->iServerCount; i++)
+    {
+        Queue queue = simulation->queues[i];
+        queue->lQueueWaitSum += pFinal->lQueueWaitSum[i] - pCheckpoint->lQueueWaitSum[i];
+        queue->lQueueWidgetTotalCount += pFinal->lQueueCount[i] - pCheckpoint->lQueueCount[i];
+        spliceHistogram(&queue->waitHist, &pCheckpoint->waitMarks[i], &pFinal->waitMarks[i]);
+    }
+    spliceHistogram(&simulation->systemHist, &pCheckpoint->systemMark, &pFinal->systemMark);
+    simulation->iClock = pFinal->iClock;
+    pResult->bTimeLimitReached = whatIf->bTimeLimitReached;
+    summarizeSimulation(simulation, pResult);
+}
+
+/***************************** runEditedTrace *****************************
+ void runEditedTrace(WhatIf whatIf, Simulation base, char szPath[]
+                     , int iTimeLimit)
+ Purpose:
+ Simulates the edited trace szPath from the input's checkpoints, and
+ prints what was re-simulated and its statistics.
+ **************************************************************************/
+static void runEditedTrace(WhatIf whatIf, Simulation base, char szPath[], int iTimeLimit)
+{
+    Simulation simulation = newSimulation();
+    SimulationResult result;
+    long lCommon, lFirstChange, lTail, lFrom, lTo;
+    int iFrom, iTo, k;
+
+    setEventListKind(simulation->eventList, base->eventList->iKind);
+    simulation->eventList->nodePool.bPooled = base->eventList->nodePool.bPooled;
+    simulation->bStreaming = TRUE;
+    simulation->bPercentiles = base->bPercentiles;
+    simulation->bMemoryReport = base->bMemoryReport;
+    simulation->iParseThreads = base->iParseThreads;
+    setServerCount(simulation, base->iServerCount);
+    simulation->pszInputFile = szPath;
+    openArrivals(simulation);
+    if (simulation->arrivalWidgets == NULL)
+        ErrExit(ERR_BAD_INPUT, "What-if traces must be files, found '%s'", szPath);
+
+    // the changed widgets lie between the unchanged start and end
+    lCommon = base->lArrivalTotal < simulation->lArrivalTotal ? base->lArrivalTotal
+            : simulation->lArrivalTotal;
+    for (lFirstChange = 0; lFirstChange < lCommon
+         && memcmp(&base->arrivalWidgets[lFirstChange]
+                   , &simulation->arrivalWidgets[lFirstChange], sizeof(Widget)) == 0
+         ; lFirstChange++)
+        ;
+    for (lTail = 0; lTail < lCommon
+         && memcmp(&base->arrivalWidgets[base->lArrivalTotal - 1 - lTail]
+                   , &simulation->arrivalWidgets[simulation->lArrivalTotal - 1 - lTail]
+                   , sizeof(Widget)) == 0
+         ; lTail++)
+        ;
+    whatIf->lBaseTailStart = base->lArrivalTotal - lTail;
+    whatIf->lOffset = simulation->lArrivalTotal - base->lArrivalTotal;
+
+    // resume from the last checkpoint that had not yet read a change
+    for (k = whatIf->iCount - 1; k >= 0; k--)
+        if (whatIf->checkpoints[k].state.lArrivalNext < lFirstChange)
+            break;
+    if (k >= 0)
+    {
+        restoreCheckpoint(whatIf, simulation, &whatIf->checkpoints[k]);
+        lFrom = whatIf->checkpoints[k].state.lArrivalNext;
+        iFrom = whatIf->checkpoints[k].iTime;
+    }
+    else
+    {
+        readArrivalGroup(simulation);
+        lFrom = 0;
+        iFrom = 0;
+    }
+    whatIf->bRecording = FALSE;
+    whatIf->iNext = k + 1;
+    whatIf->iConverged = -1;
+
+    simulation->whatIf = whatIf;
+    simulate(simulation, iTimeLimit, &result);
+    simulation->whatIf = NULL;
+    lTo = simulation->lArrivalNext;
+    iTo = result.iClock;
+    if (whatIf->iConverged >= 0)
+    {
+        iTo = whatIf->checkpoints[whatIf->iConverged].iTime;
+        spliceBaseRun(whatIf, simulation, &result);
+    }
+
+    printf("\nWhat-if %s: re-simulated %ld of %ld arrivals, time %d to %d\n"
+           , szPath, lTo - lFrom, simulation->lArrivalTotal, iFrom, iTo);
+    printSimulationResult(simulation, &result);
+    freeSimulation(simulation);
+}
+
+/****************************** runWhatIf *********************************
+ void runWhatIf(Simulation simulation, int iTimeLimit)
+ Purpose:
+ Simulates the input, printing its statistics as runSimulation does,
+ and then each edited trace of simulation->pszWhatIfFiles (separated by
+ commas) from the input's checkpoints.
+ Parameters:
+ I  Simulation simulation           The simulation holding the parsed
+                                    input (arrivalWidgets) and switches.
+ I  int iTimeLimit                  Passed on to simulate.
+ Notes:
+ The simulation is freed. -J writes the input's histograms.
+ **************************************************************************/
+void runWhatIf(Simulation simulation, int iTimeLimit)
+{
+    WhatIfImp whatIf;
+    SimulationResult result;
+    char *pszPath;
+    double dStart;
+    int k;
+
+    if (simulation->arrivalWidgets == NULL)
+        ErrExit(ERR_BAD_INPUT, "What-if runs need an input file");
+
+    memset(&whatIf, 0, sizeof(whatIf));
+    whatIf.iServerCount = simulation->iServerCount;
+    whatIf.iInterval = simulation->iArrivalEndClock / WHATIF_CHECKPOINTS;
+    if (whatIf.iInterval < 1)
+        whatIf.iInterval = 1;
+    whatIf.bRecording = TRUE;
+    whatIf.iConverged = -1;
+
+    printf("Time\t       \t Event");
+    dStart = wallSeconds();
+    simulation->whatIf = &whatIf;
+    simulate(simulation, iTimeLimit, &result);
+    simulation->whatIf = NULL;
+    finishBaseRun(&whatIf, simulation, &result);
+    simulation->stats.dSimulateSeconds = wallSeconds() - dStart;
+    printSimulationResult(simulation, &result);
+
+    for (pszPath = strtok(simulation->pszWhatIfFiles, ","); pszPath != NULL
+         ; pszPath = strtok(NULL, ","))
+        runEditedTrace(&whatIf, simulation, pszPath, iTimeLimit);
+
+    for (k = 0; k < whatIf.iCount; k++)
+        freeCheckpoint(&whatIf, &whatIf.checkpoints[k]);
+    freeCheckpoint(&whatIf, &whatIf.final);
+    free(whatIf.checkpoints);
+    freeState(&whatIf.scratch);
+    free(whatIf.uCompact);
+    freeSimulation(simulation);
+}
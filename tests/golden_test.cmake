@@ -0,0 +1,101 @@
+# Golden output test, run by ctest as
+#
+#   cmake -DPROGRAM=exe -DARGS="args" -DGOLDEN=file -DOUTPUT=file
+#         [-DHASH=1] [-DGEN="exe args"] [-DSETUP="exe args && exe args"]
+#         [-DINPUT=file] [-DRESULT=file] [-DSAME="file file"]
+#         -P golden_test.cmake
+#
+# GEN, when given, is run first (to generate the trace the test reads),
+# then each command of SETUP (commands separated by &&, their output is
+# discarded). PROGRAM is then run with ARGS, reading INPUT when given,
+# and its standard output, stored in OUTPUT, must equal the GOLDEN file;
+# with RESULT the file PROGRAM writes is checked instead of its output.
+# With HASH the GOLDEN file holds the SHA-256 of the output instead, for
+# outputs too large to store. SAME names two files that must then be
+# identical (a round trip). ARGS, GEN and SETUP are split like a shell
+# command line.
+#
+# With the environment variable P4_UPDATE_GOLDEN=1 the GOLDEN file is
+# written from the output instead of compared.
+
+if(DEFINED GEN AND NOT GEN STREQUAL "")
+    separate_arguments(GEN_COMMAND UNIX_COMMAND "${GEN}")
+    execute_process(COMMAND ${GEN_COMMAND} RESULT_VARIABLE GEN_RESULT)
+    if(NOT GEN_RESULT EQUAL 0)
+        message(FATAL_ERROR "Generating the trace failed (${GEN_RESULT}): ${GEN}")
+    endif()
+endif()
+
+if(DEFINED SETUP AND NOT SETUP STREQUAL "")
+    separate_arguments(SETUP_WORDS UNIX_COMMAND "${SETUP}")
+    list(APPEND SETUP_WORDS "&&")
+    set(SETUP_COMMAND "")
+    foreach(WORD ${SETUP_WORDS})
+        if(WORD STREQUAL "&&")
+            execute_process(COMMAND ${SETUP_COMMAND} RESULT_VARIABLE SETUP_RESULT
+                            OUTPUT_QUIET)
+            if(NOT SETUP_RESULT EQUAL 0)
+                message(FATAL_ERROR "Setup failed (${SETUP_RESULT}): ${SETUP_COMMAND}")
+            endif()
+            set(SETUP_COMMAND "")
+        else()
+            list(APPEND SETUP_COMMAND "${WORD}")
+        endif()
+    endforeach()
+endif()
+
+separate_arguments(ARGS_LIST UNIX_COMMAND "${ARGS}")
+if(DEFINED INPUT AND NOT INPUT STREQUAL "")
+    execute_process(COMMAND ${PROGRAM} ${ARGS_LIST}
+                    INPUT_FILE ${INPUT}
+                    OUTPUT_FILE ${OUTPUT}
+                    RESULT_VARIABLE RUN_RESULT)
+else()
+    execute_process(COMMAND ${PROGRAM} ${ARGS_LIST}
+                    OUTPUT_FILE ${OUTPUT}
+                    RESULT_VARIABLE RUN_RESULT)
+endif()
+if(NOT RUN_RESULT EQUAL 0)
+    message(FATAL_ERROR "${PROGRAM} ${ARGS} exited with ${RUN_RESULT}")
+endif()
+if(DEFINED RESULT AND NOT RESULT STREQUAL "")
+    set(OUTPUT ${RESULT})
+endif()
+
+if(DEFINED SAME AND NOT SAME STREQUAL "")
+    separate_arguments(SAME_FILES UNIX_COMMAND "${SAME}")
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${SAME_FILES}
+                    RESULT_VARIABLE SAME_RESULT)
+    if(NOT SAME_RESULT EQUAL 0)
+        message(FATAL_ERROR "${SAME} differ")
+    endif()
+endif()
+
+if(HASH)
+    file(SHA256 ${OUTPUT} ACTUAL_HASH)
+endif()
+
+if("$ENV{P4_UPDATE_GOLDEN}" STREQUAL "1")
+    if(HASH)
+        file(WRITE ${GOLDEN} "${ACTUAL_HASH}\n")
+    else()
+        configure_file(${OUTPUT} ${GOLDEN} COPYONLY)
+    endif()
+    message(STATUS "Updated ${GOLDEN}")
+    return()
+endif()
+
+if(HASH)
+    file(STRINGS ${GOLDEN} GOLDEN_HASH LIMIT_COUNT 1)
+    if(NOT ACTUAL_HASH STREQUAL GOLDEN_HASH)
+        message(FATAL_ERROR "Output of ${PROGRAM} ${ARGS} (${OUTPUT}) has SHA-256 "
+                "${ACTUAL_HASH}, expected ${GOLDEN_HASH} (${GOLDEN})")
+    endif()
+else()
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${GOLDEN}
+                    RESULT_VARIABLE COMPARE_RESULT)
+    if(NOT COMPARE_RESULT EQUAL 0)
+        message(FATAL_ERROR "Output of ${PROGRAM} ${ARGS} (${OUTPUT}) differs "
+                "from ${GOLDEN}")
+    endif()
+endif()
@@ -0,0 +1,96 @@
+# What-if test, run by ctest as
+#
+#   cmake -DPROGRAM=exe -DARGS="args" [-DGEN="exe args"] -DTRACE=file
+#         -DPREFIX=path -P whatif_test.cmake
+#
+# GEN, when given, is run first (to generate TRACE). Writes three edited
+# copies of the text trace TRACE (PREFIX_changed.txt with a longer step 1,
+# PREFIX_removed.txt with a widget removed and PREFIX_inserted.txt with a
+# widget inserted), runs
+#
+#   PROGRAM ARGS -w edits -i TRACE
+#
+# and checks that the statistics printed for each edit are the ones a
+# full run of the edited trace (PROGRAM ARGS -i edit) prints.
+
+if(DEFINED GEN AND NOT GEN STREQUAL "")
+    separate_arguments(GEN_COMMAND UNIX_COMMAND "${GEN}")
+    execute_process(COMMAND ${GEN_COMMAND} RESULT_VARIABLE GEN_RESULT)
+    if(NOT GEN_RESULT EQUAL 0)
+        message(FATAL_ERROR "Generating the trace failed (${GEN_RESULT}): ${GEN}")
+    endif()
+endif()
+
+file(STRINGS ${TRACE} LINES)
+list(LENGTH LINES LINE_COUNT)
+if(LINE_COUNT LESS 2000)
+    message(FATAL_ERROR "${TRACE} has ${LINE_COUNT} lines, the edits need 2000")
+endif()
+
+# the widget on line 700 takes 40 tu longer in step 1
+set(CHANGED ${LINES})
+list(GET CHANGED 699 LINE)
+string(REGEX MATCH "^([0-9]+) ([0-9]+) (.*)$" LINE "${LINE}")
+math(EXPR STEP1 "${CMAKE_MATCH_2} + 40")
+list(REMOVE_AT CHANGED 699)
+list(INSERT CHANGED 699 "${CMAKE_MATCH_1} ${STEP1} ${CMAKE_MATCH_3}")
+
+# the widget on line 1500 is removed
+set(REMOVED ${LINES})
+list(REMOVE_AT REMOVED 1499)
+
+# a widget arrives with the one on line 1000
+set(INSERTED ${LINES})
+list(INSERT INSERTED 999 "99999 12 9 0 1")
+
+set(EDITS "")
+foreach(EDIT changed removed inserted)
+    string(TOUPPER ${EDIT} EDIT_VARIABLE)
+    string(REPLACE ";" "\n" TEXT "${${EDIT_VARIABLE}}")
+    file(WRITE ${PREFIX}_${EDIT}.txt "${TEXT}\n")
+    list(APPEND EDITS ${PREFIX}_${EDIT}.txt)
+endforeach()
+string(REPLACE ";" "," EDIT_LIST "${EDITS}")
+
+separate_arguments(ARGS_LIST UNIX_COMMAND "${ARGS}")
+execute_process(COMMAND ${PROGRAM} ${ARGS_LIST} -w ${EDIT_LIST} -i ${TRACE}
+                OUTPUT_VARIABLE WHATIF_OUTPUT
+                RESULT_VARIABLE RUN_RESULT)
+if(NOT RUN_RESULT EQUAL 0)
+    message(FATAL_ERROR "${PROGRAM} ${ARGS} -w ${EDIT_LIST} exited with ${RUN_RESULT}")
+endif()
+file(WRITE ${PREFIX}.out "${WHATIF_OUTPUT}")
+
+foreach(EDIT ${EDITS})
+    # the edit's block: from the line after its heading to the next heading
+    string(FIND "${WHATIF_OUTPUT}" "What-if ${EDIT}:" START)
+    if(START EQUAL -1)
+        message(FATAL_ERROR "No what-if block for ${EDIT} in ${PREFIX}.out")
+    endif()
+    string(SUBSTRING "${WHATIF_OUTPUT}" ${START} -1 BLOCK)
+    string(FIND "${BLOCK}" "\n" END)
+    math(EXPR END "${END} + 1")
+    string(SUBSTRING "${BLOCK}" ${END} -1 BLOCK)
+    string(FIND "${BLOCK}" "What-if " END)
+    if(NOT END EQUAL -1)
+        string(SUBSTRING "${BLOCK}" 0 ${END} BLOCK)
+    endif()
+    string(STRIP "${BLOCK}" BLOCK)
+
+    # the full run, without its heading line
+    execute_process(COMMAND ${PROGRAM} ${ARGS_LIST} -i ${EDIT}
+                    OUTPUT_VARIABLE FULL
+                    RESULT_VARIABLE RUN_RESULT)
+    if(NOT RUN_RESULT EQUAL 0)
+        message(FATAL_ERROR "${PROGRAM} ${ARGS} -i ${EDIT} exited with ${RUN_RESULT}")
+    endif()
+    string(FIND "${FULL}" "\n" END)
+    math(EXPR END "${END} + 1")
+    string(SUBSTRING "${FULL}" ${END} -1 FULL)
+    string(STRIP "${FULL}" FULL)
+
+    if(NOT BLOCK STREQUAL FULL)
+        message(FATAL_ERROR "The what-if block of ${EDIT}:\n${BLOCK}\n"
+                "differs from its full run:\n${FULL}")
+    endif()
+endforeach()